@@ -166,6 +166,7 @@ static int restore_tty;
 
 #if HAVE_THREADS
 static void free_input_threads(void);
+static void free_output_threads(void);
 #endif
 
 /* sub2video hack:
@@ -538,6 +539,10 @@ static void ffmpeg_cleanup(int ret)
 
     av_freep(&subtitle_out);
 
+#if HAVE_THREADS
+    free_output_threads();
+#endif
+
     /* close files */
     for (i = 0; i < nb_output_files; i++) {
         OutputFile *of = output_files[i];
@@ -622,6 +627,7 @@ static void ffmpeg_cleanup(int ret)
                    av_err2str(AVERROR(errno)));
     }
     av_freep(&vstats_filename);
+    av_freep(&filter_thread_type);
 
     av_freep(&input_streams);
     av_freep(&input_files);
@@ -695,6 +701,312 @@ static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream,
     }
 }
 
+#if HAVE_THREADS
+static void *muxer_thread(void *arg)
+{
+    OutputFile *of = arg;
+    int ret = 0;
+
+    while (1) {
+        AVPacket pkt;
+        ret = av_thread_message_queue_recv(of->mux_queue, &pkt, 0);
+        if (ret < 0)
+            break;
+
+        pthread_mutex_lock(&of->mux_lock);
+        ret = av_interleaved_write_frame(of->ctx, &pkt);
+        pthread_mutex_unlock(&of->mux_lock);
+        if (ret < 0) {
+            /* report the error to the main thread on its next send */
+            av_thread_message_queue_set_err_send(of->mux_queue, ret);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+typedef struct EncoderFrame {
+    AVFrame *frame;                 /* NULL to flush the encoder */
+    AVRational sample_aspect_ratio; /* applied to the encoder if den is set */
+} EncoderFrame;
+
+static void *encoder_thread(void *arg)
+{
+    OutputStream   *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    int ret = 0;
+
+    while (ret >= 0) {
+        EncoderFrame ef;
+
+        ret = av_thread_message_queue_recv(ost->enc_queue, &ef, 0);
+        if (ret < 0)
+            break;
+
+        if (ef.sample_aspect_ratio.den)
+            enc->sample_aspect_ratio = ef.sample_aspect_ratio;
+
+        ret = avcodec_send_frame(enc, ef.frame);
+        while (ret >= 0) {
+            AVPacket pkt;
+
+            av_init_packet(&pkt);
+            pkt.data = NULL;
+            pkt.size = 0;
+
+            ret = avcodec_receive_packet(enc, &pkt);
+            if (ret < 0)
+                break;
+
+            if (debug_ts) {
+                av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                       av_get_media_type_string(enc->codec_type),
+                       av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
+                       av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
+            }
+
+            if (ef.frame && enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+                pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                pkt.pts = ef.frame->pts;
+
+            av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
+
+            /* if two pass, output log */
+            if (ost->logfile && enc->stats_out)
+                fprintf(ost->logfile, "%s", enc->stats_out);
+
+            pthread_mutex_lock(&ost->enc_lock);
+            if (!av_fifo_space(ost->enc_packets))
+                ret = av_fifo_grow(ost->enc_packets, 8 * sizeof(pkt));
+            if (ret >= 0)
+                av_fifo_generic_write(ost->enc_packets, &pkt, sizeof(pkt), NULL);
+            else
+                av_packet_unref(&pkt);
+            pthread_cond_signal(&ost->enc_cond);
+            pthread_mutex_unlock(&ost->enc_lock);
+        }
+        if (ret == AVERROR(EAGAIN))
+            ret = 0;
+        if (ret == AVERROR_EOF && ost->logfile && enc->stats_out)
+            fprintf(ost->logfile, "%s", enc->stats_out);
+        av_frame_free(&ef.frame);
+
+        pthread_mutex_lock(&ost->enc_lock);
+        ost->enc_frames_done++;
+        pthread_cond_signal(&ost->enc_cond);
+        pthread_mutex_unlock(&ost->enc_lock);
+    }
+
+    /* make the main thread fail instead of blocking once the queue is full */
+    av_thread_message_queue_set_err_send(ost->enc_queue, ret);
+
+    pthread_mutex_lock(&ost->enc_lock);
+    ost->enc_ret = ret;
+    pthread_cond_signal(&ost->enc_cond);
+    pthread_mutex_unlock(&ost->enc_lock);
+
+    return NULL;
+}
+
+static void free_encoder_thread(OutputStream *ost)
+{
+    AVPacket pkt;
+
+    if (!ost || !ost->enc_queue)
+        return;
+    /* drop the frames which were not encoded yet and stop the thread */
+    av_thread_message_flush(ost->enc_queue);
+    av_thread_message_queue_set_err_recv(ost->enc_queue, AVERROR_EOF);
+    pthread_join(ost->enc_thread, NULL);
+    av_thread_message_queue_free(&ost->enc_queue);
+
+    while (av_fifo_size(ost->enc_packets)) {
+        av_fifo_generic_read(ost->enc_packets, &pkt, sizeof(pkt), NULL);
+        av_packet_unref(&pkt);
+    }
+    av_fifo_freep(&ost->enc_packets);
+    pthread_cond_destroy(&ost->enc_cond);
+    pthread_mutex_destroy(&ost->enc_lock);
+}
+
+static void encoder_frame_free_msg(void *msg)
+{
+    EncoderFrame *ef = msg;
+    av_frame_free(&ef->frame);
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    OutputFile *of = output_files[ost->file_index];
+    AVCodecContext *enc = ost->enc_ctx;
+    int i, ret, nb_encoders = 0;
+
+    /* these read encoder state from the main thread while encoding */
+    if (vstats_filename || do_benchmark_all || (enc->flags & AV_CODEC_FLAG_PSNR))
+        return 0;
+    if (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO)
+        return 0;
+
+    /* with a single encoder there is nothing to run in parallel */
+    for (i = 0; i < nb_output_streams; i++) {
+        enum AVMediaType type = output_streams[i]->st->codecpar->codec_type;
+        if (output_streams[i]->encoding_needed &&
+            (type == AVMEDIA_TYPE_VIDEO || type == AVMEDIA_TYPE_AUDIO))
+            nb_encoders++;
+    }
+    if (nb_encoders < 2)
+        return 0;
+
+    ost->enc_packets = av_fifo_alloc(8 * sizeof(AVPacket));
+    if (!ost->enc_packets)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&ost->enc_queue,
+                                        of->thread_queue_size, sizeof(EncoderFrame));
+    if (ret < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(ost->enc_queue, encoder_frame_free_msg);
+
+    if ((ret = pthread_mutex_init(&ost->enc_lock, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&ost->enc_cond, NULL))) {
+        pthread_mutex_destroy(&ost->enc_lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        pthread_cond_destroy(&ost->enc_cond);
+        pthread_mutex_destroy(&ost->enc_lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    return 0;
+fail:
+    av_thread_message_queue_free(&ost->enc_queue);
+    av_fifo_freep(&ost->enc_packets);
+    return ret;
+}
+
+static int encoder_thread_send_frame(OutputStream *ost, AVFrame *frame,
+                                     AVRational sample_aspect_ratio)
+{
+    EncoderFrame ef = { NULL, sample_aspect_ratio };
+    int ret;
+
+    /* the caller keeps using its frame, the thread gets its own reference */
+    if (frame && !(ef.frame = av_frame_clone(frame)))
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_send(ost->enc_queue, &ef, 0);
+    if (ret < 0) {
+        av_frame_free(&ef.frame);
+        return ret;
+    }
+    ost->enc_frames_sent++;
+
+    return 0;
+}
+
+static void free_output_thread(int i)
+{
+    OutputFile *of = output_files[i];
+
+    if (!of || !of->mux_queue)
+        return;
+    /* let the thread write out whatever is still queued, then stop */
+    av_thread_message_queue_set_err_recv(of->mux_queue, AVERROR_EOF);
+    pthread_join(of->mux_thread, NULL);
+    av_thread_message_queue_free(&of->mux_queue);
+    pthread_mutex_destroy(&of->mux_lock);
+}
+
+static void free_output_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_streams; i++)
+        free_encoder_thread(output_streams[i]);
+    for (i = 0; i < nb_output_files; i++)
+        free_output_thread(i);
+}
+
+static void packet_unref_msg(void *msg)
+{
+    av_packet_unref(msg);
+}
+
+static int init_output_thread(OutputFile *of)
+{
+    int ret;
+
+    if (nb_output_files == 1)
+        return 0;
+
+    ret = av_thread_message_queue_alloc(&of->mux_queue,
+                                        of->thread_queue_size, sizeof(AVPacket));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(of->mux_queue, packet_unref_msg);
+
+    if ((ret = pthread_mutex_init(&of->mux_lock, NULL))) {
+        av_thread_message_queue_free(&of->mux_queue);
+        return AVERROR(ret);
+    }
+
+    if ((ret = pthread_create(&of->mux_thread, NULL, muxer_thread, of))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        pthread_mutex_destroy(&of->mux_lock);
+        av_thread_message_queue_free(&of->mux_queue);
+        return AVERROR(ret);
+    }
+
+    return 0;
+}
+
+static int write_packet_mt(OutputFile *of, AVPacket *pkt)
+{
+    AVPacket tmp_pkt;
+    int ret;
+
+    /* the packet may reference data owned by the caller, which is only valid
+     * until we return */
+    ret = av_packet_make_refcounted(pkt);
+    if (ret < 0)
+        return ret;
+    av_packet_move_ref(&tmp_pkt, pkt);
+
+    ret = av_thread_message_queue_send(of->mux_queue, &tmp_pkt, 0);
+    if (ret < 0)
+        av_packet_unref(&tmp_pkt);
+    return ret;
+}
+#endif
+
+/* The AVIOContext of an output file must not be accessed from the main thread
+ * without holding this lock while the file has a muxer thread. */
+static void lock_output_file(OutputFile *of)
+{
+#if HAVE_THREADS
+    if (of->mux_queue)
+        pthread_mutex_lock(&of->mux_lock);
+#endif
+}
+
+static void unlock_output_file(OutputFile *of)
+{
+#if HAVE_THREADS
+    if (of->mux_queue)
+        pthread_mutex_unlock(&of->mux_lock);
+#endif
+}
+
 static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
 {
     AVFormatContext *s = of->ctx;
@@ -823,6 +1135,11 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
               );
     }
 
+#if HAVE_THREADS
+    if (of->mux_queue)
+        ret = write_packet_mt(of, pkt);
+    else
+#endif
     ret = av_interleaved_write_frame(s, pkt);
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
@@ -905,6 +1222,51 @@ finish:
     }
 }
 
+#if HAVE_THREADS
+/*
+ * Send the packets produced by an encoder thread to the output. Unless
+ * flushing, wait until all the frames sent to it so far have been encoded,
+ * so the packets reach the muxer in the same order as without the thread.
+ * When flushing, wait for the encoder to be drained and flush the output
+ * bitstream filters.
+ */
+static int drain_encoder_thread(OutputFile *of, OutputStream *ost, int flush)
+{
+    AVPacket pkt;
+    int ret;
+
+    pthread_mutex_lock(&ost->enc_lock);
+    while (1) {
+        while (av_fifo_size(ost->enc_packets)) {
+            av_fifo_generic_read(ost->enc_packets, &pkt, sizeof(pkt), NULL);
+            pthread_mutex_unlock(&ost->enc_lock);
+
+            if (flush && (ost->finished & MUXER_FINISHED))
+                av_packet_unref(&pkt);
+            else
+                output_packet(of, &pkt, ost, 0);
+
+            pthread_mutex_lock(&ost->enc_lock);
+        }
+        if (ost->enc_ret < 0 ||
+            (!flush && ost->enc_frames_done == ost->enc_frames_sent))
+            break;
+        pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+    }
+    ret = ost->enc_ret;
+    pthread_mutex_unlock(&ost->enc_lock);
+
+    if (ret == AVERROR_EOF) {
+        av_init_packet(&pkt);
+        pkt.data = NULL;
+        pkt.size = 0;
+        output_packet(of, &pkt, ost, 1);
+        return 0;
+    }
+    return ret;
+}
+#endif
+
 static int check_recording_time(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
@@ -947,10 +1309,20 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
+#if HAVE_THREADS
+    if (ost->enc_queue)
+        ret = encoder_thread_send_frame(ost, frame, (AVRational){ 0, 0 });
+    else
+#endif
     ret = avcodec_send_frame(enc, frame);
     if (ret < 0)
         goto error;
 
+#if HAVE_THREADS
+    if (ost->enc_queue)
+        return;
+#endif
+
     while (1) {
         ret = avcodec_receive_packet(enc, &pkt);
         if (ret == AVERROR(EAGAIN))
@@ -1077,10 +1449,23 @@ static void do_video_out(OutputFile *of,
     int frame_size = 0;
     InputStream *ist = NULL;
     AVFilterContext *filter = ost->filter->filter;
+    AVRational sar = { 0, 0 };
+    int threaded = 0;
 
     if (ost->source_index >= 0)
         ist = input_streams[ost->source_index];
 
+#if HAVE_THREADS
+    threaded = !!ost->enc_queue;
+#endif
+    if (next_picture && !ost->frame_aspect_ratio.num) {
+        /* an encoder thread applies it itself, not while it is encoding */
+        if (threaded)
+            sar = next_picture->sample_aspect_ratio;
+        else
+            enc->sample_aspect_ratio = next_picture->sample_aspect_ratio;
+    }
+
     frame_rate = av_buffersink_get_frame_rate(filter);
     if (frame_rate.num > 0 && frame_rate.den > 0)
         duration = 1/(av_q2d(frame_rate) * av_q2d(enc->time_base));
@@ -1296,13 +1681,19 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
+#if HAVE_THREADS
+        if (ost->enc_queue)
+            ret = encoder_thread_send_frame(ost, in_picture, sar);
+        else
+#endif
         ret = avcodec_send_frame(enc, in_picture);
         if (ret < 0)
             goto error;
         // Make sure Closed Captions will not be duplicated
         av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
 
-        while (1) {
+        /* the encoder thread takes care of the output packets */
+        while (!threaded) {
             ret = avcodec_receive_packet(enc, &pkt);
             update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
             if (ret == AVERROR(EAGAIN))
@@ -1503,9 +1894,6 @@ static int reap_filters(int flush)
 
             switch (av_buffersink_get_type(filter)) {
             case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
-                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
-
                 if (debug_ts) {
                     av_log(NULL, AV_LOG_INFO, "filter -> pts:%s pts_time:%s exact:%f time_base:%d/%d\n",
                             av_ts2str(filtered_frame->pts), av_ts2timestr(filtered_frame->pts, &enc->time_base),
@@ -1533,6 +1921,25 @@ static int reap_filters(int flush)
         }
     }
 
+#if HAVE_THREADS
+    /* the encoders of all streams have been running in parallel, now collect
+     * their output in stream order */
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        int ret;
+
+        if (!ost->enc_queue)
+            continue;
+        ret = drain_encoder_thread(output_files[ost->file_index], ost, 0);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+                   av_get_media_type_string(ost->enc_ctx->codec_type),
+                   av_err2str(ret));
+            exit_program(1);
+        }
+    }
+#endif
+
     return 0;
 }
 
@@ -1689,9 +2096,11 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
     oc = output_files[0]->ctx;
 
+    lock_output_file(output_files[0]);
     total_size = avio_size(oc->pb);
     if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
         total_size = avio_tell(oc->pb);
+    unlock_output_file(output_files[0]);
 
     vid = 0;
     av_bprint_init(&buf, 0, AV_BPRINT_SIZE_AUTOMATIC);
@@ -1918,6 +2327,21 @@ static void flush_encoders(void)
         if (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO)
             continue;
 
+#if HAVE_THREADS
+        if (ost->enc_queue) {
+            ret = encoder_thread_send_frame(ost, NULL, (AVRational){ 0, 0 });
+            if (ret >= 0)
+                ret = drain_encoder_thread(of, ost, 1);
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+                       av_get_media_type_string(enc->codec_type),
+                       av_err2str(ret));
+                exit_program(1);
+            }
+            continue;
+        }
+#endif
+
         for (;;) {
             const char *desc = NULL;
             AVPacket pkt;
@@ -2990,6 +3414,12 @@ static int check_init_output_file(OutputFile *of, int file_index)
     //assert_avoptions(of->opts);
     of->header_written = 1;
 
+#if HAVE_THREADS
+    ret = init_output_thread(of);
+    if (ret < 0)
+        return ret;
+#endif
+
     av_dump_format(of->ctx, file_index, of->ctx->url, 1);
 
     if (sdp_filename || want_sdp)
@@ -3579,6 +4009,15 @@ static int init_output_stream(OutputStream *ost, char *error, int error_len)
             ost->st->duration = av_rescale_q(ist->st->duration, ist->st->time_base, ost->st->time_base);
 
         ost->st->codec->codec= ost->enc_ctx->codec;
+
+#if HAVE_THREADS
+        ret = init_encoder_thread(ost);
+        if (ret < 0) {
+            snprintf(error, error_len, "Error starting the encoder thread "
+                     "for output stream #%d:%d", ost->file_index, ost->index);
+            return ret;
+        }
+#endif
     } else if (ost->stream_copy) {
         ret = init_output_stream_streamcopy(ost);
         if (ret < 0)
@@ -3831,9 +4270,14 @@ static int need_output(void)
         OutputStream *ost    = output_streams[i];
         OutputFile *of       = output_files[ost->file_index];
         AVFormatContext *os  = output_files[ost->file_index]->ctx;
+        int64_t written;
 
-        if (ost->finished ||
-            (os->pb && avio_tell(os->pb) >= of->limit_filesize))
+        if (ost->finished)
+            continue;
+        lock_output_file(of);
+        written = os->pb ? avio_tell(os->pb) : 0;
+        unlock_output_file(of);
+        if (os->pb && written >= of->limit_filesize)
             continue;
         if (ost->frame_number >= ost->max_frames) {
             int j;
@@ -4715,6 +5159,10 @@ static int transcode(void)
 
     term_exit();
 
+#if HAVE_THREADS
+    free_output_threads();
+#endif
+
     /* write the trailer if needed and close file */
     for (i = 0; i < nb_output_files; i++) {
         os = output_files[i]->ctx;
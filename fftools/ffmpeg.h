@@ -549,6 +549,17 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+#if HAVE_THREADS
+    AVThreadMessageQueue *enc_queue; /* frames to encode, a NULL frame flushes */
+    pthread_t enc_thread;       /* thread running the encoder */
+    pthread_mutex_t enc_lock;   /* protects the fields below */
+    pthread_cond_t enc_cond;
+    AVFifoBuffer *enc_packets;  /* encoded packets waiting to be muxed */
+    int enc_frames_sent;        /* frames queued by the main thread */
+    int enc_frames_done;        /* frames the encoder thread has consumed */
+    int enc_ret;                /* set when the encoder thread has stopped */
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -562,6 +573,13 @@ typedef struct OutputFile {
     int shortest;
 
     int header_written;
+
+#if HAVE_THREADS
+    AVThreadMessageQueue *mux_queue;
+    pthread_t mux_thread;       /* thread writing packets to this file */
+    pthread_mutex_t mux_lock;   /* serializes access to ctx->pb with the thread */
+    int thread_queue_size;      /* maximum number of queued packets or frames */
+#endif
 } OutputFile;
 
 extern InputStream **input_streams;
@@ -609,6 +627,7 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern char *filter_thread_type;
 extern int vstats_version;
 
 extern const AVIOInterruptCB int_cb;
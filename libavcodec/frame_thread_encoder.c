@@ -26,6 +26,7 @@
 #include "libavutil/avassert.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/thread.h"
 #include "avcodec.h"
 #include "internal.h"
@@ -66,7 +67,7 @@ static void * attribute_align_arg worker(void *v){
     AVPacket *pkt = NULL;
 
     while (!atomic_load(&c->exit)) {
-        int got_packet, ret;
+        int got_packet, ret, pool_slot;
         AVFrame *frame;
         Task task;
 
@@ -86,7 +87,10 @@ static void * attribute_align_arg worker(void *v){
         pthread_mutex_unlock(&c->task_fifo_mutex);
         frame = task.indata;
 
+        pool_slot = avpriv_thread_pool_enter();
         ret = avcodec_encode_video2(avctx, pkt, frame, &got_packet);
+        if (pool_slot)
+            avpriv_thread_pool_leave();
         pthread_mutex_lock(&c->buffer_mutex);
         av_frame_unref(frame);
         pthread_mutex_unlock(&c->buffer_mutex);
@@ -281,7 +285,7 @@ void ff_frame_thread_encoder_free(AVCodecContext *avctx){
 int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt, const AVFrame *frame, int *got_packet_ptr){
     ThreadContext *c = avctx->internal->frame_thread_encoder;
     Task task;
-    int ret;
+    int ret, left;
 
     av_assert1(!*got_packet_ptr);
 
@@ -313,9 +317,11 @@ int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt, const AVF
             return 0;
         }
 
+    left = avpriv_thread_pool_leave();
     while (!c->finished_tasks[c->finished_task_index].outdata) {
         pthread_cond_wait(&c->finished_task_cond, &c->finished_task_mutex);
     }
+    avpriv_thread_pool_resume(left);
     task = c->finished_tasks[c->finished_task_index];
     *pkt = *(AVPacket*)(task.outdata);
     if(pkt->data)
@@ -876,8 +876,11 @@ static int hls_slice_header(HEVCContext *s)
                 sh->entry_point_offset[i] = val + 1; // +1; // +1 to get the size
             }
             if (s->threads_number > 1 && (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1)) {
-                s->enable_parallel_tiles = 0; // TODO: you can enable tiles in parallel here
-                s->threads_number = 1;
+                if (s->ps.pps->entropy_coding_sync_enabled_flag) {
+                    s->enable_parallel_tiles = 0;
+                    s->threads_number = 1;
+                } else
+                    s->enable_parallel_tiles = 1;
             } else
                 s->enable_parallel_tiles = 0;
         } else
@@ -2562,6 +2565,148 @@ error:
     return ret;
 }
 
+static int hls_decode_entry_tile(AVCodecContext *avctxt, void *input_offset, int job, int self_id)
+{
+    HEVCContext *s1  = avctxt->priv_data, *s;
+    HEVCLocalContext *lc;
+    int more_data    = 1;
+    int *offset      = input_offset;
+    int tile         = s1->ps.pps->tile_id[s1->ps.pps->ctb_addr_rs_to_ts[s1->sh.slice_ctb_addr_rs]] + job;
+    int ctb_addr_ts  = s1->ps.pps->ctb_addr_rs_to_ts[s1->ps.pps->tile_pos_rs[tile]];
+    int tile_end_ts  = tile + 1 < s1->ps.pps->num_tile_columns * s1->ps.pps->num_tile_rows ?
+                       s1->ps.pps->ctb_addr_rs_to_ts[s1->ps.pps->tile_pos_rs[tile + 1]] :
+                       s1->ps.sps->ctb_size;
+    int x_ctb, y_ctb;
+    int ret;
+
+    s  = s1->sList[self_id];
+    lc = s->HEVClc;
+
+    // the slice header is parsed from the main local context, so every
+    // substream, including the first one, gets its own reader here
+    ret = init_get_bits8(&lc->gb, s->data + offset[job],
+                         job < s->sh.num_entry_point_offsets ?
+                         s->sh.offset[job] + 1 - offset[job] :
+                         s->sh.offset[job - 1] + s->sh.size[job - 1] - offset[job]);
+    if (ret < 0)
+        goto error;
+
+    x_ctb = (s->ps.pps->tile_pos_rs[tile] % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+    lc->end_of_tiles_x = x_ctb + (s->ps.pps->column_width[s->ps.pps->col_idxX[x_ctb >> s->ps.sps->log2_ctb_size]] << s->ps.sps->log2_ctb_size);
+    lc->first_qp_group = 1;
+    lc->qp_y           = s->sh.slice_qp;
+
+    while (more_data && ctb_addr_ts < tile_end_ts) {
+        int ctb_addr_rs = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+
+        x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
+
+        ret = ff_hevc_cabac_init(s, ctb_addr_ts);
+        if (ret < 0)
+            goto error;
+
+        hls_sao_param(s, x_ctb >> s->ps.sps->log2_ctb_size, y_ctb >> s->ps.sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
+        more_data = hls_coding_quadtree(s, x_ctb, y_ctb, s->ps.sps->log2_ctb_size, 0);
+        if (more_data < 0) {
+            ret = more_data;
+            goto error;
+        }
+
+        ctb_addr_ts++;
+    }
+
+    if (ctb_addr_ts < tile_end_ts) {
+        if (job != s->sh.num_entry_point_offsets) {
+            av_log(s->avctx, AV_LOG_ERROR, "Slice segment ends inside tile %d\n", tile);
+            ret = AVERROR_INVALIDDATA;
+            goto error;
+        }
+        for (; ctb_addr_ts < tile_end_ts; ctb_addr_ts++)
+            s->tab_slice_address[s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts]] = -1;
+        return 0;
+    }
+
+    return job == s->sh.num_entry_point_offsets ? ctb_addr_ts : 0;
+error:
+    for (; ctb_addr_ts < tile_end_ts; ctb_addr_ts++)
+        s->tab_slice_address[s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts]] = -1;
+    return ret;
+}
+
+static int hls_slice_data_tiles(HEVCContext *s, int *arg, int *ret)
+{
+    const HEVCPPS *pps = s->ps.pps;
+    int ctb_size       = 1 << s->ps.sps->log2_ctb_size;
+    int start_ts       = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+    int first_tile     = pps->tile_id[start_ts];
+    int last_tile      = first_tile + s->sh.num_entry_point_offsets;
+    int end_ts, ctb_addr_ts, i, res;
+    int x_ctb = 0, y_ctb = 0;
+
+    if (last_tile >= pps->num_tile_columns * pps->num_tile_rows ||
+        start_ts != pps->ctb_addr_rs_to_ts[pps->tile_pos_rs[first_tile]]) {
+        av_log(s->avctx, AV_LOG_ERROR, "Tile entry points are wrong (%d %d %d)\n",
+               s->sh.slice_ctb_addr_rs, first_tile, s->sh.num_entry_point_offsets);
+        return AVERROR_INVALIDDATA;
+    }
+
+    if (s->sh.dependent_slice_segment_flag) {
+        if (!start_ts) {
+            av_log(s->avctx, AV_LOG_ERROR, "Impossible initial tile.\n");
+            return AVERROR_INVALIDDATA;
+        }
+        if (s->tab_slice_address[pps->ctb_addr_ts_to_rs[start_ts - 1]] != s->sh.slice_addr) {
+            av_log(s->avctx, AV_LOG_ERROR, "Previous slice segment missing\n");
+            return AVERROR_INVALIDDATA;
+        }
+    }
+
+    end_ts = last_tile + 1 < pps->num_tile_columns * pps->num_tile_rows ?
+             pps->ctb_addr_rs_to_ts[pps->tile_pos_rs[last_tile + 1]] :
+             s->ps.sps->ctb_size;
+
+    // claim the whole slice up front so that the slice boundary flags of a
+    // tile do not depend on how far its neighbours have been decoded
+    for (ctb_addr_ts = start_ts; ctb_addr_ts < end_ts; ctb_addr_ts++)
+        s->tab_slice_address[pps->ctb_addr_ts_to_rs[ctb_addr_ts]] = s->sh.slice_addr;
+
+    arg[0] = s->HEVClc->gb.index >> 3;
+    for (i = 1; i <= s->sh.num_entry_point_offsets; i++)
+        arg[i] = s->sh.offset[i - 1];
+
+    s->avctx->execute2(s->avctx, hls_decode_entry_tile, arg, ret, s->sh.num_entry_point_offsets + 1);
+
+    res = ret[s->sh.num_entry_point_offsets];
+    for (i = 0; i < s->sh.num_entry_point_offsets; i++)
+        if (ret[i] < 0)
+            res = ret[i];
+
+    // loop filtering runs here in decoding order once all tiles are complete
+    for (ctb_addr_ts = start_ts; ctb_addr_ts < end_ts; ctb_addr_ts++) {
+        int ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+
+        if (s->tab_slice_address[ctb_addr_rs] != s->sh.slice_addr)
+            break;
+
+        x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        ff_hevc_deblocking_boundary_strengths_tile(s, x_ctb, y_ctb);
+        ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
+    }
+
+    if (ctb_addr_ts == s->ps.sps->ctb_size && res >= 0)
+        ff_hevc_hls_filter(s, x_ctb, y_ctb, ctb_size);
+
+    return res;
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 {
     const uint8_t *data = nal->data;
@@ -2579,7 +2724,8 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         return AVERROR(ENOMEM);
     }
 
-    if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
+    if (s->ps.pps->entropy_coding_sync_enabled_flag &&
+        s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
         av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
             s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
             s->ps.sps->ctb_width, s->ps.sps->ctb_height
@@ -2649,11 +2795,13 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         ret[i] = 0;
     }
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
         s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
 
-    for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
-        res += ret[i];
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+            res += ret[i];
+    } else if (s->enable_parallel_tiles)
+        res = hls_slice_data_tiles(s, arg, ret);
 error:
     av_free(ret);
     av_free(arg);
@@ -45,6 +45,16 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+typedef struct PNGEncStrip {
+    z_stream zstream;            ///< raw deflate stream of this strip
+    int zstream_inited;
+    uint8_t *crow_base;          ///< scratch rows for the filter choice
+    uint8_t *buf;                ///< compressed strip
+    int buf_size;
+    int len;
+    uint32_t adler;
+} PNGEncStrip;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -64,6 +74,14 @@ typedef struct PNGEncContext {
     int bit_depth;
     int color_type;
     int bits_per_pixel;
+    int compression_level;
+
+    // slice threading: rows are filtered and deflated in horizontal strips
+    PNGEncStrip *strips;
+    int nb_strips;
+    uint8_t *filtered;           ///< filtered rows of the whole image
+    int row_size;
+    const AVFrame *pict;
 
     // APNG
     uint32_t palette_checksum;   // Used to ensure a single unique palette
@@ -428,6 +446,111 @@ static int encode_headers(AVCodecContext *avctx, const AVFrame *pict)
     return 0;
 }
 
+static int png_filter_strip(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s    = avctx->priv_data;
+    PNGEncStrip *strip  = &s->strips[jobnr];
+    const AVFrame *p    = s->pict;
+    int y_start         = p->height *  jobnr      / s->nb_strips;
+    int y_end           = p->height * (jobnr + 1) / s->nb_strips;
+    // pixel data should be aligned, but there's a control byte before it
+    uint8_t *crow_buf   = strip->crow_base + 15;
+    int y;
+
+    for (y = y_start; y < y_end; y++) {
+        uint8_t *ptr  = p->data[0] + y * p->linesize[0];
+        uint8_t *top  = y ? ptr - p->linesize[0] : NULL;
+        uint8_t *crow = png_choose_filter(s, crow_buf, ptr, top,
+                                          s->row_size, s->bits_per_pixel >> 3);
+        memcpy(s->filtered + y * (s->row_size + 1), crow, s->row_size + 1);
+    }
+    return 0;
+}
+
+static int png_deflate_strip(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s   = avctx->priv_data;
+    PNGEncStrip *strip = &s->strips[jobnr];
+    int stride         = s->row_size + 1;
+    int y_start        = s->pict->height *  jobnr      / s->nb_strips;
+    int y_end          = s->pict->height * (jobnr + 1) / s->nb_strips;
+    int last           = jobnr == s->nb_strips - 1;
+    uint8_t *data      = s->filtered + y_start * stride;
+    int size           = (y_end - y_start) * stride;
+    int ret;
+
+    strip->len = 0;
+    deflateReset(&strip->zstream);
+    /* prime the window with the end of the previous strip like a single
+     * stream would have it, so the strip split costs almost nothing */
+    if (jobnr) {
+        int dict_size = FFMIN(y_start * stride, 32768);
+        deflateSetDictionary(&strip->zstream, data - dict_size, dict_size);
+    }
+    strip->zstream.next_in   = data;
+    strip->zstream.avail_in  = size;
+    strip->zstream.next_out  = strip->buf;
+    strip->zstream.avail_out = strip->buf_size;
+    /* all but the last strip end byte aligned with a sync flush */
+    ret = deflate(&strip->zstream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret != (last ? Z_STREAM_END : Z_OK) || strip->zstream.avail_in)
+        return AVERROR_EXTERNAL;
+    strip->len   = strip->buf_size - strip->zstream.avail_out;
+    strip->adler = adler32(adler32(0, NULL, 0), data, size);
+    return 0;
+}
+
+/* Encode the image as independent strips and join them into a single zlib
+ * stream, pigz-style. */
+static int encode_frame_strips(AVCodecContext *avctx, const AVFrame *pict)
+{
+    PNGEncContext *s = avctx->priv_data;
+    int stride = s->row_size + 1;
+    int level = s->compression_level;
+    int i, len = 6;
+    unsigned header;
+    uint32_t adler;
+    uint8_t *buf, *ptr;
+
+    s->pict = pict;
+    avctx->execute2(avctx, png_filter_strip, NULL, NULL, s->nb_strips);
+    avctx->execute2(avctx, png_deflate_strip, NULL, NULL, s->nb_strips);
+    s->pict = NULL;
+
+    adler = s->strips[0].adler;
+    for (i = 0; i < s->nb_strips; i++) {
+        PNGEncStrip *strip = &s->strips[i];
+        int rows = pict->height * (i + 1) / s->nb_strips -
+                   pict->height *  i      / s->nb_strips;
+        if (!strip->len) /* deflate failed */
+            return AVERROR_EXTERNAL;
+        if (i)
+            adler = adler32_combine(adler, strip->adler, rows * stride);
+        len += strip->len;
+    }
+    if (s->bytestream_end - s->bytestream < len + 12)
+        return AVERROR(ENOMEM);
+
+    buf = ptr = av_malloc(len);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    /* zlib header as deflateInit2() would write it for a 32k window */
+    if (level == Z_DEFAULT_COMPRESSION)
+        level = 6;
+    header = (Z_DEFLATED + (7 << 4)) << 8 |
+             (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+    header += 31 - header % 31;
+    bytestream_put_be16(&ptr, header);
+    for (i = 0; i < s->nb_strips; i++)
+        bytestream_put_buffer(&ptr, s->strips[i].buf, s->strips[i].len);
+    bytestream_put_be32(&ptr, adler);
+
+    png_write_image_data(avctx, buf, len);
+    av_free(buf);
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 {
     PNGEncContext *s       = avctx->priv_data;
@@ -439,6 +562,9 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
     uint8_t *progressive_buf = NULL;
     uint8_t *top_buf         = NULL;
 
+    if (s->nb_strips)
+        return encode_frame_strips(avctx, pict);
+
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
@@ -1091,6 +1217,39 @@ FF_ENABLE_DEPRECATION_WARNINGS
                       : av_clip(avctx->compression_level, 0, 9);
     if (deflateInit2(&s->zstream, compression_level, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
         return -1;
+    s->compression_level = compression_level;
+
+    if (avctx->active_thread_type & FF_THREAD_SLICE && !s->is_progressive &&
+        FFMIN(avctx->thread_count, avctx->height) > 1) {
+        int i;
+
+        s->row_size  = (avctx->width * s->bits_per_pixel + 7) >> 3;
+        s->nb_strips = FFMIN(avctx->thread_count, avctx->height);
+        s->strips    = av_mallocz_array(s->nb_strips, sizeof(*s->strips));
+        s->filtered  = av_malloc_array(avctx->height, s->row_size + 1);
+        if (!s->strips || !s->filtered)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < s->nb_strips; i++) {
+            PNGEncStrip *strip = &s->strips[i];
+            int rows = avctx->height * (i + 1) / s->nb_strips -
+                       avctx->height *  i      / s->nb_strips;
+
+            strip->zstream.zalloc = ff_png_zalloc;
+            strip->zstream.zfree  = ff_png_zfree;
+            strip->zstream.opaque = NULL;
+            if (deflateInit2(&strip->zstream, compression_level, Z_DEFLATED,
+                             -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                return -1;
+            strip->zstream_inited = 1;
+            /* room for the sync flush marker on top of the bound */
+            strip->buf_size  = deflateBound(&strip->zstream,
+                                            (uLong)rows * (s->row_size + 1)) + 16;
+            strip->buf       = av_malloc(strip->buf_size);
+            strip->crow_base = av_malloc((s->row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+            if (!strip->buf || !strip->crow_base)
+                return AVERROR(ENOMEM);
+        }
+    }
 
     return 0;
 }
@@ -1100,6 +1259,17 @@ static av_cold int png_enc_close(AVCodecContext *avctx)
     PNGEncContext *s = avctx->priv_data;
 
     deflateEnd(&s->zstream);
+    if (s->strips) {
+        int i;
+        for (i = 0; i < s->nb_strips; i++) {
+            if (s->strips[i].zstream_inited)
+                deflateEnd(&s->strips[i].zstream);
+            av_freep(&s->strips[i].buf);
+            av_freep(&s->strips[i].crow_base);
+        }
+        av_freep(&s->strips);
+    }
+    av_freep(&s->filtered);
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1146,7 +1316,8 @@ AVCodec ff_png_encoder = {
     .init           = png_enc_init,
     .close          = png_enc_close,
     .encode2        = encode_png,
-    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_INTRA_ONLY,
+    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS |
+                      AV_CODEC_CAP_INTRA_ONLY,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA,
         AV_PIX_FMT_RGB48BE, AV_PIX_FMT_RGBA64BE,
@@ -29,6 +29,7 @@
 #define LONG_BITSTREAM_READER
 
 #include "libavutil/internal.h"
+#include "libavutil/thread.h"
 #include "avcodec.h"
 #include "get_bits.h"
 #include "idctdsp.h"
@@ -132,6 +133,9 @@ static void unpack_alpha_12(GetBitContext *gb, uint16_t *dst, int num_coeffs,
     }
 }
 
+static AVOnce codeword_lut_init = AV_ONCE_INIT;
+static av_cold void init_codeword_luts(void);
+
 static av_cold int decode_init(AVCodecContext *avctx)
 {
     int ret = 0;
@@ -140,6 +144,9 @@ static av_cold int decode_init(AVCodecContext *avctx)
 
     avctx->bits_per_raw_sample = 10;
 
+    if (ff_thread_once(&codeword_lut_init, init_codeword_luts))
+        return AVERROR_UNKNOWN;
+
     switch (avctx->codec_tag) {
     case MKTAG('a','p','c','o'):
         avctx->profile = FF_PROFILE_PRORES_PROXY;
@@ -469,10 +476,66 @@ static av_always_inline int decode_dc_coeffs(GetBitContext *gb, int16_t *out,
 static const uint8_t run_to_cb[16] = { 0x06, 0x06, 0x05, 0x05, 0x04, 0x29, 0x29, 0x29, 0x29, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x4C };
 static const uint8_t lev_to_cb[10] = { 0x04, 0x0A, 0x05, 0x06, 0x04, 0x28, 0x28, 0x28, 0x28, 0x4C };
 
+#define CODEWORD_LUT_BITS 8
+
+typedef struct CodewordLUT {
+    int16_t val; ///< decoded value, with the sign applied for levels
+    uint8_t len; ///< bits consumed, 0 if the code does not fit the lookup
+} CodewordLUT;
+
+/* one table per run/level context, indexed by the next CODEWORD_LUT_BITS bits */
+static CodewordLUT run_lut[16][1 << CODEWORD_LUT_BITS];
+static CodewordLUT lev_lut[10][1 << CODEWORD_LUT_BITS];
+
+static av_cold void init_codeword_lut(CodewordLUT *lut, unsigned codebook, int signed_level)
+{
+    unsigned switch_bits =  codebook & 3;
+    unsigned rice_order  =  codebook >> 5;
+    unsigned exp_order   = (codebook >> 2) & 7;
+    unsigned code, q, len, val;
+
+    for (code = 1; code < 1 << CODEWORD_LUT_BITS; code++) {
+        q = CODEWORD_LUT_BITS - 1 - av_log2(code);
+        if (q > switch_bits) {
+            len = exp_order - switch_bits + (q << 1);
+            if (len > CODEWORD_LUT_BITS)
+                continue;
+            val = (code >> (CODEWORD_LUT_BITS - len)) - (1 << exp_order) +
+                  ((switch_bits + 1) << rice_order);
+        } else {
+            len = q + 1 + rice_order;
+            if (len > CODEWORD_LUT_BITS)
+                continue;
+            val = (q << rice_order) +
+                  ((code >> (CODEWORD_LUT_BITS - len)) & ((1 << rice_order) - 1));
+        }
+        if (signed_level) {
+            if (++len > CODEWORD_LUT_BITS)
+                continue;
+            val++;
+            if ((code >> (CODEWORD_LUT_BITS - len)) & 1)
+                val = -val;
+        }
+        lut[code].val = val;
+        lut[code].len = len;
+    }
+}
+
+static av_cold void init_codeword_luts(void)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(run_lut); i++)
+        init_codeword_lut(run_lut[i], run_to_cb[i], 0);
+    for (i = 0; i < FF_ARRAY_ELEMS(lev_lut); i++)
+        init_codeword_lut(lev_lut[i], lev_to_cb[i], 1);
+}
+
 static av_always_inline int decode_ac_coeffs(AVCodecContext *avctx, GetBitContext *gb,
                                              int16_t *out, int blocks_per_slice)
 {
     ProresContext *ctx = avctx->priv_data;
+    const CodewordLUT *lut;
     int block_mask, sign;
     unsigned pos, run, level;
     int max_coeffs, i, bits_left;
@@ -491,21 +554,34 @@ static av_always_inline int decode_ac_coeffs(AVCodecContext *avctx, GetBitContex
         if (!bits_left || (bits_left < 32 && !SHOW_UBITS(re, gb, bits_left)))
             break;
 
-        DECODE_CODEWORD(run, run_to_cb[FFMIN(run,  15)], LAST_SKIP_BITS);
+        UPDATE_CACHE(re, gb);
+        lut = &run_lut[FFMIN(run, 15)][SHOW_UBITS(re, gb, CODEWORD_LUT_BITS)];
+        if (lut->len) {
+            run = lut->val;
+            LAST_SKIP_BITS(re, gb, lut->len);
+        } else
+            DECODE_CODEWORD(run, run_to_cb[FFMIN(run,  15)], LAST_SKIP_BITS);
         pos += run + 1;
         if (pos >= max_coeffs) {
             av_log(avctx, AV_LOG_ERROR, "ac tex damaged %d, %d\n", pos, max_coeffs);
             return AVERROR_INVALIDDATA;
         }
 
-        DECODE_CODEWORD(level, lev_to_cb[FFMIN(level, 9)], SKIP_BITS);
-        level += 1;
-
         i = pos >> log2_block_count;
 
-        sign = SHOW_SBITS(re, gb, 1);
-        SKIP_BITS(re, gb, 1);
-        out[((pos & block_mask) << 6) + ctx->scan[i]] = ((level ^ sign) - sign);
+        UPDATE_CACHE(re, gb);
+        lut = &lev_lut[FFMIN(level, 9)][SHOW_UBITS(re, gb, CODEWORD_LUT_BITS)];
+        if (lut->len) {
+            level = FFABS(lut->val);
+            SKIP_BITS(re, gb, lut->len);
+            out[((pos & block_mask) << 6) + ctx->scan[i]] = lut->val;
+        } else {
+            DECODE_CODEWORD(level, lev_to_cb[FFMIN(level, 9)], SKIP_BITS);
+            level += 1;
+            sign = SHOW_SBITS(re, gb, 1);
+            SKIP_BITS(re, gb, 1);
+            out[((pos & block_mask) << 6) + ctx->scan[i]] = (level ^ sign) - sign;
+        }
     }
 
     CLOSE_READER(re, gb);
@@ -43,6 +43,7 @@
 #include "libavutil/log.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/thread.h"
 
 enum {
@@ -170,6 +171,7 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
     PerThreadContext *p = arg;
     AVCodecContext *avctx = p->avctx;
     const AVCodec *codec = avctx->codec;
+    int pool_slot;
 
     pthread_mutex_lock(&p->mutex);
     while (1) {
@@ -178,6 +180,8 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
 
         if (p->die) break;
 
+        pool_slot = avpriv_thread_pool_enter();
+
         if (!codec->update_thread_context && THREAD_SAFE_CALLBACKS(avctx))
             ff_thread_finish_setup(avctx);
 
@@ -221,6 +225,9 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
             async_unlock(p->parent);
         }
 
+        if (pool_slot)
+            avpriv_thread_pool_leave();
+
         pthread_mutex_lock(&p->progress_mutex);
 
         atomic_store(&p->state, STATE_INPUT_READY);
@@ -416,10 +423,12 @@ static int submit_packet(PerThreadContext *p, AVCodecContext *user_avctx,
     if (prev_thread) {
         int err;
         if (atomic_load(&prev_thread->state) == STATE_SETTING_UP) {
+            int left = avpriv_thread_pool_leave();
             pthread_mutex_lock(&prev_thread->progress_mutex);
             while (atomic_load(&prev_thread->state) == STATE_SETTING_UP)
                 pthread_cond_wait(&prev_thread->progress_cond, &prev_thread->progress_mutex);
             pthread_mutex_unlock(&prev_thread->progress_mutex);
+            avpriv_thread_pool_resume(left);
         }
 
         err = update_context_from_thread(p->avctx, prev_thread->avctx, 0);
@@ -451,10 +460,11 @@ static int submit_packet(PerThreadContext *p, AVCodecContext *user_avctx,
          p->avctx->get_format != avcodec_default_get_format ||
          p->avctx->get_buffer2 != avcodec_default_get_buffer2)) {
         while (atomic_load(&p->state) != STATE_SETUP_FINISHED && atomic_load(&p->state) != STATE_INPUT_READY) {
-            int call_done = 1;
+            int call_done = 1, left = avpriv_thread_pool_leave();
             pthread_mutex_lock(&p->progress_mutex);
             while (atomic_load(&p->state) == STATE_SETTING_UP)
                 pthread_cond_wait(&p->progress_cond, &p->progress_mutex);
+            avpriv_thread_pool_resume(left);
 
             switch (atomic_load_explicit(&p->state, memory_order_acquire)) {
             case STATE_GET_BUFFER:
@@ -529,10 +539,12 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
         p = &fctx->threads[finished++];
 
         if (atomic_load(&p->state) != STATE_INPUT_READY) {
+            int left = avpriv_thread_pool_leave();
             pthread_mutex_lock(&p->progress_mutex);
             while (atomic_load_explicit(&p->state, memory_order_relaxed) != STATE_INPUT_READY)
                 pthread_cond_wait(&p->output_cond, &p->progress_mutex);
             pthread_mutex_unlock(&p->progress_mutex);
+            avpriv_thread_pool_resume(left);
         }
 
         av_frame_move_ref(picture, p->frame);
@@ -593,6 +605,7 @@ void ff_thread_await_progress(ThreadFrame *f, int n, int field)
 {
     PerThreadContext *p;
     atomic_int *progress = f->progress ? (atomic_int*)f->progress->data : NULL;
+    int left;
 
     if (!progress ||
         atomic_load_explicit(&progress[field], memory_order_acquire) >= n)
@@ -604,10 +617,13 @@ void ff_thread_await_progress(ThreadFrame *f, int n, int field)
         av_log(f->owner[field], AV_LOG_DEBUG,
                "thread awaiting %d field %d from %p\n", n, field, progress);
 
+    /* let another thread run while the owner makes progress */
+    left = avpriv_thread_pool_leave();
     pthread_mutex_lock(&p->progress_mutex);
     while (atomic_load_explicit(&progress[field], memory_order_relaxed) < n)
         pthread_cond_wait(&p->progress_cond, &p->progress_mutex);
     pthread_mutex_unlock(&p->progress_mutex);
+    avpriv_thread_pool_resume(left);
 }
 
 void ff_thread_finish_setup(AVCodecContext *avctx) {
@@ -650,10 +666,12 @@ static void park_frame_worker_threads(FrameThreadContext *fctx, int thread_count
         PerThreadContext *p = &fctx->threads[i];
 
         if (atomic_load(&p->state) != STATE_INPUT_READY) {
+            int left = avpriv_thread_pool_leave();
             pthread_mutex_lock(&p->progress_mutex);
             while (atomic_load(&p->state) != STATE_INPUT_READY)
                 pthread_cond_wait(&p->output_cond, &p->progress_mutex);
             pthread_mutex_unlock(&p->progress_mutex);
+            avpriv_thread_pool_resume(left);
         }
         p->got_frame = 0;
     }
@@ -941,6 +959,8 @@ static int thread_get_buffer_internal(AVCodecContext *avctx, ThreadFrame *f, int
     if (THREAD_SAFE_CALLBACKS(avctx)) {
         err = ff_get_buffer(avctx, f->f, flags);
     } else {
+        int left = avpriv_thread_pool_leave();
+
         pthread_mutex_lock(&p->progress_mutex);
         p->requested_frame = f->f;
         p->requested_flags = flags;
@@ -949,6 +969,7 @@ static int thread_get_buffer_internal(AVCodecContext *avctx, ThreadFrame *f, int
 
         while (atomic_load(&p->state) != STATE_SETTING_UP)
             pthread_cond_wait(&p->progress_cond, &p->progress_mutex);
+        avpriv_thread_pool_resume(left);
 
         err = p->result;
 
@@ -969,6 +990,7 @@ enum AVPixelFormat ff_thread_get_format(AVCodecContext *avctx, const enum AVPixe
 {
     enum AVPixelFormat res;
     PerThreadContext *p = avctx->internal->thread_ctx;
+    int left;
     if (!(avctx->active_thread_type & FF_THREAD_FRAME) || avctx->thread_safe_callbacks ||
         avctx->get_format == avcodec_default_get_format)
         return ff_get_format(avctx, fmt);
@@ -976,6 +998,7 @@ enum AVPixelFormat ff_thread_get_format(AVCodecContext *avctx, const enum AVPixe
         av_log(avctx, AV_LOG_ERROR, "get_format() cannot be called after ff_thread_finish_setup()\n");
         return -1;
     }
+    left = avpriv_thread_pool_leave();
     pthread_mutex_lock(&p->progress_mutex);
     p->available_formats = fmt;
     atomic_store(&p->state, STATE_GET_FORMAT);
@@ -983,6 +1006,7 @@ enum AVPixelFormat ff_thread_get_format(AVCodecContext *avctx, const enum AVPixe
 
     while (atomic_load(&p->state) != STATE_SETTING_UP)
         pthread_cond_wait(&p->progress_cond, &p->progress_mutex);
+    avpriv_thread_pool_resume(left);
 
     res = p->result_format;
 
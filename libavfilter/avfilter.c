@@ -100,6 +100,26 @@ void ff_command_queue_pop(AVFilterContext *filter)
     av_free(c);
 }
 
+int ff_command_queue_insert(AVFilterContext *filter, const char *command,
+                            const char *arg, int flags, double ts)
+{
+    AVFilterCommand **queue = &filter->command_queue, *next;
+
+    while (*queue && (*queue)->time <= ts)
+        queue = &(*queue)->next;
+    next = *queue;
+    *queue = av_mallocz(sizeof(AVFilterCommand));
+    if (!*queue)
+        return AVERROR(ENOMEM);
+
+    (*queue)->command = av_strdup(command);
+    (*queue)->arg     = av_strdup(arg);
+    (*queue)->time    = ts;
+    (*queue)->flags   = flags;
+    (*queue)->next    = next;
+    return 0;
+}
+
 int ff_insert_pad(unsigned idx, unsigned *count, size_t padidx_off,
                    AVFilterPad **pads, AVFilterLink ***links,
                    AVFilterPad *newpad)
@@ -190,9 +210,25 @@ int avfilter_link_get_channels(AVFilterLink *link)
 }
 #endif
 
-void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
+/*
+ * With frame threading, the fields of the links used for scheduling and the
+ * ready fields of the filters are shared between the threads activating the
+ * filters on both sides of a link: the functions below prefixed by ff_ take
+ * the graph lock, the static ones expect it to be held.
+ */
+
+static void filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
     filter->ready = FFMAX(filter->ready, priority);
+    if (filter->graph && filter->graph->internal->frame_thread)
+        ff_graph_frame_thread_wake(filter->graph, filter);
+}
+
+void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
+{
+    ff_filter_graph_lock(filter->graph);
+    filter_set_ready(filter, priority);
+    ff_filter_graph_unlock(filter->graph);
 }
 
 /**
@@ -208,7 +244,25 @@ static void filter_unblock(AVFilterContext *filter)
 }
 
 
-void ff_avfilter_link_set_in_status(AVFilterLink *link, int status, int64_t pts)
+static void update_link_current_pts(AVFilterLink *link, int64_t pts)
+{
+    if (pts == AV_NOPTS_VALUE)
+        return;
+    link->current_pts = pts;
+    link->current_pts_us = av_rescale_q(pts, link->time_base, AV_TIME_BASE_Q);
+    /* TODO use duration */
+    if (link->graph && link->age_index >= 0)
+        ff_avfilter_graph_update_heap(link->graph, link);
+}
+
+void ff_update_link_current_pts(AVFilterLink *link, int64_t pts)
+{
+    ff_filter_graph_lock(link->dst->graph);
+    update_link_current_pts(link, pts);
+    ff_filter_graph_unlock(link->dst->graph);
+}
+
+static void link_set_in_status(AVFilterLink *link, int status, int64_t pts)
 {
     if (link->status_in == status)
         return;
@@ -218,18 +272,32 @@ void ff_avfilter_link_set_in_status(AVFilterLink *link, int status, int64_t pts)
     link->frame_wanted_out = 0;
     link->frame_blocked_in = 0;
     filter_unblock(link->dst);
-    ff_filter_set_ready(link->dst, 200);
+    filter_set_ready(link->dst, 200);
 }
 
-void ff_avfilter_link_set_out_status(AVFilterLink *link, int status, int64_t pts)
+void ff_avfilter_link_set_in_status(AVFilterLink *link, int status, int64_t pts)
+{
+    ff_filter_graph_lock(link->dst->graph);
+    link_set_in_status(link, status, pts);
+    ff_filter_graph_unlock(link->dst->graph);
+}
+
+static void link_set_out_status(AVFilterLink *link, int status, int64_t pts)
 {
     av_assert0(!link->frame_wanted_out);
     av_assert0(!link->status_out);
     link->status_out = status;
     if (pts != AV_NOPTS_VALUE)
-        ff_update_link_current_pts(link, pts);
+        update_link_current_pts(link, pts);
     filter_unblock(link->dst);
-    ff_filter_set_ready(link->src, 200);
+    filter_set_ready(link->src, 200);
+}
+
+void ff_avfilter_link_set_out_status(AVFilterLink *link, int status, int64_t pts)
+{
+    ff_filter_graph_lock(link->dst->graph);
+    link_set_out_status(link, status, pts);
+    ff_filter_graph_unlock(link->dst->graph);
 }
 
 void avfilter_link_set_closed(AVFilterLink *link, int closed)
@@ -404,10 +472,8 @@ void ff_tlog_link(void *ctx, AVFilterLink *link, int end)
     }
 }
 
-int ff_request_frame(AVFilterLink *link)
+static int request_frame(AVFilterLink *link)
 {
-    FF_TPRINTF_START(NULL, request_frame); ff_tlog_link(NULL, link, 1);
-
     av_assert1(!link->dst->filter->activate);
     if (link->status_out)
         return link->status_out;
@@ -420,15 +486,27 @@ int ff_request_frame(AVFilterLink *link)
             /* Acknowledge status change. Filters using ff_request_frame() will
                handle the change automatically. Filters can also check the
                status directly but none do yet. */
-            ff_avfilter_link_set_out_status(link, link->status_in, link->status_in_pts);
+            link_set_out_status(link, link->status_in, link->status_in_pts);
             return link->status_out;
         }
     }
     link->frame_wanted_out = 1;
-    ff_filter_set_ready(link->src, 100);
+    filter_set_ready(link->src, 100);
     return 0;
 }
 
+int ff_request_frame(AVFilterLink *link)
+{
+    int ret;
+
+    FF_TPRINTF_START(NULL, request_frame); ff_tlog_link(NULL, link, 1);
+
+    ff_filter_graph_lock(link->dst->graph);
+    ret = request_frame(link);
+    ff_filter_graph_unlock(link->dst->graph);
+    return ret;
+}
+
 static int64_t guess_status_pts(AVFilterContext *ctx, int status, AVRational link_time_base)
 {
     unsigned i;
@@ -453,14 +531,18 @@ static int ff_request_frame_to_filter(AVFilterLink *link)
 
     FF_TPRINTF_START(NULL, request_frame_to_filter); ff_tlog_link(NULL, link, 1);
     /* Assume the filter is blocked, let the method clear it if not */
+    ff_filter_graph_lock(link->dst->graph);
     link->frame_blocked_in = 1;
+    ff_filter_graph_unlock(link->dst->graph);
     if (link->srcpad->request_frame)
         ret = link->srcpad->request_frame(link);
     else if (link->src->inputs[0])
         ret = ff_request_frame(link->src->inputs[0]);
     if (ret < 0) {
+        ff_filter_graph_lock(link->dst->graph);
         if (ret != AVERROR(EAGAIN) && ret != link->status_in)
-            ff_avfilter_link_set_in_status(link, ret, guess_status_pts(link->src, ret, link->time_base));
+            link_set_in_status(link, ret, guess_status_pts(link->src, ret, link->time_base));
+        ff_filter_graph_unlock(link->dst->graph);
         if (ret == AVERROR_EOF)
             ret = 0;
     }
@@ -525,17 +607,6 @@ static int set_enable_expr(AVFilterContext *ctx, const char *expr)
     return 0;
 }
 
-void ff_update_link_current_pts(AVFilterLink *link, int64_t pts)
-{
-    if (pts == AV_NOPTS_VALUE)
-        return;
-    link->current_pts = pts;
-    link->current_pts_us = av_rescale_q(pts, link->time_base, AV_TIME_BASE_Q);
-    /* TODO use duration */
-    if (link->graph && link->age_index >= 0)
-        ff_avfilter_graph_update_heap(link->graph, link);
-}
-
 int avfilter_process_command(AVFilterContext *filter, const char *cmd, const char *arg, char *res, int res_len, int flags)
 {
     if(!strcmp(cmd, "ping")){
@@ -773,6 +844,13 @@ void avfilter_free(AVFilterContext *filter)
     while(filter->command_queue){
         ff_command_queue_pop(filter);
     }
+    while (filter->internal->deferred_commands) {
+        AVFilterCommand *c = filter->internal->deferred_commands;
+        filter->internal->deferred_commands = c->next;
+        av_freep(&c->arg);
+        av_freep(&c->command);
+        av_free(c);
+    }
     av_opt_free(filter);
     av_expr_free(filter->enable);
     filter->enable = NULL;
@@ -1107,15 +1185,18 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
         }
     }
 
+    ff_filter_graph_lock(link->dst->graph);
     link->frame_blocked_in = link->frame_wanted_out = 0;
     link->frame_count_in++;
     filter_unblock(link->dst);
     ret = ff_framequeue_add(&link->fifo, frame);
     if (ret < 0) {
+        ff_filter_graph_unlock(link->dst->graph);
         av_frame_free(&frame);
         return ret;
     }
-    ff_filter_set_ready(link->dst, 300);
+    filter_set_ready(link->dst, 300);
+    ff_filter_graph_unlock(link->dst->graph);
     return 0;
 
 error:
@@ -1207,7 +1288,9 @@ static int ff_filter_frame_to_filter(AVFilterLink *link)
     }
     /* The filter will soon have received a new frame, that may allow it to
        produce one or more: unblock its outputs. */
+    ff_filter_graph_lock(dst->graph);
     filter_unblock(dst);
+    ff_filter_graph_unlock(dst->graph);
     /* AVFilterPad.filter_frame() expect frame_count_out to have the value
        before the frame; ff_filter_frame_framed() will re-increment it. */
     link->frame_count_out--;
@@ -1222,8 +1305,9 @@ static int ff_filter_frame_to_filter(AVFilterLink *link)
     return ret;
 }
 
-static int forward_status_change(AVFilterContext *filter, AVFilterLink *in)
+static int forward_status_change(AVFilterLink *in)
 {
+    AVFilterContext *filter = in->dst;
     unsigned out = 0, progress = 0;
     int ret;
 
@@ -1233,7 +1317,7 @@ static int forward_status_change(AVFilterContext *filter, AVFilterLink *in)
         return 0;
     }
     while (!in->status_out) {
-        if (!filter->outputs[out]->status_in) {
+        if (!ff_outlink_get_status(filter->outputs[out])) {
             progress++;
             ret = ff_request_frame_to_filter(filter->outputs[out]);
             if (ret < 0)
@@ -1256,26 +1340,33 @@ static int forward_status_change(AVFilterContext *filter, AVFilterLink *in)
 
 static int ff_filter_activate_default(AVFilterContext *filter)
 {
+    int (*action)(AVFilterLink *link) = NULL;
+    AVFilterLink *link = NULL;
     unsigned i;
 
-    for (i = 0; i < filter->nb_inputs; i++) {
+    ff_filter_graph_lock(filter->graph);
+    for (i = 0; i < filter->nb_inputs && !action; i++) {
         if (samples_ready(filter->inputs[i], filter->inputs[i]->min_samples)) {
-            return ff_filter_frame_to_filter(filter->inputs[i]);
+            link   = filter->inputs[i];
+            action = ff_filter_frame_to_filter;
         }
     }
-    for (i = 0; i < filter->nb_inputs; i++) {
+    for (i = 0; i < filter->nb_inputs && !action; i++) {
         if (filter->inputs[i]->status_in && !filter->inputs[i]->status_out) {
             av_assert1(!ff_framequeue_queued_frames(&filter->inputs[i]->fifo));
-            return forward_status_change(filter, filter->inputs[i]);
+            link   = filter->inputs[i];
+            action = forward_status_change;
         }
     }
-    for (i = 0; i < filter->nb_outputs; i++) {
+    for (i = 0; i < filter->nb_outputs && !action; i++) {
         if (filter->outputs[i]->frame_wanted_out &&
             !filter->outputs[i]->frame_blocked_in) {
-            return ff_request_frame_to_filter(filter->outputs[i]);
+            link   = filter->outputs[i];
+            action = ff_request_frame_to_filter;
         }
     }
-    return FFERROR_NOT_READY;
+    ff_filter_graph_unlock(filter->graph);
+    return action ? action(link) : FFERROR_NOT_READY;
 }
 
 /*
@@ -1420,7 +1511,9 @@ int ff_filter_activate(AVFilterContext *filter)
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
+    ff_filter_graph_lock(filter->graph);
     filter->ready = 0;
+    ff_filter_graph_unlock(filter->graph);
     ret = filter->filter->activate ? filter->filter->activate(filter) :
           ff_filter_activate_default(filter);
     if (ret == FFERROR_NOT_READY)
@@ -1430,91 +1523,137 @@ int ff_filter_activate(AVFilterContext *filter)
 
 int ff_inlink_acknowledge_status(AVFilterLink *link, int *rstatus, int64_t *rpts)
 {
+    int ret = 1;
+
+    ff_filter_graph_lock(link->dst->graph);
     *rpts = link->current_pts;
-    if (ff_framequeue_queued_frames(&link->fifo))
-        return *rstatus = 0;
-    if (link->status_out)
-        return *rstatus = link->status_out;
-    if (!link->status_in)
-        return *rstatus = 0;
-    *rstatus = link->status_out = link->status_in;
-    ff_update_link_current_pts(link, link->status_in_pts);
-    *rpts = link->current_pts;
-    return 1;
+    if (ff_framequeue_queued_frames(&link->fifo)) {
+        ret = *rstatus = 0;
+    } else if (link->status_out) {
+        ret = *rstatus = link->status_out;
+    } else if (!link->status_in) {
+        ret = *rstatus = 0;
+    } else {
+        *rstatus = link->status_out = link->status_in;
+        update_link_current_pts(link, link->status_in_pts);
+        *rpts = link->current_pts;
+    }
+    ff_filter_graph_unlock(link->dst->graph);
+    return ret;
 }
 
 size_t ff_inlink_queued_frames(AVFilterLink *link)
 {
-    return ff_framequeue_queued_frames(&link->fifo);
+    size_t ret;
+
+    ff_filter_graph_lock(link->dst->graph);
+    ret = ff_framequeue_queued_frames(&link->fifo);
+    ff_filter_graph_unlock(link->dst->graph);
+    return ret;
 }
 
 int ff_inlink_check_available_frame(AVFilterLink *link)
 {
-    return ff_framequeue_queued_frames(&link->fifo) > 0;
+    return ff_inlink_queued_frames(link) > 0;
 }
 
 int ff_inlink_queued_samples(AVFilterLink *link)
 {
-    return ff_framequeue_queued_samples(&link->fifo);
+    int ret;
+
+    ff_filter_graph_lock(link->dst->graph);
+    ret = ff_framequeue_queued_samples(&link->fifo);
+    ff_filter_graph_unlock(link->dst->graph);
+    return ret;
 }
 
-int ff_inlink_check_available_samples(AVFilterLink *link, unsigned min)
+static int check_available_samples(AVFilterLink *link, unsigned min)
 {
     uint64_t samples = ff_framequeue_queued_samples(&link->fifo);
     av_assert1(min);
     return samples >= min || (link->status_in && samples);
 }
 
+int ff_inlink_check_available_samples(AVFilterLink *link, unsigned min)
+{
+    int ret;
+
+    ff_filter_graph_lock(link->dst->graph);
+    ret = check_available_samples(link, min);
+    ff_filter_graph_unlock(link->dst->graph);
+    return ret;
+}
+
 static void consume_update(AVFilterLink *link, const AVFrame *frame)
 {
-    ff_update_link_current_pts(link, frame->pts);
     ff_inlink_process_commands(link, frame);
     link->dst->is_disabled = !ff_inlink_evaluate_timeline_at_frame(link, frame);
     link->frame_count_out++;
 }
 
+static int consume_samples(AVFilterLink *link, unsigned min, unsigned max,
+                           AVFrame **rframe)
+{
+    int ret;
+
+    av_assert1(min);
+    if (!check_available_samples(link, min))
+        return 0;
+    if (link->status_in)
+        min = FFMIN(min, ff_framequeue_queued_samples(&link->fifo));
+    ret = take_samples(link, min, max, rframe);
+    if (ret < 0)
+        return ret;
+    update_link_current_pts(link, (*rframe)->pts);
+    return 1;
+}
+
 int ff_inlink_consume_frame(AVFilterLink *link, AVFrame **rframe)
 {
     AVFrame *frame;
+    int ret = 1;
 
     *rframe = NULL;
-    if (!ff_inlink_check_available_frame(link))
-        return 0;
-
-    if (link->fifo.samples_skipped) {
+    ff_filter_graph_lock(link->dst->graph);
+    if (!ff_framequeue_queued_frames(&link->fifo)) {
+        ret = 0;
+    } else if (link->fifo.samples_skipped) {
         frame = ff_framequeue_peek(&link->fifo, 0);
-        return ff_inlink_consume_samples(link, frame->nb_samples, frame->nb_samples, rframe);
+        ret = consume_samples(link, frame->nb_samples, frame->nb_samples, rframe);
+    } else {
+        *rframe = ff_framequeue_take(&link->fifo);
+        update_link_current_pts(link, (*rframe)->pts);
     }
+    ff_filter_graph_unlock(link->dst->graph);
 
-    frame = ff_framequeue_take(&link->fifo);
-    consume_update(link, frame);
-    *rframe = frame;
-    return 1;
+    if (ret > 0)
+        consume_update(link, *rframe);
+    return ret;
 }
 
 int ff_inlink_consume_samples(AVFilterLink *link, unsigned min, unsigned max,
                             AVFrame **rframe)
 {
-    AVFrame *frame;
     int ret;
 
-    av_assert1(min);
     *rframe = NULL;
-    if (!ff_inlink_check_available_samples(link, min))
-        return 0;
-    if (link->status_in)
-        min = FFMIN(min, ff_framequeue_queued_samples(&link->fifo));
-    ret = take_samples(link, min, max, &frame);
-    if (ret < 0)
-        return ret;
-    consume_update(link, frame);
-    *rframe = frame;
-    return 1;
+    ff_filter_graph_lock(link->dst->graph);
+    ret = consume_samples(link, min, max, rframe);
+    ff_filter_graph_unlock(link->dst->graph);
+
+    if (ret > 0)
+        consume_update(link, *rframe);
+    return ret;
 }
 
 AVFrame *ff_inlink_peek_frame(AVFilterLink *link, size_t idx)
 {
-    return ff_framequeue_peek(&link->fifo, idx);
+    AVFrame *frame;
+
+    ff_filter_graph_lock(link->dst->graph);
+    frame = ff_framequeue_peek(&link->fifo, idx);
+    ff_filter_graph_unlock(link->dst->graph);
+    return frame;
 }
 
 int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
@@ -1601,30 +1740,51 @@ int ff_inlink_evaluate_timeline_at_frame(AVFilterLink *link, const AVFrame *fram
 
 void ff_inlink_request_frame(AVFilterLink *link)
 {
+    ff_filter_graph_lock(link->dst->graph);
     av_assert1(!link->status_in);
     av_assert1(!link->status_out);
     link->frame_wanted_out = 1;
-    ff_filter_set_ready(link->src, 100);
+    filter_set_ready(link->src, 100);
+    ff_filter_graph_unlock(link->dst->graph);
 }
 
 void ff_inlink_set_status(AVFilterLink *link, int status)
 {
-    if (link->status_out)
+    ff_filter_graph_lock(link->dst->graph);
+    if (link->status_out) {
+        ff_filter_graph_unlock(link->dst->graph);
         return;
+    }
     link->frame_wanted_out = 0;
     link->frame_blocked_in = 0;
-    ff_avfilter_link_set_out_status(link, status, AV_NOPTS_VALUE);
+    link_set_out_status(link, status, AV_NOPTS_VALUE);
     while (ff_framequeue_queued_frames(&link->fifo)) {
            AVFrame *frame = ff_framequeue_take(&link->fifo);
            av_frame_free(&frame);
     }
     if (!link->status_in)
         link->status_in = status;
+    ff_filter_graph_unlock(link->dst->graph);
+}
+
+int ff_outlink_frame_wanted(AVFilterLink *link)
+{
+    int ret;
+
+    ff_filter_graph_lock(link->dst->graph);
+    ret = link->frame_wanted_out;
+    ff_filter_graph_unlock(link->dst->graph);
+    return ret;
 }
 
 int ff_outlink_get_status(AVFilterLink *link)
 {
-    return link->status_in;
+    int ret;
+
+    ff_filter_graph_lock(link->dst->graph);
+    ret = link->status_in;
+    ff_filter_graph_unlock(link->dst->graph);
+    return ret;
 }
 
 const AVClass *avfilter_get_class(void)
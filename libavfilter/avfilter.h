@@ -331,6 +331,11 @@ typedef struct AVFilter {
  * Process multiple parts of the frame concurrently.
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
+/**
+ * Activate different filters of the graph concurrently.
+ * Only meaningful in AVFilterGraph.thread_type.
+ */
+#define AVFILTER_THREAD_FRAME (1 << 1)
 
 typedef struct AVFilterInternal AVFilterInternal;
 
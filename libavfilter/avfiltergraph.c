@@ -50,6 +50,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "frame", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_FRAME }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, F|V|A },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
@@ -78,6 +79,38 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+int ff_graph_frame_thread_init(AVFilterGraph *graph)
+{
+    return 0;
+}
+
+void ff_graph_frame_thread_free(AVFilterGraph *graph)
+{
+}
+
+void ff_graph_frame_thread_wake(AVFilterGraph *graph, AVFilterContext *filter)
+{
+}
+
+int ff_graph_frame_thread_run_once(AVFilterGraph *graph)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_graph_frame_thread_wait(AVFilterGraph *graph, int flush)
+{
+    return 0;
+}
+
+int ff_filter_claim(AVFilterContext *filter, const AVFilterCommand *cmd)
+{
+    return 0;
+}
+
+void ff_filter_release(AVFilterContext *filter)
+{
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -122,6 +155,8 @@ void avfilter_graph_free(AVFilterGraph **graph)
     if (!*graph)
         return;
 
+    ff_graph_frame_thread_free(*graph);
+
     while ((*graph)->nb_filters)
         avfilter_free((*graph)->filters[0]);
 
@@ -1282,6 +1317,9 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    if (graphctx->thread_type & AVFILTER_THREAD_FRAME &&
+        (ret = ff_graph_frame_thread_init(graphctx)) < 0)
+        return ret;
 
     return 0;
 }
@@ -1305,7 +1343,15 @@ int avfilter_graph_send_command(AVFilterGraph *graph, const char *target, const
     for (i = 0; i < graph->nb_filters; i++) {
         AVFilterContext *filter = graph->filters[i];
         if (!strcmp(target, "all") || (filter->name && !strcmp(target, filter->name)) || !strcmp(target, filter->filter->name)) {
-            r = avfilter_process_command(filter, cmd, arg, res, res_len, flags);
+            AVFilterCommand deferred = { NAN, (char *)cmd, (char *)arg, flags };
+            r = ff_filter_claim(filter, &deferred);
+            if (r > 0) {
+                /* handed over to the thread holding the filter */
+                r = 0;
+            } else if (!r) {
+                r = avfilter_process_command(filter, cmd, arg, res, res_len, flags);
+                ff_filter_release(filter);
+            }
             if (r != AVERROR(ENOSYS)) {
                 if ((flags & AVFILTER_CMD_FLAG_ONE) || r < 0)
                     return r;
@@ -1326,19 +1372,14 @@ int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const
     for (i = 0; i < graph->nb_filters; i++) {
         AVFilterContext *filter = graph->filters[i];
         if(filter && (!strcmp(target, "all") || !strcmp(target, filter->name) || !strcmp(target, filter->filter->name))){
-            AVFilterCommand **queue = &filter->command_queue, *next;
-            while (*queue && (*queue)->time <= ts)
-                queue = &(*queue)->next;
-            next = *queue;
-            *queue = av_mallocz(sizeof(AVFilterCommand));
-            if (!*queue)
-                return AVERROR(ENOMEM);
-
-            (*queue)->command = av_strdup(command);
-            (*queue)->arg     = av_strdup(arg);
-            (*queue)->time    = ts;
-            (*queue)->flags   = flags;
-            (*queue)->next    = next;
+            AVFilterCommand cmd = { ts, (char *)command, (char *)arg, flags };
+            int ret = ff_filter_claim(filter, &cmd);
+            if (!ret) {
+                ret = ff_command_queue_insert(filter, command, arg, flags, ts);
+                ff_filter_release(filter);
+            }
+            if (ret < 0)
+                return ret;
             if(flags & AVFILTER_CMD_FLAG_ONE)
                 return 0;
         }
@@ -1403,7 +1444,9 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     int r;
 
     while (graph->sink_links_count) {
+        ff_filter_graph_lock(graph);
         oldest = graph->sink_links[0];
+        ff_filter_graph_unlock(graph);
         if (oldest->dst->filter->activate) {
             /* For now, buffersink is the only filter implementing activate. */
             r = av_buffersink_get_frame_flags(oldest->dst, NULL,
@@ -1419,21 +1462,32 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
                oldest->dst ? oldest->dst->name : "unknown",
                oldest->dstpad ? oldest->dstpad->name : "unknown");
         /* EOF: remove the link from the heap */
+        ff_filter_graph_lock(graph);
         if (oldest->age_index < --graph->sink_links_count)
             heap_bubble_down(graph, graph->sink_links[graph->sink_links_count],
                              oldest->age_index);
         oldest->age_index = -1;
+        ff_filter_graph_unlock(graph);
     }
     if (!graph->sink_links_count)
         return AVERROR_EOF;
     av_assert1(!oldest->dst->filter->activate);
     av_assert1(oldest->age_index >= 0);
+    ff_filter_graph_lock(graph);
     frame_count = oldest->frame_count_out;
-    while (frame_count == oldest->frame_count_out) {
+    ff_filter_graph_unlock(graph);
+    while (1) {
+        int done, request;
+
         r = ff_filter_graph_run_once(graph);
-        if (r == AVERROR(EAGAIN) &&
-            !oldest->frame_wanted_out && !oldest->frame_blocked_in &&
-            !oldest->status_in)
+        ff_filter_graph_lock(graph);
+        done    = frame_count != oldest->frame_count_out;
+        request = !oldest->frame_wanted_out && !oldest->frame_blocked_in &&
+                  !oldest->status_in;
+        ff_filter_graph_unlock(graph);
+        if (done)
+            break;
+        if (r == AVERROR(EAGAIN) && request)
             ff_request_frame(oldest);
         else if (r < 0)
             return r;
@@ -1446,6 +1500,8 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
     AVFilterContext *filter;
     unsigned i;
 
+    if (graph->internal->frame_thread)
+        return ff_graph_frame_thread_run_once(graph);
     av_assert0(graph->nb_filters);
     filter = graph->filters[0];
     for (i = 1; i < graph->nb_filters; i++)
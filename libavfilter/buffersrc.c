@@ -176,10 +176,16 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
     return ret;
 }
 
-static int push_frame(AVFilterGraph *graph)
+static int push_frame(AVFilterGraph *graph, int flush)
 {
     int ret;
 
+    /* The frame threads are already processing the frame: only wait for
+       them to catch up, so that the application does not queue frames
+       indefinitely. */
+    if (graph->internal->frame_thread)
+        return ff_graph_frame_thread_wait(graph, flush);
+
     while (1) {
         ret = ff_filter_graph_run_once(graph);
         if (ret == AVERROR(EAGAIN))
@@ -190,17 +196,12 @@ static int push_frame(AVFilterGraph *graph)
     return 0;
 }
 
-static int av_buffersrc_add_frame_internal(AVFilterContext *ctx,
-                                           AVFrame *frame, int flags)
+static int send_frame(AVFilterContext *ctx, AVFrame *frame, int flags)
 {
     BufferSourceContext *s = ctx->priv;
     AVFrame *copy;
     int refcounted, ret;
 
-    s->nb_failed_requests = 0;
-
-    if (!frame)
-        return av_buffersrc_close(ctx, AV_NOPTS_VALUE, flags);
     if (s->eof)
         return AVERROR(EINVAL);
 
@@ -239,12 +240,27 @@ static int av_buffersrc_add_frame_internal(AVFilterContext *ctx,
         }
     }
 
-    ret = ff_filter_frame(ctx->outputs[0], copy);
+    return ff_filter_frame(ctx->outputs[0], copy);
+}
+
+static int av_buffersrc_add_frame_internal(AVFilterContext *ctx,
+                                           AVFrame *frame, int flags)
+{
+    BufferSourceContext *s = ctx->priv;
+    int ret;
+
+    ff_filter_claim(ctx, NULL);
+    s->nb_failed_requests = 0;
+    ret = frame ? send_frame(ctx, frame, flags) : 0;
+    ff_filter_release(ctx);
     if (ret < 0)
         return ret;
 
+    if (!frame)
+        return av_buffersrc_close(ctx, AV_NOPTS_VALUE, flags);
+
     if ((flags & AV_BUFFERSRC_FLAG_PUSH)) {
-        ret = push_frame(ctx->graph);
+        ret = push_frame(ctx->graph, 0);
         if (ret < 0)
             return ret;
     }
@@ -256,9 +272,11 @@ int av_buffersrc_close(AVFilterContext *ctx, int64_t pts, unsigned flags)
 {
     BufferSourceContext *s = ctx->priv;
 
+    ff_filter_claim(ctx, NULL);
     s->eof = 1;
     ff_avfilter_link_set_in_status(ctx->outputs[0], AVERROR_EOF, pts);
-    return (flags & AV_BUFFERSRC_FLAG_PUSH) ? push_frame(ctx->graph) : 0;
+    ff_filter_release(ctx);
+    return (flags & AV_BUFFERSRC_FLAG_PUSH) ? push_frame(ctx->graph, 1) : 0;
 }
 
 static av_cold int init_video(AVFilterContext *ctx)
@@ -25,6 +25,7 @@
  */
 
 #include "libavutil/internal.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "formats.h"
 #include "framepool.h"
@@ -138,12 +139,44 @@ struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+    /**
+     * Frame threading scheduler, NULL when filters are activated by the
+     * thread calling ff_filter_graph_run_once().
+     */
+    void *frame_thread;
+    /**
+     * Protects the links and the ready fields of the filters while
+     * frame_thread is set.
+     */
+    AVMutex lock;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+    /**
+     * Set while a frame thread activates the filter or while the
+     * application holds it with ff_filter_claim().
+     */
+    int busy;
+    /**
+     * Commands that frame threads sent to the filter while another thread
+     * was holding it, see ff_filter_claim(). Protected by the graph lock.
+     */
+    AVFilterCommand *deferred_commands;
 };
 
+static inline void ff_filter_graph_lock(AVFilterGraph *graph)
+{
+    if (graph && graph->internal->frame_thread)
+        ff_mutex_lock(&graph->internal->lock);
+}
+
+static inline void ff_filter_graph_unlock(AVFilterGraph *graph)
+{
+    if (graph && graph->internal->frame_thread)
+        ff_mutex_unlock(&graph->internal->lock);
+}
+
 /**
  * Tell if an integer is contained in the provided -1-terminated list of integers.
  * This is useful for determining (for instance) if an AVPixelFormat is in an
@@ -234,6 +267,13 @@ void ff_avfilter_link_set_out_status(AVFilterLink *link, int status, int64_t pts
 
 void ff_command_queue_pop(AVFilterContext *filter);
 
+/**
+ * Insert a command in the queue of a filter, to be processed with the
+ * first frame at or after ts seconds.
+ */
+int ff_command_queue_insert(AVFilterContext *filter, const char *command,
+                            const char *arg, int flags, double ts);
+
 /* misc trace functions */
 
 #define FF_TPRINTF_START(ctx, func) ff_tlog(NULL, "%-16s: ", #func)
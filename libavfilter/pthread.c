@@ -23,12 +23,17 @@
 
 #include "config.h"
 
+#include <stddef.h>
+
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 #include "libavutil/slicethread.h"
 
+#define FF_INTERNAL_FIELDS 1
+#include "framequeue.h"
+
 #include "avfilter.h"
 #include "internal.h"
 #include "thread.h"
@@ -37,6 +42,8 @@ typedef struct ThreadContext {
     AVFilterGraph *graph;
     AVSliceThread *thread;
     avfilter_action_func *func;
+    /* filters activated by different frame threads share the slice threads */
+    pthread_mutex_t execute_lock;
 
     /* per-execute parameters */
     AVFilterContext *ctx;
@@ -55,6 +62,7 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
 static void slice_thread_uninit(ThreadContext *c)
 {
     avpriv_slicethread_free(&c->thread);
+    pthread_mutex_destroy(&c->execute_lock);
 }
 
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -64,21 +72,31 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+    pthread_mutex_lock(&c->execute_lock);
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    pthread_mutex_unlock(&c->execute_lock);
     return 0;
 }
 
 static int thread_init_internal(ThreadContext *c, int nb_threads)
 {
+    int ret;
+
     nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
-    if (nb_threads <= 1)
+    if (nb_threads <= 1) {
+        avpriv_slicethread_free(&c->thread);
+        return FFMAX(nb_threads, 1);
+    }
+    if ((ret = pthread_mutex_init(&c->execute_lock, NULL))) {
         avpriv_slicethread_free(&c->thread);
-    return FFMAX(nb_threads, 1);
+        return AVERROR(ret);
+    }
+    return nb_threads;
 }
 
 int ff_graph_thread_init(AVFilterGraph *graph)
@@ -114,3 +132,335 @@ void ff_graph_thread_free(AVFilterGraph *graph)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
 }
+
+typedef struct FrameWorker {
+    struct FrameThreadContext *c;
+    pthread_t thread;
+    pthread_t self;             ///< thread as seen by the worker itself
+    int started;
+} FrameWorker;
+
+typedef struct FrameThreadContext {
+    AVFilterGraph *graph;
+    FrameWorker *workers;
+    int nb_workers;
+
+    /* all the following fields are protected by graph->internal->lock */
+    pthread_cond_t work_cond;   ///< signalled when a filter becomes ready
+    pthread_cond_t done_cond;   ///< broadcast when a filter stops being busy
+    unsigned nb_active;         ///< number of activations in progress
+    unsigned progress;          ///< number of completed activations
+    int error;                  ///< first activation error not yet returned
+    int quit;
+} FrameThreadContext;
+
+static AVFilterContext *pick_filter(AVFilterGraph *graph)
+{
+    AVFilterContext *filter = NULL;
+    unsigned i;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        if (f->ready && !f->internal->busy && (!filter || f->ready > filter->ready))
+            filter = f;
+    }
+    return filter;
+}
+
+static int graph_idle(FrameThreadContext *c)
+{
+    return !c->nb_active && !pick_filter(c->graph);
+}
+
+/* busy value of the filters activated by the calling thread, -1 outside
+   of the workers */
+static int current_worker(FrameThreadContext *c)
+{
+    pthread_t self = pthread_self();
+    int i;
+
+    for (i = 0; i < c->nb_workers; i++)
+        if (c->workers[i].started && pthread_equal(c->workers[i].self, self))
+            return i + 1;
+    return -1;
+}
+
+/**
+ * Run the commands handed over to the thread holding a filter, and stop
+ * holding it. Called with the graph lock held.
+ */
+static void filter_unhold(FrameThreadContext *c, AVFilterContext *filter)
+{
+    AVMutex *lock = &c->graph->internal->lock;
+    AVFilterCommand *cmd;
+
+    /* check for new commands and release in the same critical section, so
+       none can be handed over to a thread that stopped holding the filter */
+    while ((cmd = filter->internal->deferred_commands)) {
+        filter->internal->deferred_commands = NULL;
+        pthread_mutex_unlock(lock);
+        while (cmd) {
+            AVFilterCommand *next = cmd->next;
+            if (isnan(cmd->time))
+                avfilter_process_command(filter, cmd->command, cmd->arg,
+                                         NULL, 0, cmd->flags);
+            else
+                ff_command_queue_insert(filter, cmd->command, cmd->arg,
+                                        cmd->flags, cmd->time);
+            av_freep(&cmd->command);
+            av_freep(&cmd->arg);
+            av_free(cmd);
+            cmd = next;
+        }
+        pthread_mutex_lock(lock);
+    }
+    filter->internal->busy = 0;
+}
+
+static void *frame_worker(void *arg)
+{
+    FrameWorker *w = arg;
+    FrameThreadContext *c = w->c;
+    AVFilterGraph *graph = c->graph;
+    AVMutex *lock = &graph->internal->lock;
+
+    pthread_mutex_lock(lock);
+    w->self    = pthread_self();
+    w->started = 1;
+    while (!c->quit) {
+        AVFilterContext *filter = pick_filter(graph);
+        int ret, pool_slot;
+
+        if (!filter) {
+            pthread_cond_wait(&c->work_cond, lock);
+            continue;
+        }
+        filter->internal->busy = w - c->workers + 1;
+        c->nb_active++;
+        pthread_mutex_unlock(lock);
+
+        pool_slot = avpriv_thread_pool_enter();
+        ret = ff_filter_activate(filter);
+        if (pool_slot)
+            avpriv_thread_pool_leave();
+
+        pthread_mutex_lock(lock);
+        filter_unhold(c, filter);
+        c->nb_active--;
+        c->progress++;
+        /* EAGAIN only means that a source needs input from the application,
+           which notices it when the graph becomes idle */
+        if (ret < 0 && ret != AVERROR(EAGAIN) && !c->error)
+            c->error = ret;
+        pthread_cond_broadcast(&c->done_cond);
+    }
+    pthread_mutex_unlock(lock);
+    return NULL;
+}
+
+static void frame_thread_stop(FrameThreadContext *c, int nb_workers)
+{
+    int i;
+
+    pthread_mutex_lock(&c->graph->internal->lock);
+    c->quit = 1;
+    pthread_cond_broadcast(&c->work_cond);
+    pthread_mutex_unlock(&c->graph->internal->lock);
+    for (i = 0; i < nb_workers; i++)
+        pthread_join(c->workers[i].thread, NULL);
+}
+
+int ff_graph_frame_thread_init(AVFilterGraph *graph)
+{
+    FrameThreadContext *c;
+    int nb_workers = graph->nb_threads > 0 ? graph->nb_threads : av_cpu_count();
+    int i, ret;
+
+    if (graph->internal->frame_thread || nb_workers <= 1)
+        return 0;
+
+    c = av_mallocz(sizeof(*c));
+    if (!c)
+        return AVERROR(ENOMEM);
+    c->graph   = graph;
+    c->workers = av_calloc(nb_workers, sizeof(*c->workers));
+    if (!c->workers) {
+        av_free(c);
+        return AVERROR(ENOMEM);
+    }
+
+    if ((ret = pthread_mutex_init(&graph->internal->lock, NULL)))
+        goto fail_lock;
+    if ((ret = pthread_cond_init(&c->work_cond, NULL)))
+        goto fail_work_cond;
+    if ((ret = pthread_cond_init(&c->done_cond, NULL)))
+        goto fail_done_cond;
+
+    /* The workers activate the filters ready since configuration as soon as
+       they start, which must happen with the graph lock in use. They also
+       look each other up in current_worker(), so keep them from running
+       until all of them are created. */
+    graph->internal->frame_thread = c;
+    c->nb_workers = nb_workers;
+    pthread_mutex_lock(&graph->internal->lock);
+    for (i = 0; i < nb_workers; i++) {
+        c->workers[i].c = c;
+        if ((ret = pthread_create(&c->workers[i].thread, NULL, frame_worker,
+                                  &c->workers[i]))) {
+            pthread_mutex_unlock(&graph->internal->lock);
+            frame_thread_stop(c, i);
+            graph->internal->frame_thread = NULL;
+            goto fail_create;
+        }
+    }
+    pthread_mutex_unlock(&graph->internal->lock);
+    return 0;
+
+fail_create:
+    pthread_cond_destroy(&c->done_cond);
+fail_done_cond:
+    pthread_cond_destroy(&c->work_cond);
+fail_work_cond:
+    pthread_mutex_destroy(&graph->internal->lock);
+fail_lock:
+    av_free(c->workers);
+    av_free(c);
+    return AVERROR(ret);
+}
+
+void ff_graph_frame_thread_free(AVFilterGraph *graph)
+{
+    FrameThreadContext *c = graph->internal->frame_thread;
+
+    if (!c)
+        return;
+    frame_thread_stop(c, c->nb_workers);
+    graph->internal->frame_thread = NULL;
+    pthread_cond_destroy(&c->done_cond);
+    pthread_cond_destroy(&c->work_cond);
+    pthread_mutex_destroy(&graph->internal->lock);
+    av_free(c->workers);
+    av_free(c);
+}
+
+void ff_graph_frame_thread_wake(AVFilterGraph *graph, AVFilterContext *filter)
+{
+    FrameThreadContext *c = graph->internal->frame_thread;
+
+    if (!filter->internal->busy)
+        pthread_cond_signal(&c->work_cond);
+}
+
+int ff_graph_frame_thread_run_once(AVFilterGraph *graph)
+{
+    FrameThreadContext *c = graph->internal->frame_thread;
+    unsigned progress;
+    int ret;
+
+    pthread_mutex_lock(&graph->internal->lock);
+    progress = c->progress;
+    while (!c->error && c->progress == progress && !graph_idle(c))
+        pthread_cond_wait(&c->done_cond, &graph->internal->lock);
+    ret = c->error;
+    c->error = 0;
+    if (!ret && c->progress == progress)
+        ret = AVERROR(EAGAIN);
+    pthread_mutex_unlock(&graph->internal->lock);
+    return ret;
+}
+
+static size_t queued_frames(AVFilterGraph *graph)
+{
+    size_t nb_frames = 0;
+    unsigned i, j;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+        if (!filter->nb_outputs)
+            continue;
+        for (j = 0; j < filter->nb_inputs; j++)
+            nb_frames += ff_framequeue_queued_frames(&filter->inputs[j]->fifo);
+    }
+    return nb_frames;
+}
+
+int ff_graph_frame_thread_wait(AVFilterGraph *graph, int flush)
+{
+    FrameThreadContext *c = graph->internal->frame_thread;
+    int ret;
+
+    pthread_mutex_lock(&graph->internal->lock);
+    while (!c->error && !graph_idle(c) &&
+           (flush || queued_frames(graph) > c->nb_workers))
+        pthread_cond_wait(&c->done_cond, &graph->internal->lock);
+    ret = c->error;
+    c->error = 0;
+    pthread_mutex_unlock(&graph->internal->lock);
+    return ret;
+}
+
+static AVFilterCommand *copy_command(const AVFilterCommand *cmd)
+{
+    AVFilterCommand *copy = av_mallocz(sizeof(*copy));
+
+    if (!copy)
+        return NULL;
+    copy->time    = cmd->time;
+    copy->flags   = cmd->flags;
+    copy->command = av_strdup(cmd->command);
+    copy->arg     = av_strdup(cmd->arg);
+    if (!copy->command || (cmd->arg && !copy->arg)) {
+        av_freep(&copy->command);
+        av_freep(&copy->arg);
+        av_freep(&copy);
+    }
+    return copy;
+}
+
+int ff_filter_claim(AVFilterContext *filter, const AVFilterCommand *cmd)
+{
+    AVFilterGraph *graph = filter->graph;
+    FrameThreadContext *c = graph ? graph->internal->frame_thread : NULL;
+    int worker, ret = 0;
+
+    if (!c)
+        return 0;
+    pthread_mutex_lock(&graph->internal->lock);
+    worker = current_worker(c);
+    /* filters sending commands to the graph from their callbacks already
+       own themselves */
+    if (filter->internal->busy > 0 && filter->internal->busy == worker) {
+        ret = 0;
+    } else if (filter->internal->busy && worker > 0 && cmd) {
+        AVFilterCommand **tail = &filter->internal->deferred_commands;
+        while (*tail)
+            tail = &(*tail)->next;
+        *tail = copy_command(cmd);
+        ret = *tail ? 1 : AVERROR(ENOMEM);
+    } else {
+        while (filter->internal->busy)
+            pthread_cond_wait(&c->done_cond, &graph->internal->lock);
+        filter->internal->busy = -1;
+    }
+    pthread_mutex_unlock(&graph->internal->lock);
+    return ret;
+}
+
+void ff_filter_release(AVFilterContext *filter)
+{
+    AVFilterGraph *graph = filter->graph;
+    FrameThreadContext *c = graph ? graph->internal->frame_thread : NULL;
+
+    if (!c)
+        return;
+    pthread_mutex_lock(&graph->internal->lock);
+    if (filter->internal->busy > 0) {
+        pthread_mutex_unlock(&graph->internal->lock);
+        return;
+    }
+    filter_unhold(c, filter);
+    if (filter->ready)
+        pthread_cond_signal(&c->work_cond);
+    pthread_cond_broadcast(&c->done_cond);
+    pthread_mutex_unlock(&graph->internal->lock);
+}
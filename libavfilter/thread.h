@@ -25,4 +25,52 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+/**
+ * Start the workers activating the filters of a configured graph.
+ */
+int ff_graph_frame_thread_init(AVFilterGraph *graph);
+
+void ff_graph_frame_thread_free(AVFilterGraph *graph);
+
+/**
+ * Notify the workers that a filter was marked ready.
+ * Must be called with the graph lock held.
+ */
+void ff_graph_frame_thread_wake(AVFilterGraph *graph, AVFilterContext *filter);
+
+/**
+ * Wait until the workers complete an activation.
+ *
+ * @return 0 on progress, AVERROR(EAGAIN) if no filter is ready, or the
+ *         error returned by an activation
+ */
+int ff_graph_frame_thread_run_once(AVFilterGraph *graph);
+
+/**
+ * Wait until no more frames than workers are queued on the inputs of
+ * filters that are not sinks, or, if flush is set, until no filter is ready
+ * anymore.
+ *
+ * @return 0 or the error returned by an activation
+ */
+int ff_graph_frame_thread_wait(AVFilterGraph *graph, int flush);
+
+/**
+ * Get exclusive access to a filter that may be activated by frame threads,
+ * to change its private context from outside its callbacks.
+ *
+ * A frame thread never waits for a filter held by another thread, as that
+ * thread may be waiting for one of its own filters: the command the caller
+ * was about to run is instead handed over to the holder, which runs it
+ * before releasing the filter.
+ *
+ * @param cmd command to send to the filter, or to queue if its time is not
+ *            NAN; copied if the filter is held by another frame thread
+ * @return 0 if the caller now holds the filter, 1 if cmd was handed over,
+ *         a negative AVERROR code on failure
+ */
+int ff_filter_claim(AVFilterContext *filter, const struct AVFilterCommand *cmd);
+
+void ff_filter_release(AVFilterContext *filter);
+
 #endif /* AVFILTER_THREAD_H */
@@ -546,6 +546,11 @@ static int config_props(AVFilterLink *outlink)
             av_opt_set_int(*s, "sws_flags", scale->flags, 0);
             av_opt_set_int(*s, "param0", scale->param[0], 0);
             av_opt_set_int(*s, "param1", scale->param[1], 0);
+            /* Only thread the scaler when asked to with the threads option of
+             * this filter instance, so that scalers inserted automatically
+             * or running next to frame or slice threaded filters do not
+             * compete with them for the CPUs. */
+            av_opt_set_int(*s, "threads", FFMAX(ctx->nb_threads, 1), 0);
             if (scale->in_range != AVCOL_RANGE_UNSPECIFIED)
                 av_opt_set_int(*s, "src_range",
                                scale->in_range == AVCOL_RANGE_JPEG, 0);
@@ -23,92 +23,91 @@
 
 %include "libavutil/x86/x86util.asm"
 
-SECTION_RODATA
+SECTION_RODATA 32
 
-pb_1:     times 16 db 1
-pw_128:   times  8 dw 128
-pw_255:   times  8 dw 255
-pw_257:   times  8 dw 257
+pb_1:     times 32 db 1
+pw_128:   times 16 dw 128
+pw_255:   times 16 dw 255
+pw_257:   times 16 dw 257
+pw_m128:  times 16 dw -128
 
 SECTION .text
 
-INIT_XMM sse4
-cglobal overlay_row_44, 5, 7, 6, 0, d, da, s, a, w, r, x
-    xor          xq, xq
-    movsxdifnidn wq, wd
-    mov          rq, wq
-    and          rq, mmsize/2 - 1
-    cmp          wq, mmsize/2
-    jl .end
-    sub          wq, rq
-    mova         m3, [pw_255]
-    mova         m4, [pw_128]
-    mova         m5, [pw_257]
-    .loop:
-        pmovzxbw    m0, [sq+xq]
-        pmovzxbw    m2, [aq+xq]
-        pmovzxbw    m1, [dq+xq]
-        pmullw      m0, m2
-        pxor        m2, m3
-        pmullw      m1, m2
-        paddw       m0, m4
-        paddw       m0, m1
-        pmulhuw     m0, m5
-        packuswb    m0, m0
-        movq   [dq+xq], m0
-        add         xq, mmsize/2
-        cmp         xq, wq
-        jl .loop
+; m2 = overlay alpha of the pixels
+%macro ALPHA_44 0
+    pmovzxbw    m2, [aq+xq]
+%endmacro
 
-    .end:
-    mov    eax, xd
-    RET
+%macro ALPHA_22 0
+    movu        m1, [aq+2*xq]
+    pandn       m2, m3, m1
+    psllw       m1, 8
+    pavgw       m2, m1
+    pavgw       m2, m1
+    psrlw       m2, 8
+%endmacro
 
-INIT_XMM sse4
-cglobal overlay_row_22, 5, 7, 6, 0, d, da, s, a, w, r, x
-    xor          xq, xq
-    movsxdifnidn wq, wd
-    sub          wq, 1
-    mov          rq, wq
-    and          rq, mmsize/2 - 1
-    cmp          wq, mmsize/2
-    jl .end
-    sub          wq, rq
-    mova         m3, [pw_255]
-    mova         m4, [pw_128]
-    mova         m5, [pw_257]
-    .loop:
-        pmovzxbw    m0, [sq+xq]
-        movu        m1, [aq+2*xq]
-        pandn       m2, m3, m1
-        psllw       m1, 8
-        pavgw       m2, m1
-        pavgw       m2, m1
-        psrlw       m2, 8
-        pmovzxbw    m1, [dq+xq]
-        pmullw      m0, m2
-        pxor        m2, m3
-        pmullw      m1, m2
-        paddw       m0, m4
-        paddw       m0, m1
-        pmulhuw     m0, m5
-        packuswb    m0, m0
-        movq   [dq+xq], m0
-        add         xq, mmsize/2
-        cmp         xq, wq
-        jl .loop
+%macro ALPHA_20 0
+    movu        m2, [aq+2*xq]
+    movu        m1, [daq+2*xq]
+    pmaddubsw   m2, m6
+    pmaddubsw   m1, m6
+    paddw       m2, m1
+    psrlw       m2, 2
+%endmacro
 
-    .end:
-    mov    eax, xd
-    RET
+; d = (s * a + d * (255 - a)) / 255
+%macro BLEND_straight 0
+    pmovzxbw    m1, [dq+xq]
+    pmullw      m0, m2
+    pxor        m2, m3
+    pmullw      m1, m2
+    paddw       m0, m4
+    paddw       m0, m1
+    pmulhuw     m0, m5
+%endmacro
 
-INIT_XMM sse4
-cglobal overlay_row_20, 6, 7, 7, 0, d, da, s, a, w, r, x
+; d = FFMIN(d * (255 - a) / 255 + s, 255)
+%macro BLEND_pm 0
+    pmovzxbw    m1, [dq+xq]
+    pxor        m2, m3
+    pmullw      m1, m2
+    paddw       m1, m4
+    pmulhuw     m1, m5
+    paddw       m0, m1
+%endmacro
+
+; d = av_clip((d - 128) * (255 - a) / 255 + s - 128, -128, 128) + 128,
+; truncated to 8 bits like the C version
+%macro BLEND_pm_uv 0
+    pmovzxbw    m1, [dq+xq]
+    pxor        m2, m3
+    psubw       m1, m4
+    pmullw      m1, m2
+    paddw       m1, m4
+    pmulhw      m1, m5
+    paddw       m0, m1
+    psubw       m0, m4
+    pmaxsw      m0, m7
+    pminsw      m0, m4
+    paddw       m0, m4
+    pand        m0, m3
+%endmacro
+
+; OVERLAY_ROW name, alpha subsampling (44, 22 or 20), blend mode
+%macro OVERLAY_ROW 3
+%if %2 == 20
+cglobal overlay_row_%1, 6, 7, 8, 0, d, da, s, a, w, r, x
     mov         daq, aq
     add         daq, rmp
+%else
+cglobal overlay_row_%1, 5, 7, 8, 0, d, da, s, a, w, r, x
+%endif
     xor          xq, xq
     movsxdifnidn wq, wd
+%if %2 != 44
     sub          wq, 1
+%endif
     mov          rq, wq
     and          rq, mmsize/2 - 1
     cmp          wq, mmsize/2
@@ -117,24 +116,23 @@ cglobal overlay_row_20, 6, 7, 7, 0, d, da, s, a, w, r, x
     mova         m3, [pw_255]
     mova         m4, [pw_128]
     mova         m5, [pw_257]
+%if %2 == 20
     mova         m6, [pb_1]
+%endif
+%ifidn %3, pm_uv
+    mova         m7, [pw_m128]
+%endif
     .loop:
         pmovzxbw    m0, [sq+xq]
-        movu        m2, [aq+2*xq]
-        movu        m1, [daq+2*xq]
-        pmaddubsw   m2, m6
-        pmaddubsw   m1, m6
-        paddw       m2, m1
-        psrlw       m2, 2
-        pmovzxbw    m1, [dq+xq]
-        pmullw      m0, m2
-        pxor        m2, m3
-        pmullw      m1, m2
-        paddw       m0, m4
-        paddw       m0, m1
-        pmulhuw     m0, m5
+        ALPHA_%2
+        BLEND_%3
         packuswb    m0, m0
+%if mmsize == 32
+        vpermq      m0, m0, q3120
+        movu   [dq+xq], xm0
+%else
         movq   [dq+xq], m0
+%endif
         add         xq, mmsize/2
         cmp         xq, wq
         jl .loop
@@ -142,3 +140,22 @@ cglobal overlay_row_20, 6, 7, 7, 0, d, da, s, a, w, r, x
     .end:
     mov    eax, xd
     RET
+%endmacro
+
+%macro OVERLAY_ROWS 0
+OVERLAY_ROW 44,       44, straight
+OVERLAY_ROW 22,       22, straight
+OVERLAY_ROW 20,       20, straight
+OVERLAY_ROW 44_pm,    44, pm
+OVERLAY_ROW 44_pm_uv, 44, pm_uv
+OVERLAY_ROW 22_pm_uv, 22, pm_uv
+OVERLAY_ROW 20_pm_uv, 20, pm_uv
+%endmacro
+
+INIT_XMM sse4
+OVERLAY_ROWS
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+OVERLAY_ROWS
+%endif
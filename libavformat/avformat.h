@@ -1917,12 +1917,19 @@ typedef struct AVFormatContext {
      * additional internal format contexts. Thus the AVFormatContext pointer
      * passed to this callback may be different from the one facing the caller.
      * It will, however, have the same 'opaque' field.
+     *
+     * @note Muxers writing their files in the background, such as hls and dash
+     * with their upload_threads option, call this callback and io_close()
+     * from their own threads, concurrently with each other and with the
+     * thread calling the muxing functions. The callbacks must then be
+     * thread-safe.
      */
     int (*io_open)(struct AVFormatContext *s, AVIOContext **pb, const char *url,
                    int flags, AVDictionary **options);
 
     /**
      * A callback for closing the streams opened with AVFormatContext.io_open().
+     * It may be called from other threads, see AVFormatContext.io_open().
      */
     void (*io_close)(struct AVFormatContext *s, AVIOContext *pb);
 
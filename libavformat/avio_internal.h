@@ -53,6 +53,14 @@ int ffio_init_context(AVIOContext *s,
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Read size bytes from AVIOContext into buf. Whatever is already buffered
+ * is copied, the rest is read straight into buf without going through the
+ * IO buffer, unless the protocol is packet based.
+ * @return number of bytes read or AVERROR
+ */
+int ffio_read_direct(AVIOContext *s, unsigned char *buf, int size);
+
 void ffio_fill(AVIOContext *s, int b, int count);
 
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
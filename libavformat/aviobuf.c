@@ -711,6 +711,21 @@ int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsig
     }
 }
 
+int ffio_read_direct(AVIOContext *s, unsigned char *buf, int size)
+{
+    int direct = s->direct, ret;
+
+    /* Packet based protocols must be read a whole packet at a time */
+    if (s->max_packet_size)
+        return avio_read(s, buf, size);
+
+    s->direct = 1;
+    ret = avio_read(s, buf, size);
+    s->direct = direct;
+
+    return ret;
+}
+
 int avio_read_partial(AVIOContext *s, unsigned char *buf, int size)
 {
     int len;
@@ -151,6 +151,7 @@ typedef struct DASHContext {
     int is_live;
     AVIOInterruptCB *interrupt_callback;
     char *allowed_extensions;
+    int http_persistent;
     AVDictionary *avio_opts;
     int max_url_size;
 
@@ -440,6 +441,9 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     else if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
         return AVERROR_INVALIDDATA;
 
+    if (c->http_persistent && av_strstart(proto_name, "http", NULL))
+        av_dict_set(&tmp, "connection_pool", "1", 0);
+
     av_freep(pb);
     ret = avio_open2(pb, url, AVIO_FLAG_READ, c->interrupt_callback, &tmp);
     if (ret >= 0) {
@@ -2393,6 +2397,8 @@ static const AVOption dash_options[] = {
         OFFSET(allowed_extensions), AV_OPT_TYPE_STRING,
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm,ts"},
         INT_MIN, INT_MAX, FLAGS},
+    {"http_persistent", "Reuse HTTP connections across requests",
+        OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
     {NULL}
 };
 
@@ -47,6 +47,7 @@
 #include "internal.h"
 #include "isom.h"
 #include "os_support.h"
+#include "uploadqueue.h"
 #include "url.h"
 #include "vpcc.h"
 #include "dash.h"
@@ -63,6 +64,7 @@ enum {
     FRAG_TYPE_EVERY_FRAME,
     FRAG_TYPE_DURATION,
     FRAG_TYPE_PFRAMES,
+    FRAG_TYPE_FRAMES,
     FRAG_TYPE_NB
 };
 
@@ -85,6 +87,7 @@ typedef struct AdaptationSet {
     int64_t seg_duration;
     int64_t frag_duration;
     int frag_type;
+    int frag_frames;
     enum AVMediaType media_type;
     AVDictionary *metadata;
     AVRational min_frame_rate, max_frame_rate;
@@ -134,6 +137,7 @@ typedef struct OutputStream {
     int64_t total_pkt_duration;
     int muxer_overhead;
     int frag_type;
+    int frag_frames;
     int64_t gop_size;
     AVRational sar;
     int coding_dependency;
@@ -151,6 +155,7 @@ typedef struct DASHContext {
 #endif
     int64_t seg_duration;
     int64_t frag_duration;
+    int frag_frames;
     int remove_at_exit;
     int use_template;
     int use_timeline;
@@ -196,6 +201,10 @@ typedef struct DASHContext {
     int target_latency_refid;
     AVRational min_playback_rate;
     AVRational max_playback_rate;
+    int upload_threads;
+    int64_t upload_queue_size;
+    int upload_retries;
+    UploadQueue *upload_queue;
 } DASHContext;
 
 static struct codec_string {
@@ -225,6 +234,16 @@ static int dashenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
     DASHContext *c = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
+    if (c->upload_queue && http_base_proto) {
+        AVDictionaryEntry *method = av_dict_get(*options, "method", NULL, 0);
+        /* manifests must not be published before the segments they list,
+         * nor segments deleted before the manifests listing them are replaced */
+        int ordered = av_match_ext(filename, "mpd,m3u8") ||
+                      (method && !strcmp(method->value, "DELETE"));
+        /* the segments of streaming mode are sent while they are written */
+        if (ordered || !c->streaming)
+            return ff_upload_queue_open(c->upload_queue, pb, filename, ordered, options);
+    }
     if (!*pb || !http_base_proto || !c->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
@@ -246,7 +265,7 @@ static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filenam
     if (!*pb)
         return;
 
-    if (!http_base_proto || !c->http_persistent) {
+    if (!http_base_proto || !c->http_persistent || ff_upload_queue_owns(*pb)) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -647,6 +666,7 @@ static void dash_free(AVFormatContext *s)
 
     ff_format_io_close(s, &c->mpd_out);
     ff_format_io_close(s, &c->m3u8_out);
+    ff_upload_queue_free(&c->upload_queue);
 }
 
 static void output_segment_list(OutputStream *os, AVIOContext *out, AVFormatContext *s,
@@ -955,6 +975,7 @@ static int parse_adaptation_sets(AVFormatContext *s)
     // option id=0,descriptor=descriptor_str,streams=0,1,2 and so on
     // option id=0,seg_duration=2.5,frag_duration=0.5,streams=0,1,2
     //        id=1,trick_id=0,seg_duration=10,frag_type=none,streams=3 and so on
+    //        id=2,frag_type=frames,frag_frames=4,streams=4
     // descriptor is useful to the scheme defined by ISO/IEC 23009-1:2014/Amd.2:2015
     // descriptor_str should be a self-closing xml tag.
     // seg_duration and frag_duration have the same syntax as the global options of
@@ -1024,6 +1045,8 @@ static int parse_adaptation_sets(AVFormatContext *s)
                 as->frag_type = FRAG_TYPE_PFRAMES;
             else if (!strcmp(type_str, "every_frame"))
                 as->frag_type = FRAG_TYPE_EVERY_FRAME;
+            else if (!strcmp(type_str, "frames"))
+                as->frag_type = FRAG_TYPE_FRAMES;
             else if (!strcmp(type_str, "none"))
                 as->frag_type = FRAG_TYPE_NONE;
             else {
@@ -1031,6 +1054,21 @@ static int parse_adaptation_sets(AVFormatContext *s)
                 return ret;
             }
             state = parse_default;
+        } else if (state != new_set && av_strstart(p, "frag_frames=", &p)) {
+            char frames_str[16], *end_str;
+
+            n = strcspn(p, ",");
+            snprintf(frames_str, sizeof(frames_str), "%.*s", n, p);
+            p += n;
+            if (*p)
+                p++;
+
+            as->frag_frames = strtol(frames_str, &end_str, 10);
+            if (frames_str == end_str || as->frag_frames <= 0) {
+                av_log(s, AV_LOG_ERROR, "\"%s\" is not a valid number of frames per fragment\n", frames_str);
+                return AVERROR(EINVAL);
+            }
+            state = parse_default;
         } else if (state != new_set && av_strstart(p, "descriptor=", &p)) {
             n = strcspn(p, ">") + 1; //followed by one comma, so plus 1
             if (n < strlen(p)) {
@@ -1435,6 +1473,15 @@ static int dash_init(AVFormatContext *s)
         c->min_playback_rate = c->max_playback_rate = (AVRational) {1, 1};
     }
 
+    if (c->upload_threads > 0 && ff_is_http_proto(s->url)) {
+        ret = ff_upload_queue_alloc(&c->upload_queue, s, c->upload_threads,
+                                    c->upload_queue_size, c->upload_retries);
+        if (ret < 0) {
+            av_log(s, AV_LOG_ERROR, "Failed to start the upload threads\n");
+            return ret;
+        }
+    }
+
     av_strlcpy(c->dirname, s->url, sizeof(c->dirname));
     ptr = strrchr(c->dirname, '/');
     if (ptr) {
@@ -1576,9 +1623,12 @@ static int dash_init(AVFormatContext *s)
             as->frag_duration = c->frag_duration;
         if (as->frag_type < 0)
             as->frag_type = c->frag_type;
+        if (!as->frag_frames)
+            as->frag_frames = c->frag_frames;
         os->seg_duration = as->seg_duration;
         os->frag_duration = as->frag_duration;
         os->frag_type = as->frag_type;
+        os->frag_frames = as->frag_frames;
 
         c->max_segment_duration = FFMAX(c->max_segment_duration, as->seg_duration);
 
@@ -1591,6 +1641,10 @@ static int dash_init(AVFormatContext *s)
             av_log(s, AV_LOG_WARNING, "frag_type set to duration for stream %d but no frag_duration set\n", i);
             os->frag_type = c->streaming ? FRAG_TYPE_EVERY_FRAME : FRAG_TYPE_NONE;
         }
+        if (os->frag_type == FRAG_TYPE_FRAMES && !os->frag_frames) {
+            av_log(s, AV_LOG_WARNING, "frag_type set to frames for stream %d but no frag_frames set\n", i);
+            os->frag_type = c->streaming ? FRAG_TYPE_EVERY_FRAME : FRAG_TYPE_NONE;
+        }
         if (os->frag_type == FRAG_TYPE_DURATION && os->frag_duration > os->seg_duration) {
             av_log(s, AV_LOG_ERROR, "Fragment duration %"PRId64" is longer than Segment duration %"PRId64"\n", os->frag_duration, os->seg_duration);
             return AVERROR(EINVAL);
@@ -2102,7 +2156,8 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
 
     if (!os->availability_time_offset &&
         ((os->frag_type == FRAG_TYPE_DURATION && os->seg_duration != os->frag_duration) ||
-         (os->frag_type == FRAG_TYPE_EVERY_FRAME && pkt->duration))) {
+         (os->frag_type == FRAG_TYPE_EVERY_FRAME && pkt->duration) ||
+         (os->frag_type == FRAG_TYPE_FRAMES && pkt->duration))) {
         AdaptationSet *as = &c->as[os->as_idx - 1];
         int64_t frame_duration = 0;
 
@@ -2113,6 +2168,9 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
         case FRAG_TYPE_EVERY_FRAME:
             frame_duration = av_rescale_q(pkt->duration, st->time_base, AV_TIME_BASE_Q);
             break;
+        case FRAG_TYPE_FRAMES:
+            frame_duration = av_rescale_q(pkt->duration * os->frag_frames, st->time_base, AV_TIME_BASE_Q);
+            break;
         }
 
          os->availability_time_offset = ((double) os->seg_duration -
@@ -2250,6 +2308,14 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
     }
 
+    // close the fragment as soon as it has all its frames, instead of
+    // waiting for the next packet like frag_duration does
+    if (os->frag_type == FRAG_TYPE_FRAMES && !(os->packets_written % os->frag_frames)) {
+        ret = av_write_frame(os->ctx, NULL);
+        if (ret < 0)
+            return ret;
+    }
+
     //write out the data immediately in streaming mode
     if (c->streaming && os->segment_type == SEGMENT_TYPE_MP4) {
         int len = 0;
@@ -2305,6 +2371,12 @@ static int dash_write_trailer(AVFormatContext *s)
         }
     }
 
+    if (c->upload_queue) {
+        int ret = ff_upload_queue_flush(c->upload_queue);
+        if (ret < 0 && !c->ignore_io_errors)
+            return ret;
+    }
+
     return 0;
 }
 
@@ -2345,6 +2417,8 @@ static const AVOption options[] = {
     { "every_frame", "fragment at every frame", 0, AV_OPT_TYPE_CONST, {.i64 = FRAG_TYPE_EVERY_FRAME }, 0, UINT_MAX, E, "frag_type"},
     { "duration", "fragment at specific time intervals", 0, AV_OPT_TYPE_CONST, {.i64 = FRAG_TYPE_DURATION }, 0, UINT_MAX, E, "frag_type"},
     { "pframes", "fragment at keyframes and following P-Frame reordering (Video only, experimental)", 0, AV_OPT_TYPE_CONST, {.i64 = FRAG_TYPE_PFRAMES }, 0, UINT_MAX, E, "frag_type"},
+    { "frames", "fragment every frag_frames frames", 0, AV_OPT_TYPE_CONST, {.i64 = FRAG_TYPE_FRAMES }, 0, UINT_MAX, E, "frag_type"},
+    { "frag_frames", "number of frames per fragment with frag_type frames", OFFSET(frag_frames), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E },
     { "remove_at_exit", "remove all segments when finished", OFFSET(remove_at_exit), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { "use_template", "Use SegmentTemplate instead of SegmentList", OFFSET(use_template), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, E },
     { "use_timeline", "Use SegmentTimeline in SegmentTemplate", OFFSET(use_timeline), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, E },
@@ -2378,6 +2452,9 @@ static const AVOption options[] = {
     { "target_latency", "Set desired target latency for Low-latency dash", OFFSET(target_latency), AV_OPT_TYPE_DURATION, { .i64 = 0 }, 0, INT_MAX, E },
     { "min_playback_rate", "Set desired minimum playback rate", OFFSET(min_playback_rate), AV_OPT_TYPE_RATIONAL, { .dbl = 1.0 }, 0.5, 1.5, E },
     { "max_playback_rate", "Set desired maximum playback rate", OFFSET(max_playback_rate), AV_OPT_TYPE_RATIONAL, { .dbl = 1.0 }, 0.5, 1.5, E },
+    { "upload_threads", "Number of files written at once in the background to HTTP output, 0 to write them synchronously", OFFSET(upload_threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, E },
+    { "upload_queue_size", "Maximum size of the files waiting to be written in the background", OFFSET(upload_queue_size), AV_OPT_TYPE_INT64, { .i64 = 64 << 20 }, 0, INT64_MAX, E },
+    { "upload_retries", "Number of times a failed background write is retried", OFFSET(upload_retries), AV_OPT_TYPE_INT, { .i64 = 2 }, 0, INT_MAX, E },
     { NULL },
 };
 
@@ -19,6 +19,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE /* O_DIRECT and MAP_POPULATE */
+
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
@@ -35,6 +37,13 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -67,6 +76,39 @@
 
 /* standard file protocol */
 
+#if HAVE_LINUX_IO_URING_H
+/* Alignment of the read-ahead blocks in memory and in the file, enough for
+ * O_DIRECT on common block devices */
+#define URING_ALIGN 4096
+
+typedef struct URingBlock {
+    struct iovec iov;
+    int64_t offset;     /* file offset of the block */
+    int result;         /* bytes read or negative errno, set once done */
+    int done;
+} URingBlock;
+
+typedef struct URing {
+    int fd;
+    int file_fd;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    struct io_uring_cqe *cqes;
+
+    uint8_t *buf;
+    URingBlock *blocks;
+    int nb_blocks;
+    int block_size;
+    int head;           /* block holding the lowest file offset in flight */
+    int in_flight;
+    int64_t pos;        /* logical read position */
+} URing;
+#endif
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
@@ -74,9 +116,15 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int uring_depth;
+    int uring_block_size;
+    int direct;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
+#if HAVE_LINUX_IO_URING_H
+    URing *ring;
+#endif
 } FileContext;
 
 static const AVOption file_options[] = {
@@ -84,6 +132,9 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "uring_depth", "set the number of io_uring read-ahead requests kept in flight, 0 disables io_uring", offsetof(FileContext, uring_depth), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 256, AV_OPT_FLAG_DECODING_PARAM },
+    { "uring_block_size", "set the size of each io_uring read-ahead request", offsetof(FileContext, uring_block_size), AV_OPT_TYPE_INT, { .i64 = 262144 }, 4096, 1 << 26, AV_OPT_FLAG_DECODING_PARAM },
+    { "direct", "bypass the page cache with O_DIRECT when reading through io_uring", offsetof(FileContext, direct), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -106,11 +157,292 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_LINUX_IO_URING_H
+static int uring_enter(URing *r, unsigned to_submit, unsigned min_complete)
+{
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+
+    do {
+        ret = syscall(__NR_io_uring_enter, r->fd, to_submit, min_complete,
+                      flags, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+
+    return ret < 0 ? AVERROR(errno) : ret;
+}
+
+static int uring_submit(URing *r, int idx, int64_t offset)
+{
+    URingBlock *b = &r->blocks[idx];
+    unsigned tail = *r->sq_tail, sq_idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[sq_idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = IORING_OP_READV;
+    sqe->fd        = r->file_fd;
+    sqe->addr      = (uintptr_t)&b->iov;
+    sqe->len       = 1;
+    sqe->off       = offset;
+    sqe->user_data = idx;
+
+    b->offset = offset;
+    b->done   = 0;
+    r->sq_array[sq_idx] = sq_idx;
+    atomic_store_explicit((_Atomic unsigned *)r->sq_tail, tail + 1,
+                          memory_order_release);
+    r->in_flight++;
+
+    return uring_enter(r, 1, 0);
+}
+
+/* Collect finished reads, waiting for at least one if wait is set */
+static int uring_reap(URing *r, int wait)
+{
+    unsigned head = *r->cq_head, tail;
+    int ret;
+
+    tail = atomic_load_explicit((_Atomic unsigned *)r->cq_tail,
+                                memory_order_acquire);
+    if (head == tail && wait) {
+        if ((ret = uring_enter(r, 0, 1)) < 0)
+            return ret;
+        tail = atomic_load_explicit((_Atomic unsigned *)r->cq_tail,
+                                    memory_order_acquire);
+    }
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        URingBlock *b = &r->blocks[cqe->user_data];
+        b->result = cqe->res;
+        b->done   = 1;
+        r->in_flight--;
+    }
+    atomic_store_explicit((_Atomic unsigned *)r->cq_head, head,
+                          memory_order_release);
+
+    return 0;
+}
+
+static int uring_wait_block(URing *r, int idx)
+{
+    while (!r->blocks[idx].done) {
+        int ret = uring_reap(r, 1);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+/* Drop all read-ahead and start a new window around pos */
+static int uring_restart(URing *r, int64_t pos)
+{
+    int64_t offset = pos - pos % r->block_size;
+    int ret;
+
+    while (r->in_flight)
+        if ((ret = uring_reap(r, 1)) < 0)
+            return ret;
+
+    r->head = 0;
+    r->pos  = pos;
+    for (int i = 0; i < r->nb_blocks; i++)
+        if ((ret = uring_submit(r, i, offset + (int64_t)i * r->block_size)) < 0)
+            return ret;
+
+    return 0;
+}
+
+static void uring_free(URing **pr)
+{
+    URing *r = *pr;
+
+    if (!r)
+        return;
+
+    /* The kernel may still write into the buffers until the reads finish */
+    while (r->in_flight && uring_reap(r, 1) >= 0);
+
+    if (r->sqes)
+        munmap(r->sqes, r->sqes_size);
+    if (r->cq_ring && r->cq_ring != r->sq_ring)
+        munmap(r->cq_ring, r->cq_ring_size);
+    if (r->sq_ring)
+        munmap(r->sq_ring, r->sq_ring_size);
+    if (r->fd >= 0)
+        close(r->fd);
+    av_freep(&r->buf);
+    av_freep(&r->blocks);
+    av_freep(pr);
+}
+
+static int uring_init(FileContext *c)
+{
+    struct io_uring_params p = { 0 };
+    URing *r;
+    uint8_t *buf;
+    int ret;
+
+    if (!(r = av_mallocz(sizeof(*r))))
+        return AVERROR(ENOMEM);
+    c->ring = r;
+
+    r->file_fd    = c->fd;
+    r->nb_blocks  = c->uring_depth;
+    r->block_size = FFALIGN(c->uring_block_size, URING_ALIGN);
+
+    r->fd = syscall(__NR_io_uring_setup, r->nb_blocks, &p);
+    if (r->fd < 0) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        r->sq_ring_size = r->cq_ring_size = FFMAX(r->sq_ring_size, r->cq_ring_size);
+#endif
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) {
+        r->sq_ring = NULL;
+        ret = AVERROR(errno);
+        goto fail;
+    }
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        r->cq_ring = r->sq_ring;
+    else
+#endif
+    r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    if (r->cq_ring == MAP_FAILED) {
+        r->cq_ring = NULL;
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        ret = AVERROR(errno);
+        goto fail;
+    }
+
+    r->sq_tail  = (unsigned *)((uint8_t *)r->sq_ring + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)((uint8_t *)r->sq_ring + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)((uint8_t *)r->sq_ring + p.sq_off.array);
+    r->cq_head  = (unsigned *)((uint8_t *)r->cq_ring + p.cq_off.head);
+    r->cq_tail  = (unsigned *)((uint8_t *)r->cq_ring + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)((uint8_t *)r->cq_ring + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)((uint8_t *)r->cq_ring + p.cq_off.cqes);
+
+    r->blocks = av_mallocz_array(r->nb_blocks, sizeof(*r->blocks));
+    r->buf    = av_malloc((size_t)r->nb_blocks * r->block_size + URING_ALIGN);
+    if (!r->blocks || !r->buf) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    buf = (uint8_t *)FFALIGN((uintptr_t)r->buf, URING_ALIGN);
+    for (int i = 0; i < r->nb_blocks; i++) {
+        r->blocks[i].iov.iov_base = buf + (size_t)i * r->block_size;
+        r->blocks[i].iov.iov_len  = r->block_size;
+        r->blocks[i].done         = 1;
+    }
+
+    return 0;
+fail:
+    uring_free(&c->ring);
+    return ret;
+}
+
+static int uring_read(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    URing *r = c->ring;
+    int ret;
+
+    for (;;) {
+        URingBlock *b = &r->blocks[r->head];
+        int64_t avail;
+
+        /* Recycle blocks the read position has moved past */
+        if (r->pos >= b->offset + r->block_size) {
+            if ((ret = uring_wait_block(r, r->head)) < 0)
+                return ret;
+            ret = uring_submit(r, r->head, b->offset +
+                               (int64_t)r->nb_blocks * r->block_size);
+            if (ret < 0)
+                return ret;
+            r->head = (r->head + 1) % r->nb_blocks;
+            continue;
+        }
+
+        if ((ret = uring_wait_block(r, r->head)) < 0)
+            return ret;
+        if (b->result < 0)
+            return AVERROR(-b->result);
+
+        avail = b->offset + b->result - r->pos;
+        if (avail <= 0) {
+            struct stat st;
+            /* A short read that does not end at the end of the file, retry
+             * from the current position */
+            if (b->result && !fstat(c->fd, &st) && r->pos < st.st_size) {
+                if ((ret = uring_restart(r, r->pos)) < 0)
+                    return ret;
+                continue;
+            }
+            return AVERROR_EOF;
+        }
+
+        size = FFMIN(size, avail);
+        memcpy(buf, (uint8_t *)b->iov.iov_base + (r->pos - b->offset), size);
+        r->pos += size;
+        return size;
+    }
+}
+
+static int64_t uring_seek(URLContext *h, int64_t pos, int whence)
+{
+    FileContext *c = h->priv_data;
+    URing *r = c->ring;
+    int64_t start = r->blocks[r->head].offset;
+    int ret;
+
+    if (whence == SEEK_CUR) {
+        pos += r->pos;
+    } else if (whence == SEEK_END) {
+        struct stat st;
+        if (fstat(c->fd, &st) < 0)
+            return AVERROR(errno);
+        pos += st.st_size;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    if (pos < start || pos >= start + (int64_t)r->nb_blocks * r->block_size) {
+        if ((ret = uring_restart(r, pos)) < 0)
+            return ret;
+    }
+    r->pos = pos;
+
+    return pos;
+}
+#endif /* HAVE_LINUX_IO_URING_H */
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_LINUX_IO_URING_H
+    if (c->ring)
+        return uring_read(h, buf, size);
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -243,6 +575,33 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+#if HAVE_LINUX_IO_URING_H
+    if (c->uring_depth && !(flags & AVIO_FLAG_WRITE) && !c->follow &&
+        !fstat(fd, &st) && S_ISREG(st.st_mode)) {
+        int ret = uring_init(c);
+        if (ret < 0) {
+            av_log(h, AV_LOG_VERBOSE, "io_uring not available (%s), "
+                   "falling back to read()\n", av_err2str(ret));
+            return 0;
+        }
+        if (c->direct) {
+            fd = avpriv_open(filename, access | O_DIRECT, 0666);
+            if (fd == -1) {
+                av_log(h, AV_LOG_WARNING, "Could not open the file with "
+                       "O_DIRECT: %s\n", av_err2str(AVERROR(errno)));
+            } else {
+                close(c->fd);
+                c->fd = c->ring->file_fd = fd;
+            }
+        }
+        if ((ret = uring_restart(c->ring, 0)) < 0) {
+            uring_free(&c->ring);
+            close(c->fd);
+            return ret;
+        }
+    }
+#endif
+
     return 0;
 }
 
@@ -258,6 +617,11 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+#if HAVE_LINUX_IO_URING_H
+    if (c->ring)
+        return uring_seek(h, pos, whence);
+#endif
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -266,6 +630,9 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+#if HAVE_LINUX_IO_URING_H
+    uring_free(&c->ring);
+#endif
     return close(c->fd);
 }
 
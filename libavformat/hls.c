@@ -33,6 +33,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
@@ -77,6 +78,32 @@ struct segment {
     struct segment *init_section;
 };
 
+/*
+ * A segment downloaded ahead by a prefetch thread. The demuxer reads it
+ * while it is still being downloaded if needed.
+ */
+struct prefetch_segment {
+    struct playlist *pls;
+    int seq_no;
+    char *url;
+    AVDictionary *opts;
+    int64_t url_offset;
+    int64_t size;
+    int is_http;
+
+    /* protected by HLSContext.prefetch_mutex */
+    enum {
+        PREFETCH_QUEUED,
+        PREFETCH_LOADING,
+        PREFETCH_DONE,
+    } state;
+    int cancelled;
+    int error;
+    uint8_t *data;
+    unsigned int data_size;
+    unsigned int allocated;
+};
+
 struct rendition;
 
 enum PlaylistType {
@@ -98,6 +125,11 @@ struct playlist {
     int input_read_done;
     AVIOContext *input_next;
     int input_next_requested;
+    /* segments being prefetched, ordered by sequence number */
+    struct prefetch_segment **prefetch;
+    int n_prefetch;
+    /* prefetched segment being read, first of the prefetch list */
+    struct prefetch_segment *prefetch_cur;
     AVFormatContext *parent;
     int index;
     AVFormatContext *ctx;
@@ -213,6 +245,20 @@ typedef struct HLSContext {
     int http_multiple;
     int http_seekable;
     AVIOContext *playlist_pb;
+    int prefetch_segments;
+    int64_t prefetch_max_size;
+#if HAVE_THREADS
+    pthread_t *prefetch_threads;
+    int nb_prefetch_threads;
+    pthread_mutex_t prefetch_mutex;
+    pthread_cond_t prefetch_cond;
+    int prefetch_abort;
+    int64_t prefetch_size;
+    int prefetch_hits;
+    int prefetch_misses;
+    int prefetch_stalls;
+    int64_t prefetch_stall_time;
+#endif
 } HLSContext;
 
 static void free_segment_dynarray(struct segment **segments, int n_segments)
@@ -243,11 +289,15 @@ static void free_init_section_list(struct playlist *pls)
     pls->n_init_sections = 0;
 }
 
+static void prefetch_cancel(HLSContext *c, struct playlist *pls);
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
+        prefetch_cancel(c, pls);
+        av_freep(&pls->prefetch);
         free_segment_list(pls);
         free_init_section_list(pls);
         av_freep(&pls->main_streams);
@@ -618,13 +668,11 @@ static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
 #endif
 }
 
-static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary *opts, AVDictionary *opts2, int *is_http_out)
+/* Check that url uses one of the protocols the demuxer may access. */
+static int check_url(AVFormatContext *s, const char *url, int *is_http_out)
 {
     HLSContext *c = s->priv_data;
-    AVDictionary *tmp = NULL;
     const char *proto_name = NULL;
-    int ret;
     int is_http = 0;
 
     if (av_strstart(url, "crypto", NULL)) {
@@ -666,8 +714,25 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     else if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
         return AVERROR_INVALIDDATA;
 
+    *is_http_out = is_http;
+    return 0;
+}
+
+static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
+                    AVDictionary *opts, AVDictionary *opts2, int *is_http_out)
+{
+    HLSContext *c = s->priv_data;
+    AVDictionary *tmp = NULL;
+    int ret;
+    int is_http = 0;
+
+    if ((ret = check_url(s, url, &is_http)) < 0)
+        return ret;
+
     av_dict_copy(&tmp, opts, 0);
     av_dict_copy(&tmp, opts2, 0);
+    if (is_http && c->http_persistent)
+        av_dict_set(&tmp, "connection_pool", "1", 0);
 
     if (is_http && c->http_persistent && *pb) {
         ret = open_url_keepalive(c->ctx, pb, url, &tmp);
@@ -746,6 +811,8 @@ static int parse_playlist(HLSContext *c, const char *url,
 
         if (c->http_persistent)
             av_dict_set(&opts, "multiple_requests", "1", 0);
+        if (is_http && c->http_persistent)
+            av_dict_set(&opts, "connection_pool", "1", 0);
 
         ret = c->ctx->io_open(c->ctx, &in, url, AVIO_FLAG_READ, &opts);
         av_dict_free(&opts);
@@ -977,6 +1044,383 @@ static struct segment *next_segment(struct playlist *pls)
     return pls->segments[n];
 }
 
+#if HAVE_THREADS
+static void prefetch_free(HLSContext *c, struct prefetch_segment **pps)
+{
+    struct prefetch_segment *ps = *pps;
+
+    c->prefetch_size -= ps->data_size;
+    av_freep(&ps->url);
+    av_dict_free(&ps->opts);
+    av_freep(&ps->data);
+    av_freep(pps);
+}
+
+static int prefetch_interrupt_cb(void *opaque)
+{
+    struct prefetch_segment *ps = opaque;
+    HLSContext *c = ps->pls->parent->priv_data;
+    int cancelled;
+
+    pthread_mutex_lock(&c->prefetch_mutex);
+    cancelled = ps->cancelled || c->prefetch_abort;
+    pthread_mutex_unlock(&c->prefetch_mutex);
+    return cancelled || ff_check_interrupt(c->interrupt_callback);
+}
+
+static int prefetch_download(HLSContext *c, struct prefetch_segment *ps)
+{
+    AVFormatContext *s = c->ctx;
+    AVIOInterruptCB int_cb = { prefetch_interrupt_cb, ps };
+    AVDictionary *opts = NULL;
+    AVIOContext *pb = NULL;
+    uint8_t buf[INITIAL_BUFFER_SIZE];
+    int64_t left = ps->size >= 0 ? ps->size : INT64_MAX;
+    int ret;
+
+    av_dict_copy(&opts, ps->opts, 0);
+    ret = ffio_open_whitelist(&pb, ps->url, AVIO_FLAG_READ, &int_cb, &opts,
+                              s->protocol_whitelist, s->protocol_blacklist);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+    /* see open_input() */
+    if (!ps->is_http && ps->url_offset &&
+        (ret = avio_seek(pb, ps->url_offset, SEEK_SET)) < 0)
+        goto end;
+
+    while (left > 0) {
+        uint8_t *data;
+
+        ret = avio_read(pb, buf, FFMIN(sizeof(buf), left));
+        if (ret <= 0)
+            break;
+        left -= ret;
+
+        pthread_mutex_lock(&c->prefetch_mutex);
+        if (ps->cancelled || c->prefetch_abort) {
+            pthread_mutex_unlock(&c->prefetch_mutex);
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if (ps->data_size + ret > INT_MAX ||
+            !(data = av_fast_realloc(ps->data, &ps->allocated, ps->data_size + ret))) {
+            pthread_mutex_unlock(&c->prefetch_mutex);
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        ps->data = data;
+        memcpy(ps->data + ps->data_size, buf, ret);
+        ps->data_size     += ret;
+        c->prefetch_size += ret;
+        pthread_cond_broadcast(&c->prefetch_cond);
+        pthread_mutex_unlock(&c->prefetch_mutex);
+    }
+end:
+    ff_format_io_close(s, &pb);
+    return ret == AVERROR_EOF ? 0 : FFMIN(ret, 0);
+}
+
+/* Find the queued segment with the lowest position in its prefetch list. */
+static struct prefetch_segment *prefetch_next_job(HLSContext *c)
+{
+    struct prefetch_segment *job = NULL;
+    int i, j, job_pos = INT_MAX;
+
+    for (i = 0; i < c->n_playlists; i++) {
+        struct playlist *pls = c->playlists[i];
+        for (j = 0; j < FFMIN(pls->n_prefetch, job_pos); j++) {
+            if (pls->prefetch[j]->state == PREFETCH_QUEUED) {
+                job     = pls->prefetch[j];
+                job_pos = j;
+                break;
+            }
+        }
+    }
+    /* once the cache is full, only the segments read next are started */
+    if (job && job_pos && c->prefetch_size >= c->prefetch_max_size)
+        return NULL;
+    return job;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    HLSContext *c = arg;
+
+    pthread_mutex_lock(&c->prefetch_mutex);
+    while (!c->prefetch_abort) {
+        struct prefetch_segment *ps = prefetch_next_job(c);
+        int ret;
+
+        if (!ps) {
+            pthread_cond_wait(&c->prefetch_cond, &c->prefetch_mutex);
+            continue;
+        }
+        ps->state = PREFETCH_LOADING;
+        pthread_mutex_unlock(&c->prefetch_mutex);
+
+        ret = prefetch_download(c, ps);
+
+        pthread_mutex_lock(&c->prefetch_mutex);
+        if (ret < 0 && !ps->cancelled && !c->prefetch_abort)
+            av_log(ps->pls->parent, AV_LOG_WARNING,
+                   "Failed to prefetch segment %d of playlist %d: %s\n",
+                   ps->seq_no, ps->pls->index, av_err2str(ret));
+        ps->state = PREFETCH_DONE;
+        ps->error = ret;
+        if (ps->cancelled)
+            prefetch_free(c, &ps);
+        pthread_cond_broadcast(&c->prefetch_cond);
+    }
+    pthread_mutex_unlock(&c->prefetch_mutex);
+    return NULL;
+}
+
+static int prefetch_start(HLSContext *c)
+{
+    int i, ret;
+
+    if (c->prefetch_threads)
+        return 0;
+    c->prefetch_threads = av_mallocz_array(c->prefetch_segments,
+                                           sizeof(*c->prefetch_threads));
+    if (!c->prefetch_threads)
+        return AVERROR(ENOMEM);
+    if ((ret = pthread_mutex_init(&c->prefetch_mutex, NULL))) {
+        av_freep(&c->prefetch_threads);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&c->prefetch_cond, NULL))) {
+        pthread_mutex_destroy(&c->prefetch_mutex);
+        av_freep(&c->prefetch_threads);
+        return AVERROR(ret);
+    }
+    for (i = 0; i < c->prefetch_segments; i++) {
+        ret = pthread_create(&c->prefetch_threads[i], NULL, prefetch_thread, c);
+        if (ret)
+            break;
+        c->nb_prefetch_threads++;
+    }
+    if (!c->nb_prefetch_threads) {
+        pthread_cond_destroy(&c->prefetch_cond);
+        pthread_mutex_destroy(&c->prefetch_mutex);
+        av_freep(&c->prefetch_threads);
+        return AVERROR(ret);
+    }
+    return 0;
+}
+
+static void prefetch_stop(HLSContext *c)
+{
+    int i, j;
+
+    if (!c->prefetch_threads)
+        return;
+    pthread_mutex_lock(&c->prefetch_mutex);
+    c->prefetch_abort = 1;
+    pthread_cond_broadcast(&c->prefetch_cond);
+    pthread_mutex_unlock(&c->prefetch_mutex);
+    for (i = 0; i < c->nb_prefetch_threads; i++)
+        pthread_join(c->prefetch_threads[i], NULL);
+
+    for (i = 0; i < c->n_playlists; i++) {
+        struct playlist *pls = c->playlists[i];
+        for (j = 0; j < pls->n_prefetch; j++)
+            prefetch_free(c, &pls->prefetch[j]);
+        pls->n_prefetch   = 0;
+        pls->prefetch_cur = NULL;
+    }
+    pthread_cond_destroy(&c->prefetch_cond);
+    pthread_mutex_destroy(&c->prefetch_mutex);
+    av_freep(&c->prefetch_threads);
+
+    if (c->prefetch_hits + c->prefetch_misses)
+        av_log(c->ctx, AV_LOG_VERBOSE,
+               "Prefetch: %d segments read from the cache, %d before they were "
+               "complete, %d stalls for %"PRId64" ms\n",
+               c->prefetch_hits, c->prefetch_misses, c->prefetch_stalls,
+               c->prefetch_stall_time / 1000);
+}
+
+/*
+ * Drop the prefetched segments of a playlist. The segments still being
+ * downloaded are freed by their thread.
+ */
+static void prefetch_cancel(HLSContext *c, struct playlist *pls)
+{
+    int i;
+
+    if (!pls->n_prefetch)
+        return;
+    pthread_mutex_lock(&c->prefetch_mutex);
+    for (i = 0; i < pls->n_prefetch; i++) {
+        struct prefetch_segment *ps = pls->prefetch[i];
+        if (ps->state == PREFETCH_LOADING)
+            ps->cancelled = 1;
+        else
+            prefetch_free(c, &ps);
+    }
+    pls->n_prefetch   = 0;
+    pls->prefetch_cur = NULL;
+    pthread_cond_broadcast(&c->prefetch_cond);
+    pthread_mutex_unlock(&c->prefetch_mutex);
+}
+
+/*
+ * Queue the segments of the prefetch window starting at the current one.
+ * The window stops at the first encrypted segment.
+ */
+static int prefetch_update(HLSContext *c, struct playlist *pls)
+{
+    int seq_no, ret = 0;
+
+    pthread_mutex_lock(&c->prefetch_mutex);
+    while (pls->n_prefetch && pls->prefetch[0]->seq_no != pls->cur_seq_no) {
+        struct prefetch_segment *ps = pls->prefetch[0];
+        if (ps->state == PREFETCH_LOADING)
+            ps->cancelled = 1;
+        else
+            prefetch_free(c, &ps);
+        memmove(pls->prefetch, pls->prefetch + 1,
+                --pls->n_prefetch * sizeof(*pls->prefetch));
+    }
+
+    seq_no = pls->n_prefetch ? pls->prefetch[pls->n_prefetch - 1]->seq_no + 1
+                             : pls->cur_seq_no;
+    for (; seq_no < pls->cur_seq_no + c->prefetch_segments &&
+           seq_no < pls->start_seq_no + pls->n_segments; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        struct prefetch_segment *ps;
+        int is_http = 0;
+
+        if (seg->key_type != KEY_NONE ||
+            check_url(pls->parent, seg->url, &is_http) < 0)
+            break;
+
+        ps = av_mallocz(sizeof(*ps));
+        if (!ps || !(ps->url = av_strdup(seg->url))) {
+            av_freep(&ps);
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        ps->pls        = pls;
+        ps->seq_no     = seq_no;
+        ps->url_offset = seg->url_offset;
+        ps->size       = seg->size;
+        ps->is_http    = is_http;
+        av_dict_copy(&ps->opts, c->avio_opts, 0);
+        if (is_http && c->http_persistent)
+            av_dict_set(&ps->opts, "connection_pool", "1", 0);
+        if (seg->size >= 0) {
+            av_dict_set_int(&ps->opts, "offset", seg->url_offset, 0);
+            av_dict_set_int(&ps->opts, "end_offset", seg->url_offset + seg->size, 0);
+        }
+        if ((ret = av_dynarray_add_nofree(&pls->prefetch, &pls->n_prefetch, ps)) < 0) {
+            prefetch_free(c, &ps);
+            break;
+        }
+        av_log(pls->parent, AV_LOG_VERBOSE,
+               "HLS prefetch for url '%s', offset %"PRId64", playlist %d\n",
+               seg->url, seg->url_offset, pls->index);
+    }
+    pthread_cond_broadcast(&c->prefetch_cond);
+    pthread_mutex_unlock(&c->prefetch_mutex);
+    return ret;
+}
+
+/*
+ * Start reading the current segment from the prefetch cache.
+ * @return 1 if it is read from the cache, 0 if it was not prefetched
+ */
+static int prefetch_open(HLSContext *c, struct playlist *pls)
+{
+    struct prefetch_segment *ps;
+    int ret;
+
+    if ((ret = prefetch_start(c)) < 0 ||
+        (ret = prefetch_update(c, pls)) < 0)
+        return ret;
+    if (!pls->n_prefetch)
+        return 0;
+
+    ps = pls->prefetch[0];
+    pthread_mutex_lock(&c->prefetch_mutex);
+    if (ps->state == PREFETCH_DONE && !ps->error)
+        c->prefetch_hits++;
+    else
+        c->prefetch_misses++;
+    pthread_mutex_unlock(&c->prefetch_mutex);
+
+    pls->prefetch_cur   = ps;
+    pls->cur_seg_offset = 0;
+    return 1;
+}
+
+static int prefetch_read(HLSContext *c, struct playlist *pls,
+                         uint8_t *buf, int buf_size)
+{
+    struct prefetch_segment *ps = pls->prefetch_cur;
+    int64_t stall_start = 0;
+    int ret;
+
+    pthread_mutex_lock(&c->prefetch_mutex);
+    while (pls->cur_seg_offset == ps->data_size && ps->state != PREFETCH_DONE) {
+        if (!stall_start) {
+            stall_start = av_gettime_relative();
+            c->prefetch_stalls++;
+        }
+        pthread_cond_wait(&c->prefetch_cond, &c->prefetch_mutex);
+    }
+    if (stall_start)
+        c->prefetch_stall_time += av_gettime_relative() - stall_start;
+
+    ret = FFMIN(buf_size, ps->data_size - pls->cur_seg_offset);
+    if (ret > 0) {
+        memcpy(buf, ps->data + pls->cur_seg_offset, ret);
+        pls->cur_seg_offset += ret;
+    } else {
+        ret = ps->error < 0 ? ps->error : AVERROR_EOF;
+    }
+    pthread_mutex_unlock(&c->prefetch_mutex);
+    return ret;
+}
+
+/* Drop the prefetched segment that was read. */
+static void prefetch_close(HLSContext *c, struct playlist *pls)
+{
+    pthread_mutex_lock(&c->prefetch_mutex);
+    prefetch_free(c, &pls->prefetch[0]);
+    memmove(pls->prefetch, pls->prefetch + 1,
+            --pls->n_prefetch * sizeof(*pls->prefetch));
+    pls->prefetch_cur = NULL;
+    pthread_cond_broadcast(&c->prefetch_cond);
+    pthread_mutex_unlock(&c->prefetch_mutex);
+}
+#else
+static int prefetch_open(HLSContext *c, struct playlist *pls)
+{
+    return 0;
+}
+
+static int prefetch_read(HLSContext *c, struct playlist *pls,
+                         uint8_t *buf, int buf_size)
+{
+    return AVERROR_BUG;
+}
+
+static void prefetch_close(HLSContext *c, struct playlist *pls)
+{
+}
+
+static void prefetch_cancel(HLSContext *c, struct playlist *pls)
+{
+}
+
+static void prefetch_stop(HLSContext *c)
+{
+}
+#endif
+
 static int read_from_url(struct playlist *pls, struct segment *seg,
                          uint8_t *buf, int buf_size)
 {
@@ -986,6 +1430,9 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
+    if (pls->prefetch_cur)
+        return prefetch_read(pls->parent->priv_data, pls, buf, buf_size);
+
     ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
@@ -1401,7 +1848,8 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !v->prefetch_cur) ||
+        (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1472,7 +1920,11 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (c->prefetch_segments && (ret = prefetch_open(c, v))) {
+            if (ret > 0)
+                ff_format_io_close(v->parent, &v->input);
+            ret = FFMIN(ret, 0);
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1492,7 +1944,7 @@ reload:
         just_opened = 1;
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1502,7 +1954,7 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->http_multiple == 1 && !v->input_next_requested && !v->prefetch_cur &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1535,7 +1987,9 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->prefetch_cur) {
+        prefetch_close(c, v);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -1796,6 +2250,7 @@ static int hls_close(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
 
+    prefetch_stop(c);
     free_playlist_list(c);
     free_variant_list(c);
     free_rendition_list(c);
@@ -2042,6 +2497,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %d\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
+            prefetch_cancel(c, pls);
             ff_format_io_close(pls->parent, &pls->input);
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
@@ -2283,6 +2739,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     for (i = 0; i < c->n_playlists; i++) {
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
+        prefetch_cancel(c, pls);
         ff_format_io_close(pls->parent, &pls->input);
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
@@ -2348,6 +2805,10 @@ static const AVOption hls_options[] = {
         OFFSET(http_multiple), AV_OPT_TYPE_BOOL, {.i64 = -1}, -1, 1, FLAGS},
     {"http_seekable", "Use HTTP partial requests, 0 = disable, 1 = enable, -1 = auto",
         OFFSET(http_seekable), AV_OPT_TYPE_BOOL, { .i64 = -1}, -1, 1, FLAGS},
+    {"prefetch_segments", "Number of segments downloaded in parallel ahead of the one being read",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_max_size", "Amount of prefetched data after which no new segment download is started",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
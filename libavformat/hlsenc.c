@@ -51,6 +51,7 @@
 #include "hlsplaylist.h"
 #include "internal.h"
 #include "os_support.h"
+#include "uploadqueue.h"
 
 typedef enum {
     HLS_START_SEQUENCE_AS_START_NUMBER = 0,
@@ -68,6 +69,11 @@ typedef enum {
 #define HLS_MICROSECOND_UNIT   1000000
 #define POSTFIX_PATTERN "_%d"
 
+typedef struct HLSPart {
+    double duration; /* in seconds */
+    int independent;
+} HLSPart;
+
 typedef struct HLSSegment {
     char filename[MAX_URL_SIZE];
     char sub_filename[MAX_URL_SIZE];
@@ -82,6 +88,9 @@ typedef struct HLSSegment {
     char key_uri[LINE_BUFFER_SIZE + 1];
     char iv_string[KEYSIZE*2 + 1];
 
+    HLSPart *parts;
+    int nb_parts;
+
     struct HLSSegment *next;
 } HLSSegment;
 
@@ -102,6 +111,8 @@ typedef enum HLSFlags {
     HLS_PERIODIC_REKEY = (1 << 12),
     HLS_INDEPENDENT_SEGMENTS = (1 << 13),
     HLS_I_FRAMES_ONLY = (1 << 14),
+    HLS_DELTA_UPDATE = (1 << 15),
+    HLS_BLOCKING_RELOAD = (1 << 16),
 } HLSFlags;
 
 typedef enum {
@@ -146,6 +157,15 @@ typedef struct VariantStream {
     HLSSegment *last_segment;
     HLSSegment *old_segments;
 
+    HLSPart *parts;       // parts of the segment being written
+    int nb_parts;
+    int part_pos;         // start of the part being written in the segment buffer
+    int64_t part_start_pts;
+    int part_independent;
+    AVIOContext *part_out;
+    int part_open;        // part_out opened ahead of time for part_filename
+    char part_filename[MAX_URL_SIZE];
+
     char *basename;
     char *vtt_basename;
     char *vtt_m3u8_name;
@@ -183,6 +203,8 @@ typedef struct HLSContext {
     uint32_t start_sequence_source_type;  // enum StartSequenceSourceType
 
     float time;            // Set by a private option.
+    float part_time;       // Set by a private option.
+    int part_publish_rate; // Set by a private option.
     float init_time;       // Set by a private option.
     int max_nb_segments;   // Set by a private option.
     int hls_delete_threshold; // Set by a private option.
@@ -242,17 +264,36 @@ typedef struct HLSContext {
     int64_t timeout;
     int ignore_io_errors;
     char *headers;
+    AVDictionary *http_opts;
+    int upload_threads;
+    int64_t upload_queue_size;
+    int upload_retries;
+    UploadQueue *upload_queue;
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
 } HLSContext;
 
+/* Local files are renamed as soon as they are closed, only network output
+ * can be written in the background. */
+static int hlsenc_use_upload_queue(HLSContext *hls, const char *filename)
+{
+    if (!hls->upload_queue || !filename)
+        return 0;
+    av_strstart(filename, "crypto:", &filename);
+    return ff_is_http_proto((char *)filename);
+}
+
 static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
                           AVDictionary **options)
 {
     HLSContext *hls = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
-    if (!*pb || !http_base_proto || !hls->http_persistent) {
+    if (hlsenc_use_upload_queue(hls, filename)) {
+        /* playlists must not be published before the segments they list */
+        return ff_upload_queue_open(hls->upload_queue, pb, filename,
+                                    av_match_ext(filename, "m3u8"), options);
+    } else if (!*pb || !http_base_proto || !hls->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -274,7 +315,9 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     int ret = 0;
     if (!*pb)
         return ret;
-    if (!http_base_proto || !hls->http_persistent || hls->key_info_file || hls->encrypt) {
+    if (ff_upload_queue_owns(*pb)) {
+        ret = avio_closep(pb);
+    } else if (!http_base_proto || !hls->http_persistent || hls->key_info_file || hls->encrypt) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -305,6 +348,7 @@ static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSCont
         av_dict_set_int(options, "timeout", c->timeout, 0);
     if (c->headers)
         av_dict_set(options, "headers", c->headers, 0);
+    av_dict_copy(options, c->http_opts, 0);
 }
 
 static void write_codec_attr(AVStream *st, VariantStream *vs)
@@ -480,6 +524,25 @@ static void reflush_dynbuf(VariantStream *vs, int *range_length)
     avio_write(vs->out, vs->temp_buffer, *range_length);
 }
 
+/* Parts are named after their segment: seg3.m4s has the parts seg3.part0.m4s,
+ * seg3.part1.m4s... */
+static void hls_part_filename(HLSContext *hls, char *buf, int size,
+                              const char *segment, int part)
+{
+    const char *base = av_basename(segment);
+    const char *ext;
+    int len = strlen(segment);
+
+    if ((hls->flags & HLS_TEMP_FILE) && av_match_ext(segment, "tmp") && len > 4)
+        len -= 4;
+    for (ext = segment + len - 1; ext > base && *ext != '.'; ext--)
+        ;
+    if (ext <= base || *ext != '.')
+        ext = segment + len;
+    snprintf(buf, size, "%.*s.part%d%.*s", (int)(ext - segment), segment,
+             part, (int)(segment + len - ext), ext);
+}
+
 #if HAVE_DOS_PATHS
 #define SEPARATOR '\\'
 #else
@@ -493,8 +556,12 @@ static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
         AVDictionary *opt = NULL;
         AVIOContext  *out = NULL;
         int ret;
+        set_http_options(avf, &opt, hls);
         av_dict_set(&opt, "method", "DELETE", 0);
-        ret = avf->io_open(avf, &out, path, AVIO_FLAG_WRITE, &opt);
+        if (hlsenc_use_upload_queue(hls, path))
+            ret = ff_upload_queue_open(hls->upload_queue, &out, path, 1, &opt);
+        else
+            ret = avf->io_open(avf, &out, path, AVIO_FLAG_WRITE, &opt);
         av_dict_free(&opt);
         if (ret < 0)
             return hls->ignore_io_errors ? 1 : ret;
@@ -512,8 +579,9 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
 
     HLSSegment *segment, *previous_segment = NULL;
     float playlist_duration = 0.0f;
-    int ret = 0;
+    int ret = 0, i;
     int segment_cnt = 0;
+    char part_filename[MAX_URL_SIZE];
     AVBPrint path;
     char *dirname = NULL;
     char *dirname_r = NULL;
@@ -586,6 +654,12 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         if (ret = hls_delete_file(hls, vs->avf, path.str, proto))
             goto fail;
 
+        for (i = 0; i < segment->nb_parts; i++) {
+            hls_part_filename(hls, part_filename, sizeof(part_filename), path.str, i);
+            if (ret = hls_delete_file(hls, vs->avf, part_filename, proto))
+                goto fail;
+        }
+
         if ((segment->sub_filename[0] != '\0')) {
             vtt_dirname_r = av_strdup(vs->vtt_avf->url);
             vtt_dirname = (char*)av_dirname(vtt_dirname_r);
@@ -606,6 +680,7 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         av_bprint_clear(&path);
         previous_segment = segment;
         segment = previous_segment->next;
+        av_freep(&previous_segment->parts);
         av_freep(&previous_segment);
     }
 
@@ -1074,6 +1149,11 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
     en->keyframe_size     = vs->video_keyframe_size;
     en->next     = NULL;
     en->discont  = 0;
+    en->parts    = vs->parts;
+    en->nb_parts = vs->nb_parts;
+    vs->parts    = NULL;
+    vs->nb_parts = 0;
+    vs->part_pos = 0;
 
     if (vs->discontinuity) {
         en->discont = 1;
@@ -1110,8 +1190,10 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
             vs->old_segments = en;
             if ((ret = hls_delete_old_segments(s, hls, vs)) < 0)
                 return ret;
-        } else
+        } else {
+            av_freep(&en->parts);
             av_freep(&en);
+        }
     } else
         vs->nb_entries++;
 
@@ -1221,6 +1303,7 @@ static void hls_free_segments(HLSSegment *p)
     while (p) {
         en = p;
         p = p->next;
+        av_freep(&en->parts);
         av_freep(&en);
     }
 }
@@ -1442,6 +1525,166 @@ fail:
     return ret;
 }
 
+static void hls_write_media_playlist(AVFormatContext *s, VariantStream *vs,
+                                     AVIOContext *out, int target_duration,
+                                     int64_t sequence, int last, int delta)
+{
+    HLSContext *hls = s->priv_data;
+    HLSSegment *en;
+    char *key_uri = NULL;
+    char *iv_string = NULL;
+    double prog_date_time = vs->initial_prog_date_time;
+    double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int low_latency = hls->part_time > 0 && !last;
+    double skip_until = 6.0 * target_duration;
+    double total_duration = 0, end = 0;
+    char part_filename[MAX_URL_SIZE];
+    int skipped = 0, i, ret;
+
+    if (low_latency) {
+        for (en = vs->segments; en; en = en->next)
+            total_duration += en->duration;
+        for (i = 0; i < vs->nb_parts; i++)
+            total_duration += vs->parts[i].duration;
+    }
+    /* a delta update leaves out the segments which ended before the skip boundary */
+    if (delta) {
+        for (en = vs->segments; en; en = en->next) {
+            end += en->duration;
+            if (total_duration - end < skip_until)
+                break;
+            skipped++;
+        }
+    }
+
+    ff_hls_write_playlist_header(out, hls->version, hls->allowcache,
+                                 target_duration, sequence, hls->pl_type, hls->flags & HLS_I_FRAMES_ONLY);
+    if (low_latency)
+        ff_hls_write_server_control(out, hls->flags & HLS_BLOCKING_RELOAD,
+                                    (hls->flags & HLS_DELTA_UPDATE) ? skip_until : 0,
+                                    hls->part_time);
+
+    if ((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && vs->discontinuity_set==0 && !skipped) {
+        avio_printf(out, "#EXT-X-DISCONTINUITY\n");
+        vs->discontinuity_set = 1;
+    }
+    if (vs->has_video && (hls->flags & HLS_INDEPENDENT_SEGMENTS)) {
+        avio_printf(out, "#EXT-X-INDEPENDENT-SEGMENTS\n");
+    }
+    if (skipped)
+        ff_hls_write_skip(out, skipped);
+
+    end = 0;
+    for (en = vs->segments, i = 0; en; en = en->next, i++) {
+        end += en->duration;
+        if (i < skipped) {
+            if (prog_date_time_p)
+                prog_date_time += en->duration;
+            continue;
+        }
+        if ((hls->encrypt || hls->key_info_file) && (!key_uri || strcmp(en->key_uri, key_uri) ||
+                                    av_strcasecmp(en->iv_string, iv_string))) {
+            avio_printf(out, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
+            if (*en->iv_string)
+                avio_printf(out, ",IV=0x%s", en->iv_string);
+            avio_printf(out, "\n");
+            key_uri = en->key_uri;
+            iv_string = en->iv_string;
+        }
+
+        if ((hls->segment_type == SEGMENT_TYPE_FMP4) && i == skipped) {
+            ff_hls_write_init_file(out, (hls->flags & HLS_SINGLE_FILE) ? en->filename : vs->fmp4_init_filename,
+                                   hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
+        }
+
+        /* the parts are only listed near the live edge */
+        if (low_latency && total_duration - end < 3 * target_duration) {
+            int j;
+            for (j = 0; j < en->nb_parts; j++) {
+                hls_part_filename(hls, part_filename, sizeof(part_filename), en->filename, j);
+                ff_hls_write_part(out, en->parts[j].duration, vs->baseurl,
+                                  part_filename, en->parts[j].independent);
+            }
+        }
+
+        ret = ff_hls_write_file_entry(out, en->discont, byterange_mode,
+                                      en->duration, hls->flags & HLS_ROUND_DURATIONS,
+                                      en->size, en->pos, vs->baseurl,
+                                      en->filename, prog_date_time_p, en->keyframe_size, en->keyframe_pos, hls->flags & HLS_I_FRAMES_ONLY);
+        if (ret < 0) {
+            av_log(s, AV_LOG_WARNING, "ff_hls_write_file_entry get error\n");
+        }
+    }
+
+    if (low_latency) {
+        const char *segment = hls->use_localtime_mkdir ? vs->avf->url : av_basename(vs->avf->url);
+
+        if (!vs->segments && hls->segment_type == SEGMENT_TYPE_FMP4)
+            ff_hls_write_init_file(out, vs->fmp4_init_filename, 0, 0, 0);
+        for (i = 0; i < vs->nb_parts; i++) {
+            hls_part_filename(hls, part_filename, sizeof(part_filename), segment, i);
+            ff_hls_write_part(out, vs->parts[i].duration, vs->baseurl,
+                              part_filename, vs->parts[i].independent);
+        }
+        hls_part_filename(hls, part_filename, sizeof(part_filename), segment, vs->nb_parts);
+        ff_hls_write_preload_hint(out, vs->baseurl, part_filename);
+    }
+
+    if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
+        ff_hls_write_end_list(out);
+}
+
+/* Clients ask for the delta update with the _HLS_skip query parameter, the
+ * server answers it with the <playlist>_delta.m3u8 file written here. */
+static int hls_write_delta_playlist(AVFormatContext *s, VariantStream *vs,
+                                    int target_duration, int64_t sequence)
+{
+    HLSContext *hls = s->priv_data;
+    const char *proto = avio_find_protocol_name(vs->m3u8_name);
+    int use_temp_file = proto && !strcmp(proto, "file");
+    char filename[MAX_URL_SIZE];
+    char temp_filename[MAX_URL_SIZE];
+    AVDictionary *options = NULL;
+    int len = strlen(vs->m3u8_name);
+    int ret;
+
+    if (av_match_ext(vs->m3u8_name, "m3u8") && len > 5)
+        len -= 5;
+    if (snprintf(filename, sizeof(filename), "%.*s_delta.m3u8", len, vs->m3u8_name) >= sizeof(filename) ||
+        snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", filename) >= sizeof(temp_filename)) {
+        av_log(s, AV_LOG_ERROR, "Delta update name of '%s' too long\n", vs->m3u8_name);
+        return AVERROR(EINVAL);
+    }
+
+    set_http_options(s, &options, hls);
+    ret = hlsenc_io_open(s, &vs->out, temp_filename, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+        return hls->ignore_io_errors ? 0 : ret;
+    vs->discontinuity_set = 0;
+    hls_write_media_playlist(s, vs, vs->out, target_duration, sequence, 0, 1);
+    ret = hlsenc_io_close(s, &vs->out, temp_filename);
+    if (use_temp_file)
+        ff_rename(temp_filename, filename, s);
+    return ret;
+}
+
+static int hls_target_duration(HLSContext *hls, VariantStream *vs)
+{
+    HLSSegment *en;
+    int target_duration = 0;
+
+    for (en = vs->segments; en; en = en->next) {
+        if (target_duration <= en->duration)
+            target_duration = lrint(en->duration);
+    }
+    /* the segment being written already has parts in the playlist */
+    if (hls->part_time > 0)
+        target_duration = FFMAX(target_duration, lrint(hls->time));
+    return target_duration;
+}
+
 static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 {
     HLSContext *hls = s->priv_data;
@@ -1455,11 +1698,7 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     int is_file_proto = proto && !strcmp(proto, "file");
     int use_temp_file = is_file_proto && ((hls->flags & HLS_TEMP_FILE) || !(hls->pl_type == PLAYLIST_TYPE_VOD));
     static unsigned warned_non_file;
-    char *key_uri = NULL;
-    char *iv_string = NULL;
     AVDictionary *options = NULL;
-    double prog_date_time = vs->initial_prog_date_time;
-    double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
 
     hls->version = 3;
@@ -1476,6 +1715,10 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         hls->version = 7;
     }
 
+    if (hls->flags & HLS_DELTA_UPDATE) {
+        hls->version = 9;
+    }
+
     if (!is_file_proto && (hls->flags & HLS_TEMP_FILE) && !warned_non_file++)
         av_log(s, AV_LOG_ERROR, "Cannot use rename on non file protocol, this may lead to races and temporary partial files\n");
 
@@ -1487,49 +1730,11 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         goto fail;
     }
 
-    for (en = vs->segments; en; en = en->next) {
-        if (target_duration <= en->duration)
-            target_duration = lrint(en->duration);
-    }
+    target_duration = hls_target_duration(hls, vs);
 
     vs->discontinuity_set = 0;
-    ff_hls_write_playlist_header(byterange_mode ? hls->m3u8_out : vs->out, hls->version, hls->allowcache,
-                                 target_duration, sequence, hls->pl_type, hls->flags & HLS_I_FRAMES_ONLY);
-
-    if ((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && vs->discontinuity_set==0 ) {
-        avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-DISCONTINUITY\n");
-        vs->discontinuity_set = 1;
-    }
-    if (vs->has_video && (hls->flags & HLS_INDEPENDENT_SEGMENTS)) {
-        avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-INDEPENDENT-SEGMENTS\n");
-    }
-    for (en = vs->segments; en; en = en->next) {
-        if ((hls->encrypt || hls->key_info_file) && (!key_uri || strcmp(en->key_uri, key_uri) ||
-                                    av_strcasecmp(en->iv_string, iv_string))) {
-            avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
-            if (*en->iv_string)
-                avio_printf(byterange_mode ? hls->m3u8_out : vs->out, ",IV=0x%s", en->iv_string);
-            avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "\n");
-            key_uri = en->key_uri;
-            iv_string = en->iv_string;
-        }
-
-        if ((hls->segment_type == SEGMENT_TYPE_FMP4) && (en == vs->segments)) {
-            ff_hls_write_init_file(byterange_mode ? hls->m3u8_out : vs->out, (hls->flags & HLS_SINGLE_FILE) ? en->filename : vs->fmp4_init_filename,
-                                   hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
-        }
-
-        ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
-                                      en->duration, hls->flags & HLS_ROUND_DURATIONS,
-                                      en->size, en->pos, vs->baseurl,
-                                      en->filename, prog_date_time_p, en->keyframe_size, en->keyframe_pos, hls->flags & HLS_I_FRAMES_ONLY);
-        if (ret < 0) {
-            av_log(s, AV_LOG_WARNING, "ff_hls_write_file_entry get error\n");
-        }
-    }
-
-    if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
-        ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
+    hls_write_media_playlist(s, vs, byterange_mode ? hls->m3u8_out : vs->out,
+                             target_duration, sequence, last, 0);
 
     if (vs->vtt_m3u8_name) {
         snprintf(temp_vtt_filename, sizeof(temp_vtt_filename), use_temp_file ? "%s.tmp" : "%s", vs->vtt_m3u8_name);
@@ -1566,6 +1771,8 @@ fail:
         if (vs->vtt_m3u8_name)
             ff_rename(temp_vtt_filename, vs->vtt_m3u8_name, s);
     }
+    if (!last && (hls->flags & HLS_DELTA_UPDATE))
+        ret = hls_write_delta_playlist(s, vs, target_duration, sequence);
     if (ret >= 0 && hls->master_pl_name)
         if (create_master_playlist(s, vs) < 0)
             av_log(s, AV_LOG_WARNING, "Master playlist creation failed\n");
@@ -2268,6 +2475,118 @@ static int hls_init_file_resend(AVFormatContext *s, VariantStream *vs)
     return ret;
 }
 
+/* Move the ftyp and moov boxes written by the first flush of the mp4 muxer
+ * to the init file. */
+static int hls_write_init_buffer(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int range_length;
+
+    range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
+    if (range_length <= 0)
+        return AVERROR(EINVAL);
+    avio_write(vs->out, vs->init_buffer, range_length);
+    if (!hls->resend_init_file)
+        av_freep(&vs->init_buffer);
+    vs->init_range_length = range_length;
+    avio_open_dyn_buf(&oc->pb);
+    vs->packets_written = 0;
+    vs->start_pos = range_length;
+    if (!byterange_mode) {
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+    }
+    return 0;
+}
+
+static int hls_open_part(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVDictionary *options = NULL;
+    int ret;
+
+    hls_part_filename(hls, vs->part_filename, sizeof(vs->part_filename),
+                      vs->avf->url, vs->nb_parts);
+    set_http_options(s, &options, hls);
+    ret = hlsenc_io_open(s, &vs->part_out, vs->part_filename, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+               "Failed to open file '%s'\n", vs->part_filename);
+        return ret;
+    }
+    vs->part_open = 1;
+    return 0;
+}
+
+/* On network output, the part announced by the preload hint is opened before
+ * the playlist is written, so that the requests for it wait for its data
+ * instead of failing. A persistent connection can only carry one request at
+ * a time though. */
+static int hls_open_next_part(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    const char *proto = avio_find_protocol_name(vs->avf->url);
+
+    if (hls->part_time <= 0 || vs->part_open || hls->http_persistent ||
+        !proto || !strcmp(proto, "file"))
+        return 0;
+    return hls_open_part(s, vs);
+}
+
+/* Write what the segment being written got since the previous part as a new
+ * part, the whole segment is still written out when it ends. */
+static int hls_write_part(AVFormatContext *s, VariantStream *vs, double duration)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    HLSPart *parts;
+    uint8_t *buf;
+    int size, ret;
+
+    if (!vs->init_range_length) {
+        av_write_frame(oc, NULL);
+        if ((ret = hls_write_init_buffer(s, vs)) < 0)
+            return ret;
+    }
+    av_write_frame(oc, NULL);
+    size = avio_get_dyn_buf(oc->pb, &buf);
+    if (size <= vs->part_pos)
+        return 0;
+
+    if (vs->part_open || (ret = hls_open_part(s, vs)) >= 0) {
+        avio_write(vs->part_out, buf + vs->part_pos, size - vs->part_pos);
+        ret = hlsenc_io_close(s, &vs->part_out, vs->part_filename);
+        vs->part_open = 0;
+        if (ret < 0)
+            av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+                   "Failed to upload part '%s'\n", vs->part_filename);
+    }
+    if (ret < 0 && !hls->ignore_io_errors)
+        return ret;
+
+    parts = av_realloc_array(vs->parts, vs->nb_parts + 1, sizeof(*vs->parts));
+    if (!parts)
+        return AVERROR(ENOMEM);
+    vs->parts = parts;
+    parts[vs->nb_parts].duration    = duration;
+    parts[vs->nb_parts].independent = vs->part_independent;
+    vs->nb_parts++;
+    vs->part_pos = size;
+    return 0;
+}
+
+static double hls_parts_duration(VariantStream *vs)
+{
+    double duration = 0;
+    int i;
+
+    for (i = 0; i < vs->nb_parts; i++)
+        duration += vs->parts[i].duration;
+    return duration;
+}
+
 static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     HLSContext *hls = s->priv_data;
@@ -2365,19 +2684,9 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         avio_flush(oc->pb);
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             if (!vs->init_range_length) {
-                range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
-                if (range_length <= 0)
-                    return AVERROR(EINVAL);
-                avio_write(vs->out, vs->init_buffer, range_length);
-                if (!hls->resend_init_file)
-                    av_freep(&vs->init_buffer);
-                vs->init_range_length = range_length;
-                avio_open_dyn_buf(&oc->pb);
-                vs->packets_written = 0;
-                vs->start_pos = range_length;
-                if (!byterange_mode) {
-                    hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
-                }
+                ret = hls_write_init_buffer(s, vs);
+                if (ret < 0)
+                    return ret;
             }
         }
         if (!byterange_mode) {
@@ -2391,6 +2700,12 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             use_temp_file = proto && !strcmp(proto, "file") && (hls->flags & HLS_TEMP_FILE);
         }
 
+        if (hls->part_time > 0) {
+            ret = hls_write_part(s, vs, FFMAX(vs->duration - hls_parts_duration(vs), 0));
+            if (ret < 0)
+                return ret;
+        }
+
         if (hls->flags & HLS_SINGLE_FILE) {
             ret = flush_dynbuf(vs, &range_length);
             av_freep(&vs->temp_buffer);
@@ -2470,7 +2785,8 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
 
         // if we're building a VOD playlist, skip writing the manifest multiple times, and just wait until the end
-        if (hls->pl_type != PLAYLIST_TYPE_VOD) {
+        // the low-latency playlist is written once the next segment is started
+        if (hls->pl_type != PLAYLIST_TYPE_VOD && !(hls->part_time > 0)) {
             if ((ret = hls_window(s, 0, vs)) < 0) {
                 av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
                 ff_format_io_close(s, &vs->out);
@@ -2516,6 +2832,39 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             return ret;
         }
 
+        if (hls->part_time > 0) {
+            vs->part_start_pts = AV_NOPTS_VALUE;
+            if ((ret = hls_open_next_part(s, vs)) < 0 && !hls->ignore_io_errors)
+                return ret;
+            if ((ret = hls_window(s, 0, vs)) < 0)
+                return ret;
+        }
+    } else if (hls->part_time > 0 && is_ref_pkt && vs->part_start_pts != AV_NOPTS_VALUE &&
+               pkt->pts > vs->part_start_pts &&
+               av_compare_ts(pkt->pts + pkt->duration - vs->part_start_pts, st->time_base,
+                             hls->part_time * AV_TIME_BASE, AV_TIME_BASE_Q) > 0) {
+        /* cut a part before it gets longer than the part target duration */
+        double duration = (double)(pkt->pts - vs->part_start_pts) * st->time_base.num / st->time_base.den;
+
+        if ((ret = hls_write_part(s, vs, duration)) < 0)
+            return ret;
+        vs->part_start_pts = AV_NOPTS_VALUE;
+        if ((ret = hls_open_next_part(s, vs)) < 0 && !hls->ignore_io_errors)
+            return ret;
+        if (!(vs->nb_parts % hls->part_publish_rate))
+            ret = hls_window(s, 0, vs);
+        else if (hls->flags & HLS_DELTA_UPDATE)
+            ret = hls_write_delta_playlist(s, vs, hls_target_duration(hls, vs),
+                                           FFMAX(hls->start_sequence, vs->sequence - vs->nb_entries));
+        else
+            ret = 0;
+        if (ret < 0)
+            return ret;
+    }
+
+    if (hls->part_time > 0 && is_ref_pkt && vs->part_start_pts == AV_NOPTS_VALUE) {
+        vs->part_start_pts   = pkt->pts;
+        vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
     }
 
     vs->packets_written++;
@@ -2558,6 +2907,7 @@ static void hls_free_variant_streams(struct HLSContext *hls)
             av_freep(&vs->init_buffer);
         hls_free_segments(vs->segments);
         hls_free_segments(vs->old_segments);
+        av_freep(&vs->parts);
         av_freep(&vs->m3u8_name);
         av_freep(&vs->streams);
         av_freep(&vs->agroup);
@@ -2626,6 +2976,13 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 }
             }
         }
+        if (hls->part_time > 0) {
+            ret = hls_write_part(s, vs, FFMAX(vs->duration + vs->dpp - hls_parts_duration(vs), 0));
+            ff_format_io_close(s, &vs->part_out);
+            vs->part_open = 0;
+            if (ret < 0)
+                goto failed;
+        }
         if (!(hls->flags & HLS_SINGLE_FILE)) {
             set_http_options(s, &options, hls);
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
@@ -2714,9 +3071,22 @@ failed:
     av_freep(&hls->var_streams);
     av_freep(&hls->cc_streams);
     av_freep(&hls->master_m3u8_url);
+
+    if (hls->upload_queue) {
+        ret = ff_upload_queue_flush(hls->upload_queue);
+        if (ret < 0 && !hls->ignore_io_errors)
+            return ret;
+    }
     return 0;
 }
 
+static void hls_deinit(AVFormatContext *s)
+{
+    HLSContext *hls = s->priv_data;
+
+    ff_upload_queue_free(&hls->upload_queue);
+}
+
 
 static int hls_init(AVFormatContext *s)
 {
@@ -2753,6 +3123,36 @@ static int hls_init(AVFormatContext *s)
         av_log(hls, AV_LOG_WARNING, "No HTTP method set, hls muxer defaulting to method PUT.\n");
     }
 
+    if (hls->upload_threads > 0 && http_base_proto) {
+        ret = ff_upload_queue_alloc(&hls->upload_queue, s, hls->upload_threads,
+                                    hls->upload_queue_size, hls->upload_retries);
+        if (ret < 0) {
+            av_log(s, AV_LOG_ERROR, "Failed to start the upload threads\n");
+            goto fail;
+        }
+    }
+
+    if (hls->part_time > 0) {
+        if (hls->segment_type != SEGMENT_TYPE_FMP4 || hls->flags & HLS_SINGLE_FILE ||
+            hls->max_seg_size > 0 || hls->encrypt || hls->key_info_file ||
+            hls->pl_type == PLAYLIST_TYPE_VOD ||
+            hls->flags & (HLS_SECOND_LEVEL_SEGMENT_DURATION | HLS_SECOND_LEVEL_SEGMENT_SIZE)) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time requires unencrypted fmp4 segments, "
+                   "one file per segment and a live or event playlist\n");
+            ret = AVERROR(EINVAL);
+            goto fail;
+        }
+        if (hls->part_time > hls->time || (hls->init_time > 0 && hls->part_time > hls->init_time)) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time must not be larger than the segment length\n");
+            ret = AVERROR(EINVAL);
+            goto fail;
+        }
+    } else if (hls->flags & (HLS_DELTA_UPDATE | HLS_BLOCKING_RELOAD)) {
+        av_log(s, AV_LOG_ERROR, "delta_update and blocking_reload require hls_part_time\n");
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+
     ret = validate_name(hls->nb_varstreams, s->url);
     if (ret < 0)
         goto fail;
@@ -2815,6 +3215,7 @@ static int hls_init(AVFormatContext *s)
         vs->sequence       = hls->start_sequence;
         vs->start_pts      = AV_NOPTS_VALUE;
         vs->end_pts      = AV_NOPTS_VALUE;
+        vs->part_start_pts = AV_NOPTS_VALUE;
         vs->current_segment_final_filename_fmt[0] = '\0';
 
         if (hls->flags & HLS_SPLIT_BY_TIME && hls->flags & HLS_INDEPENDENT_SEGMENTS) {
@@ -3033,6 +3434,8 @@ static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length in seconds",           OFFSET(time),    AV_OPT_TYPE_FLOAT,  {.dbl = 2},     0, FLT_MAX, E},
     {"hls_init_time", "set segment length in seconds at init list",           OFFSET(init_time),    AV_OPT_TYPE_FLOAT,  {.dbl = 0},     0, FLT_MAX, E},
+    {"hls_part_time", "set partial segment length in seconds for low-latency HLS", OFFSET(part_time), AV_OPT_TYPE_FLOAT, {.dbl = 0},     0, FLT_MAX, E},
+    {"hls_part_publish_rate", "rewrite the playlist once every this many parts", OFFSET(part_publish_rate), AV_OPT_TYPE_INT, {.i64 = 1}, 1, INT_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_delete_threshold", "set number of unreferenced segments to keep before deleting",  OFFSET(hls_delete_threshold),    AV_OPT_TYPE_INT,    {.i64 = 1},     1, INT_MAX, E},
     {"hls_ts_options","set hls mpegts list of options for the container format used for hls", OFFSET(format_options), AV_OPT_TYPE_DICT, {.str = NULL},  0, 0,    E},
@@ -3071,6 +3474,8 @@ static const AVOption options[] = {
     {"periodic_rekey", "reload keyinfo file periodically for re-keying", 0, AV_OPT_TYPE_CONST, {.i64 = HLS_PERIODIC_REKEY }, 0, UINT_MAX,   E, "flags"},
     {"independent_segments", "add EXT-X-INDEPENDENT-SEGMENTS, whenever applicable", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_INDEPENDENT_SEGMENTS }, 0, UINT_MAX, E, "flags"},
     {"iframes_only", "add EXT-X-I-FRAMES-ONLY, whenever applicable", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_I_FRAMES_ONLY }, 0, UINT_MAX, E, "flags"},
+    {"delta_update", "write a playlist delta update next to the low-latency playlist", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_DELTA_UPDATE }, 0, UINT_MAX, E, "flags"},
+    {"blocking_reload", "advertise blocking playlist reload in the low-latency playlist", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_BLOCKING_RELOAD }, 0, UINT_MAX, E, "flags"},
 #if FF_API_HLS_USE_LOCALTIME
     {"use_localtime", "set filename expansion with strftime at segment creation(will be deprecated )", OFFSET(use_localtime), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
 #endif
@@ -3096,6 +3501,10 @@ static const AVOption options[] = {
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
+    {"http_opts", "HTTP protocol options", OFFSET(http_opts), AV_OPT_TYPE_DICT, { .str = NULL }, 0, 0, E },
+    {"upload_threads", "number of files written at once in the background to HTTP output, 0 to write them synchronously", OFFSET(upload_threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, E },
+    {"upload_queue_size", "maximum size of the files waiting to be written in the background", OFFSET(upload_queue_size), AV_OPT_TYPE_INT64, { .i64 = 64 << 20 }, 0, INT64_MAX, E },
+    {"upload_retries", "number of times a failed background write is retried", OFFSET(upload_retries), AV_OPT_TYPE_INT, { .i64 = 2 }, 0, INT_MAX, E },
     { NULL },
 };
 
@@ -3120,5 +3529,6 @@ AVOutputFormat ff_hls_muxer = {
     .write_header   = hls_write_header,
     .write_packet   = hls_write_packet,
     .write_trailer  = hls_write_trailer,
+    .deinit         = hls_deinit,
     .priv_class     = &hls_class,
 };
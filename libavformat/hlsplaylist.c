@@ -176,6 +176,41 @@ int ff_hls_write_file_entry(AVIOContext *out, int insert_discont,
     return 0;
 }
 
+void ff_hls_write_server_control(AVIOContext *out, int can_block_reload,
+                                 double can_skip_until, double part_target) {
+    if (!out)
+        return;
+    avio_printf(out, "#EXT-X-SERVER-CONTROL:");
+    if (can_block_reload)
+        avio_printf(out, "CAN-BLOCK-RELOAD=YES,");
+    if (can_skip_until > 0)
+        avio_printf(out, "CAN-SKIP-UNTIL=%.3f,", can_skip_until);
+    avio_printf(out, "PART-HOLD-BACK=%.3f\n", 3 * part_target);
+    avio_printf(out, "#EXT-X-PART-INF:PART-TARGET=%.3f\n", part_target);
+}
+
+void ff_hls_write_skip(AVIOContext *out, int skipped_segments) {
+    if (!out)
+        return;
+    avio_printf(out, "#EXT-X-SKIP:SKIPPED-SEGMENTS=%d\n", skipped_segments);
+}
+
+void ff_hls_write_part(AVIOContext *out, double duration, char *baseurl,
+                       const char *filename, int independent) {
+    if (!out)
+        return;
+    avio_printf(out, "#EXT-X-PART:DURATION=%.5f,URI=\"%s%s\"%s\n", duration,
+                baseurl ? baseurl : "", filename, independent ? ",INDEPENDENT=YES" : "");
+}
+
+void ff_hls_write_preload_hint(AVIOContext *out, char *baseurl,
+                               const char *filename) {
+    if (!out)
+        return;
+    avio_printf(out, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s%s\"\n",
+                baseurl ? baseurl : "", filename);
+}
+
 void ff_hls_write_end_list (AVIOContext *out) {
     if (!out)
         return;
@@ -56,6 +56,13 @@ int ff_hls_write_file_entry(AVIOContext *out, int insert_discont,
                              char *baseurl, //Ignored if NULL
                              char *filename, double *prog_date_time,
                              int64_t video_keyframe_size, int64_t video_keyframe_pos, int iframe_mode);
+void ff_hls_write_server_control(AVIOContext *out, int can_block_reload,
+                                 double can_skip_until, double part_target);
+void ff_hls_write_skip(AVIOContext *out, int skipped_segments);
+void ff_hls_write_part(AVIOContext *out, double duration, char *baseurl,
+                       const char *filename, int independent);
+void ff_hls_write_preload_hint(AVIOContext *out, char *baseurl,
+                               const char *filename);
 void ff_hls_write_end_list (AVIOContext *out);
 
 #endif /* AVFORMAT_HLSPLAYLIST_H_ */
@@ -29,11 +29,13 @@
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
 
 #include "avformat.h"
 #include "http.h"
+#include "httpserver.h"
 #include "httpauth.h"
 #include "internal.h"
 #include "network.h"
@@ -48,8 +50,11 @@
  * path names). */
 #define BUFFER_SIZE   MAX_URL_SIZE
 #define MAX_REDIRECTS 8
+/* idle connections kept by the connection pool in the whole process */
+#define POOL_MAX_IDLE 64
 #define HTTP_SINGLE   1
 #define HTTP_MUTLI    2
+#define HTTP_SERVE    3
 #define MAX_EXPIRY    19
 #define WHITESPACES " \n\t\r"
 typedef enum {
@@ -59,6 +64,16 @@ typedef enum {
     FINISH
 }HandshakeState;
 
+/* A connection that can be handed over to another HTTPContext once idle */
+typedef struct HTTPConnection {
+    URLContext *hd;
+    /* interrupt callback of the HTTPContext using the connection */
+    AVIOInterruptCB interrupt_callback;
+    char *key;
+    int64_t expiry;
+    struct HTTPConnection *next;
+} HTTPConnection;
+
 typedef struct HTTPContext {
     const AVClass *class;
     URLContext *hd;
@@ -127,6 +142,14 @@ typedef struct HTTPContext {
     int is_multi_client;
     HandshakeState handshake_step;
     int is_connected_server;
+    HTTPServer *server;
+    HTTPServerResource *server_res;
+    int64_t serve_max_size;
+    int64_t serve_max_age;
+    int connection_pool;
+    int pool_max_idle;
+    int pool_idle_timeout;
+    HTTPConnection *conn;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -166,9 +189,14 @@ static const AVOption options[] = {
     { "reconnect_at_eof", "auto reconnect at EOF", OFFSET(reconnect_at_eof), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
     { "reconnect_streamed", "auto reconnect streamed / non seekable streams", OFFSET(reconnect_streamed), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
     { "reconnect_delay_max", "max reconnect delay in seconds after which to give up", OFFSET(reconnect_delay_max), AV_OPT_TYPE_INT, { .i64 = 120 }, 0, UINT_MAX/1000/1000, D },
-    { "listen", "listen on HTTP", OFFSET(listen), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 2, D | E },
+    { "listen", "listen on HTTP", OFFSET(listen), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 3, D | E },
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
+    { "serve_max_size", "maximum size of the complete resources served with listen=3", OFFSET(serve_max_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, E },
+    { "serve_max_age", "time the complete resources are served for with listen=3", OFFSET(serve_max_age), AV_OPT_TYPE_DURATION, { .i64 = 0 }, 0, INT64_MAX, E },
+    { "connection_pool", "reuse idle connections of a process-wide pool", OFFSET(connection_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "pool_max_idle", "maximum number of idle pooled connections per host", OFFSET(pool_max_idle), AV_OPT_TYPE_INT, { .i64 = 4 }, 0, POOL_MAX_IDLE, D },
+    { "pool_idle_timeout", "time in seconds after which idle pooled connections are closed", OFFSET(pool_idle_timeout), AV_OPT_TYPE_INT, { .i64 = 30 }, 0, INT_MAX / 1000000, D },
     { NULL }
 };
 
@@ -177,6 +205,7 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
                         const char *proxyauth, int *new_location);
 static int http_read_header(URLContext *h, int *new_location);
 static int http_shutdown(URLContext *h, int flags);
+static int http_serve_request(URLContext *h, const char *uri);
 
 void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
 {
@@ -188,6 +217,205 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
+static AVMutex pool_mutex = AV_MUTEX_INITIALIZER;
+static HTTPConnection *pool;
+
+static int pool_interrupt_cb(void *opaque)
+{
+    HTTPConnection *conn = opaque;
+    return ff_check_interrupt(&conn->interrupt_callback);
+}
+
+static void pool_free_connection(HTTPConnection **pconn)
+{
+    HTTPConnection *conn = *pconn;
+
+    if (!conn)
+        return;
+    ffurl_closep(&conn->hd);
+    av_freep(&conn->key);
+    av_freep(pconn);
+}
+
+/* A connection is stale if the peer closed it or sent unexpected data. */
+static int pool_connection_alive(HTTPConnection *conn)
+{
+    struct pollfd p = { .events = POLLIN };
+
+    p.fd = ffurl_get_file_handle(conn->hd);
+    return p.fd >= 0 && !poll(&p, 1, 0);
+}
+
+/**
+ * Take an idle connection to key out of the pool, closing the expired ones.
+ */
+static HTTPConnection *pool_get(const char *key)
+{
+    HTTPConnection **link, *conn = NULL, *expired = NULL;
+    int64_t now = av_gettime_relative();
+
+    ff_mutex_lock(&pool_mutex);
+    for (link = &pool; *link;) {
+        HTTPConnection *cur = *link;
+        if (cur->expiry <= now || (!conn && !strcmp(cur->key, key) &&
+                                   !pool_connection_alive(cur))) {
+            *link     = cur->next;
+            cur->next = expired;
+            expired   = cur;
+        } else if (!conn && !strcmp(cur->key, key)) {
+            *link     = cur->next;
+            cur->next = NULL;
+            conn      = cur;
+        } else {
+            link = &cur->next;
+        }
+    }
+    ff_mutex_unlock(&pool_mutex);
+
+    while (expired) {
+        HTTPConnection *next = expired->next;
+        pool_free_connection(&expired);
+        expired = next;
+    }
+    return conn;
+}
+
+/**
+ * Give an idle connection to the pool. The oldest idle connection to the
+ * same host is closed if there are already max_idle of them.
+ */
+static void pool_put(HTTPConnection *conn, int max_idle, int idle_timeout)
+{
+    HTTPConnection **link, **oldest = NULL, *evicted = NULL;
+    int nb_same = 0, nb_all = 0;
+
+    if (max_idle <= 0) {
+        pool_free_connection(&conn);
+        return;
+    }
+    memset(&conn->interrupt_callback, 0, sizeof(conn->interrupt_callback));
+    conn->expiry = av_gettime_relative() + idle_timeout * 1000000LL;
+
+    ff_mutex_lock(&pool_mutex);
+    /* the pool is ordered from the most to the least recently used */
+    for (link = &pool; *link; link = &(*link)->next) {
+        if (!strcmp((*link)->key, conn->key) && ++nb_same >= max_idle)
+            oldest = link;
+        nb_all++;
+    }
+    if (!oldest && nb_all >= POOL_MAX_IDLE)
+        for (oldest = &pool; (*oldest)->next; oldest = &(*oldest)->next);
+    if (oldest) {
+        evicted = *oldest;
+        *oldest = evicted->next;
+    }
+    conn->next = pool;
+    pool       = conn;
+    ff_mutex_unlock(&pool_mutex);
+
+    pool_free_connection(&evicted);
+}
+
+/**
+ * Return 1 if the request can be sent again without side effects
+ * (RFC 7231 section 4.2.2), e.g. after a pooled connection failed.
+ */
+static int http_is_idempotent(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    static const char *const idempotent[] = {
+        "GET", "HEAD", "OPTIONS", "TRACE", "PUT", "DELETE",
+    };
+    const char *method = s->method ? s->method :
+                         s->post_data || h->flags & AVIO_FLAG_WRITE ? "POST" : "GET";
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(idempotent); i++)
+        if (!av_strcasecmp(method, idempotent[i]))
+            return 1;
+    return 0;
+}
+
+/**
+ * Open the lower protocol connection, reusing an idle connection of the
+ * pool if possible.
+ */
+static int http_open_pooled(URLContext *h, const char *lower_url,
+                            AVDictionary **options, int *reused)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPConnection *conn;
+    AVIOInterruptCB int_cb;
+    char *opts = NULL, *key;
+    int ret;
+
+    /* connections are only shared between identical lower protocol options */
+    if ((ret = av_dict_get_string(*options, &opts, '=', ',')) < 0)
+        return ret;
+    key = av_asprintf("%s?%s", lower_url, opts);
+    av_free(opts);
+    if (!key)
+        return AVERROR(ENOMEM);
+
+    *reused = 0;
+    conn = pool_get(key);
+    if (conn) {
+        av_log(h, AV_LOG_DEBUG, "Reusing pooled connection to %s\n", lower_url);
+        av_free(key);
+        *reused = 1;
+    } else {
+        conn = av_mallocz(sizeof(*conn));
+        if (!conn) {
+            av_free(key);
+            return AVERROR(ENOMEM);
+        }
+        conn->key = key;
+        /* the connection may outlive h, so it does not use its callback */
+        int_cb.callback = pool_interrupt_cb;
+        int_cb.opaque   = conn;
+        conn->interrupt_callback = h->interrupt_callback;
+        ret = ffurl_open_whitelist(&conn->hd, lower_url, AVIO_FLAG_READ_WRITE,
+                                   &int_cb, options, h->protocol_whitelist,
+                                   h->protocol_blacklist, h);
+        if (ret < 0) {
+            pool_free_connection(&conn);
+            return ret;
+        }
+    }
+    conn->interrupt_callback = h->interrupt_callback;
+    s->conn = conn;
+    s->hd   = conn->hd;
+    return 0;
+}
+
+static void http_close_cnx(HTTPContext *s)
+{
+    if (s->conn) {
+        pool_free_connection(&s->conn);
+        s->hd = NULL;
+    } else {
+        ffurl_closep(&s->hd);
+    }
+}
+
+/**
+ * @return 1 if the response was entirely read and the server keeps the
+ * connection open for another request
+ */
+static int http_cnx_reusable(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t target_end = s->end_off ? s->end_off : s->filesize;
+
+    if (!s->hd || (h->flags & AVIO_FLAG_WRITE) || s->willclose ||
+        !s->end_header || s->buf_ptr != s->buf_end ||
+        (s->method && !av_strcasecmp(s->method, "HEAD")))
+        return 0;
+    if (s->chunksize != UINT64_MAX)
+        return s->chunkend;
+    return target_end != UINT64_MAX && s->off >= target_end;
+}
+
 static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 {
     const char *path, *proxy_path, *lower_proto = "tcp", *local_path;
@@ -196,7 +424,7 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     char auth[1024], proxyauth[1024] = "";
     char path1[MAX_URL_SIZE], sanitized_path[MAX_URL_SIZE];
     char buf[1024], urlbuf[MAX_URL_SIZE];
-    int port, use_proxy, err, location_changed = 0;
+    int port, use_proxy, err, location_changed = 0, reused = 0;
     HTTPContext *s = h->priv_data;
 
     av_url_split(proto, sizeof(proto), auth, sizeof(auth),
@@ -243,15 +471,29 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
     if (!s->hd) {
-        err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
-                                   &h->interrupt_callback, options,
-                                   h->protocol_whitelist, h->protocol_blacklist, h);
+        if (s->connection_pool && !(h->flags & AVIO_FLAG_WRITE))
+            err = http_open_pooled(h, buf, options, &reused);
+        else
+            err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
+                                       &h->interrupt_callback, options,
+                                       h->protocol_whitelist, h->protocol_blacklist, h);
         if (err < 0)
             return err;
     }
 
     err = http_connect(h, path, local_path, hoststr,
                        auth, proxyauth, &location_changed);
+    while (err < 0 && reused && err != AVERROR_EXIT &&
+           http_is_idempotent(h)) {
+        /* the server may have closed the idle connection meanwhile */
+        av_log(h, AV_LOG_DEBUG, "Pooled connection failed, reconnecting\n");
+        http_close_cnx(s);
+        err = http_open_pooled(h, buf, options, &reused);
+        if (err < 0)
+            return err;
+        err = http_connect(h, path, local_path, hoststr,
+                           auth, proxyauth, &location_changed);
+    }
     if (err < 0)
         return err;
 
@@ -278,7 +520,7 @@ redo:
     if (s->http_code == 401) {
         if ((cur_auth_type == HTTP_AUTH_NONE || s->auth_state.stale) &&
             s->auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_close_cnx(s);
             goto redo;
         } else
             goto fail;
@@ -286,7 +528,7 @@ redo:
     if (s->http_code == 407) {
         if ((cur_proxy_auth_type == HTTP_AUTH_NONE || s->proxy_auth_state.stale) &&
             s->proxy_auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_close_cnx(s);
             goto redo;
         } else
             goto fail;
@@ -295,7 +537,7 @@ redo:
          s->http_code == 303 || s->http_code == 307) &&
         location_changed == 1) {
         /* url moved, get next */
-        ffurl_closep(&s->hd);
+        http_close_cnx(s);
         if (redirects++ >= MAX_REDIRECTS)
             return AVERROR(EIO);
         /* Restart the authentication process with the new target, which
@@ -309,7 +551,7 @@ redo:
 
 fail:
     if (s->hd)
-        ffurl_closep(&s->hd);
+        http_close_cnx(s);
     if (location_changed < 0)
         return location_changed;
     return ff_http_averror(s->http_code, AVERROR(EIO));
@@ -322,6 +564,8 @@ int ff_http_get_shutdown_status(URLContext *h)
     /* flush the receive buffer when it is write only mode */
     char buf[1024];
     int read_ret;
+    if (s->listen == HTTP_SERVE)
+        return 0;
     read_ret = ffurl_read(s->hd, buf, sizeof(buf));
     if (read_ret < 0) {
         ret = read_ret;
@@ -361,6 +605,13 @@ int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
         return AVERROR(EINVAL);
     }
 
+    if (s->listen == HTTP_SERVE) {
+        ff_http_server_finish(s->server, &s->server_res);
+        if ((ret = av_opt_set_dict(s, opts)) < 0)
+            return ret;
+        return http_serve_request(h, uri);
+    }
+
     if (!s->end_chunked_post) {
         ret = http_shutdown(h, h->flags);
         if (ret < 0)
@@ -552,6 +803,49 @@ fail:
     return ret;
 }
 
+/* Publish the resource written to uri, or delete it */
+static int http_serve_request(URLContext *h, const char *uri)
+{
+    HTTPContext *s = h->priv_data;
+    char path[MAX_URL_SIZE];
+
+    av_url_split(NULL, 0, NULL, 0, NULL, 0, NULL, path, sizeof(path), uri);
+    path[strcspn(path, "?#")] = '\0';
+    if (!path[0])
+        av_strlcpy(path, "/", sizeof(path));
+
+    if (s->method && !av_strcasecmp(s->method, "DELETE"))
+        return ff_http_server_delete(s->server, path);
+    return ff_http_server_publish(s->server, path, &s->server_res);
+}
+
+static int http_serve(URLContext *h, const char *uri, int flags)
+{
+    HTTPContext *s = h->priv_data;
+    char hostname[1024], proto[10];
+    int port, ret;
+
+    if (flags & AVIO_FLAG_READ) {
+        av_log(h, AV_LOG_ERROR, "Serving is only supported for writing\n");
+        return AVERROR(EINVAL);
+    }
+    av_url_split(proto, sizeof(proto), NULL, 0, hostname, sizeof(hostname),
+                 &port, NULL, 0, uri);
+    if (strcmp(proto, "http")) {
+        av_log(h, AV_LOG_ERROR, "Serving is only supported over plain HTTP\n");
+        return AVERROR(EINVAL);
+    }
+    if (port < 0)
+        port = 80;
+
+    if ((ret = ff_http_server_open(&s->server, hostname, port,
+                                   s->serve_max_size, s->serve_max_age)) < 0)
+        return ret;
+    if ((ret = http_serve_request(h, uri)) < 0)
+        ff_http_server_close(&s->server);
+    return ret;
+}
+
 static int http_open(URLContext *h, const char *uri, int flags,
                      AVDictionary **options)
 {
@@ -584,6 +878,9 @@ static int http_open(URLContext *h, const char *uri, int flags,
         }
     }
 
+    if (s->listen == HTTP_SERVE) {
+        return http_serve(h, uri, flags);
+    }
     if (s->listen) {
         return http_listen(h, uri, flags, options);
     }
@@ -1295,7 +1592,8 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
         av_bprintf(&request, "Expect: 100-continue\r\n");
 
     if (!has_header(s->headers, "\r\nConnection: "))
-        av_bprintf(&request, "Connection: %s\r\n", s->multiple_requests ? "keep-alive" : "close");
+        av_bprintf(&request, "Connection: %s\r\n",
+                   s->multiple_requests || s->connection_pool ? "keep-alive" : "close");
 
     if (!has_header(s->headers, "\r\nHost: "))
         av_bprintf(&request, "Host: %s\r\n", hoststr);
@@ -1400,14 +1698,14 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
                    "Chunked encoding data size: %"PRIu64"\n",
                     s->chunksize);
 
-            if (!s->chunksize && s->multiple_requests) {
+            if (!s->chunksize && (s->multiple_requests || s->connection_pool)) {
                 http_get_line(s, line, sizeof(line)); // read empty chunk
                 s->chunkend = 1;
                 return 0;
             }
             else if (!s->chunksize) {
                 av_log(h, AV_LOG_DEBUG, "Last chunk received, closing conn\n");
-                ffurl_closep(&s->hd);
+                http_close_cnx(s);
                 return 0;
             }
             else if (s->chunksize == UINT64_MAX) {
@@ -1642,6 +1940,10 @@ static int http_write(URLContext *h, const uint8_t *buf, int size)
     char crlf[] = "\r\n";
     HTTPContext *s = h->priv_data;
 
+    if (s->listen == HTTP_SERVE)
+        return s->server_res ? ff_http_server_write(s->server, s->server_res, buf, size)
+                             : size;
+
     if (!s->chunked_post) {
         /* non-chunked data is sent without any special encoding */
         return ffurl_write(s->hd, buf, size);
@@ -1667,6 +1969,11 @@ static int http_shutdown(URLContext *h, int flags)
     char footer[] = "0\r\n\r\n";
     HTTPContext *s = h->priv_data;
 
+    if (s->listen == HTTP_SERVE) {
+        ff_http_server_finish(s->server, &s->server_res);
+        return 0;
+    }
+
     /* signal end of chunked encoding if used */
     if (((flags & AVIO_FLAG_WRITE) && s->chunked_post) ||
         ((flags & AVIO_FLAG_READ) && s->chunked_post && s->listen)) {
@@ -1704,8 +2011,18 @@ static int http_close(URLContext *h)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
 
+    if (s->server) {
+        ff_http_server_finish(s->server, &s->server_res);
+        ff_http_server_close(&s->server);
+    }
+
+    if (s->conn && http_cnx_reusable(h)) {
+        pool_put(s->conn, s->pool_max_idle, s->pool_idle_timeout);
+        s->conn = NULL;
+        s->hd   = NULL;
+    }
     if (s->hd)
-        ffurl_closep(&s->hd);
+        http_close_cnx(s);
     av_dict_free(&s->chained_options);
     return ret;
 }
@@ -1714,6 +2031,7 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
 {
     HTTPContext *s = h->priv_data;
     URLContext *old_hd = s->hd;
+    HTTPConnection *old_conn = s->conn;
     uint64_t old_off = s->off;
     uint8_t old_buf[BUFFER_SIZE];
     int old_buf_size, ret;
@@ -1751,7 +2069,8 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
     /* we save the old context in case the seek fails */
     old_buf_size = s->buf_end - s->buf_ptr;
     memcpy(old_buf, s->buf_ptr, old_buf_size);
-    s->hd = NULL;
+    s->hd   = NULL;
+    s->conn = NULL;
 
     /* if it fails, continue on old connection */
     if ((ret = http_open_cnx(h, &options)) < 0) {
@@ -1760,11 +2079,15 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
         s->buf_ptr = s->buffer;
         s->buf_end = s->buffer + old_buf_size;
         s->hd      = old_hd;
+        s->conn    = old_conn;
         s->off     = old_off;
         return ret;
     }
     av_dict_free(&options);
-    ffurl_close(old_hd);
+    if (old_conn)
+        pool_free_connection(&old_conn);
+    else
+        ffurl_close(old_hd);
     return off;
 }
 
@@ -1776,6 +2099,8 @@ static int64_t http_seek(URLContext *h, int64_t off, int whence)
 static int http_get_file_handle(URLContext *h)
 {
     HTTPContext *s = h->priv_data;
+    if (!s->hd)
+        return AVERROR(ENOSYS);
     return ffurl_get_file_handle(s->hd);
 }
 
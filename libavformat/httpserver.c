@@ -0,0 +1,1043 @@
+/*
+ * In-memory HTTP server
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE /* pipe2() */
+
+#include "config.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "httpserver.h"
+#include "network.h"
+#include "os_support.h"
+
+#if HAVE_EPOLL_CREATE1 && HAVE_PTHREADS
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#define REQUEST_SIZE 4096
+#define CHUNK_SIZE   65536
+#define MAX_EVENTS   64
+/* time the server keeps running once it is no longer referenced */
+#define LINGER_TIME  10000000
+/* time a blocking playlist reload is held for when the playlist does not
+ * give its target duration */
+#define BLOCK_TIME   10000000
+
+/* All the fields are protected by the server mutex. The data below size
+ * never changes: the server thread sends it without holding the mutex. */
+struct HTTPServerResource {
+    char *path;
+    AVBufferRef *buf;           ///< data, replaced by a larger buffer when full
+    size_t size;
+    int complete;
+    int64_t completed_at;
+    int listed;                 ///< the resource is in the resources list
+    int refcount;
+    HTTPServerResource *next;
+};
+
+typedef struct HTTPServerClient {
+    int fd;
+    uint32_t events;            ///< epoll events the client is registered for
+    char request[REQUEST_SIZE + 1];
+    int request_len;
+    uint8_t *out;               ///< headers and chunk sizes left to send
+    unsigned int out_allocated;
+    size_t out_size, out_pos;
+    HTTPServerResource *res;    ///< resource being sent
+    size_t res_pos;
+    AVBufferRef *data;          ///< reference to the data of res
+    const uint8_t *data_ptr;    ///< data of res left to send
+    size_t data_len;
+    int chunk_end;              ///< a chunk of data needs its trailing CRLF
+    int chunked;
+    int close;                  ///< close the connection after the response
+    int64_t blocked_until;      ///< the request waits for a playlist update until then
+    int dead;
+    struct HTTPServerClient *next;
+} HTTPServerClient;
+
+struct HTTPServer {
+    const AVClass *class;
+    char *hostname;
+    int port;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd[2];
+
+    /* protected by servers_lock and mutex */
+    int refcount;
+    int64_t idle_since;
+    HTTPServer *next;
+
+    /* only used by the server thread */
+    HTTPServerClient *clients;
+
+    /* protected by mutex */
+    pthread_mutex_t mutex;
+    int wake_pending;
+    HTTPServerResource *resources;
+    int64_t total_size;         ///< size of the listed resources
+    int64_t max_size;
+    int64_t max_age;
+};
+
+static const AVClass server_class = {
+    .class_name = "http_server",
+    .item_name  = av_default_item_name,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+static pthread_mutex_t servers_lock = PTHREAD_MUTEX_INITIALIZER;
+static HTTPServer *servers;
+
+static const struct {
+    const char *extension;
+    const char *type;
+} content_types[] = {
+    { "m3u8", "application/vnd.apple.mpegurl" },
+    { "mpd",  "application/dash+xml"          },
+    { "ts",   "video/mp2t"                    },
+    { "m4s",  "video/iso.segment"             },
+    { "mp4",  "video/mp4"                     },
+    { "m4a",  "audio/mp4"                     },
+    { "aac",  "audio/aac"                     },
+    { "webm", "video/webm"                    },
+    { "vtt",  "text/vtt"                      },
+};
+
+static const char *content_type(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    int i;
+
+    if (ext && !strchr(ext, '/'))
+        for (i = 0; i < FF_ARRAY_ELEMS(content_types); i++)
+            if (!av_strcasecmp(ext + 1, content_types[i].extension))
+                return content_types[i].type;
+    return "application/octet-stream";
+}
+
+/* Must be called with the mutex held, as all the resource functions. */
+static void resource_unref(HTTPServerResource **pres)
+{
+    HTTPServerResource *res = *pres;
+
+    if (res && !--res->refcount) {
+        av_freep(&res->path);
+        av_buffer_unref(&res->buf);
+        av_free(res);
+    }
+    *pres = NULL;
+}
+
+static HTTPServerResource **find_resource(HTTPServer *srv, const char *path)
+{
+    HTTPServerResource **link = &srv->resources;
+
+    while (*link && strcmp((*link)->path, path))
+        link = &(*link)->next;
+    return link;
+}
+
+static void remove_resource(HTTPServer *srv, HTTPServerResource **link)
+{
+    HTTPServerResource *res = *link;
+
+    *link     = res->next;
+    res->next = NULL;
+    res->listed = 0;
+    srv->total_size -= res->size;
+    resource_unref(&res);
+}
+
+/**
+ * Remove the complete resources exceeding the size and age limits, the
+ * oldest first.
+ * @return time the oldest remaining resource expires at, INT64_MAX if none
+ */
+static int64_t expire_resources(HTTPServer *srv, int64_t now)
+{
+    if (!srv->max_size && !srv->max_age)
+        return INT64_MAX;
+    for (;;) {
+        HTTPServerResource **link, **oldest = NULL;
+
+        for (link = &srv->resources; *link; link = &(*link)->next)
+            if ((*link)->complete &&
+                (!oldest || (*link)->completed_at < (*oldest)->completed_at))
+                oldest = link;
+        if (!oldest)
+            return INT64_MAX;
+        if ((!srv->max_size || srv->total_size <= srv->max_size) &&
+            (!srv->max_age  || now - (*oldest)->completed_at < srv->max_age))
+            return srv->max_age ? (*oldest)->completed_at + srv->max_age : INT64_MAX;
+        av_log(srv, AV_LOG_DEBUG, "Dropping %s\n", (*oldest)->path);
+        remove_resource(srv, oldest);
+    }
+}
+
+static void wake_server(HTTPServer *srv)
+{
+    if (!srv->wake_pending) {
+        srv->wake_pending = write(srv->wake_fd[1], "", 1) == 1;
+    }
+}
+
+static void client_set_events(HTTPServer *srv, HTTPServerClient *c,
+                              uint32_t events)
+{
+    struct epoll_event ev = { .events = events, .data.ptr = c };
+
+    if (c->events != events &&
+        !epoll_ctl(srv->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev))
+        c->events = events;
+}
+
+static void client_close(HTTPServer *srv, HTTPServerClient *c)
+{
+    if (c->dead)
+        return;
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    closesocket(c->fd);
+    pthread_mutex_lock(&srv->mutex);
+    resource_unref(&c->res);
+    pthread_mutex_unlock(&srv->mutex);
+    av_buffer_unref(&c->data);
+    c->dead = 1;
+}
+
+static void free_dead_clients(HTTPServer *srv)
+{
+    HTTPServerClient **link = &srv->clients;
+
+    while (*link) {
+        HTTPServerClient *c = *link;
+        if (c->dead) {
+            *link = c->next;
+            av_buffer_unref(&c->data);
+            av_free(c->out);
+            av_free(c);
+        } else {
+            link = &c->next;
+        }
+    }
+}
+
+static int client_append(HTTPServerClient *c, const void *data, size_t size)
+{
+    uint8_t *out;
+
+    if (size > UINT_MAX - c->out_size)
+        return AVERROR(ENOMEM);
+    out = av_fast_realloc(c->out, &c->out_allocated, c->out_size + size);
+    if (!out)
+        return AVERROR(ENOMEM);
+    c->out = out;
+    memcpy(c->out + c->out_size, data, size);
+    c->out_size += size;
+    return 0;
+}
+
+static av_printf_format(2, 3) int client_printf(HTTPServerClient *c, const char *fmt, ...)
+{
+    char buf[1024];
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (len < 0 || len >= sizeof(buf))
+        return AVERROR(EINVAL);
+    return client_append(c, buf, len);
+}
+
+static int client_reply_status(HTTPServerClient *c, int code,
+                               const char *reason, const char *headers)
+{
+    return client_printf(c, "HTTP/1.1 %d %s\r\n"
+                            "Content-Length: 0\r\n"
+                            "%s"
+                            "Connection: %s\r\n"
+                            "\r\n",
+                         code, reason, headers,
+                         c->close ? "close" : "keep-alive");
+}
+
+/**
+ * Check whether an HLS playlist lists a media segment or a part of it yet,
+ * for a low-latency HLS blocking playlist reload.
+ *
+ * @param part index of the part in the segment, -1 for the whole segment
+ * @param target_duration set to the target duration of the playlist
+ * @return 1 if it does, 0 if it does not yet, AVERROR(EINVAL) if the segment
+ *         is too far ahead to be waited for
+ */
+static int playlist_has_part(const HTTPServerResource *res, int64_t msn,
+                             int64_t part, int *target_duration)
+{
+    const char *p = res->buf ? (const char *)res->buf->data : "", *end = p + res->size;
+    int64_t sequence = 0, segments = 0, parts = 0;
+    int ended = 0;
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p), *ptr;
+        char line[64];
+
+        if (!eol)
+            eol = end;
+        av_strlcpy(line, p, FFMIN(eol - p + 1, sizeof(line)));
+        p = eol + 1;
+
+        if (av_strstart(line, "#EXT-X-TARGETDURATION:", &ptr)) {
+            *target_duration = atoi(ptr);
+        } else if (av_strstart(line, "#EXT-X-MEDIA-SEQUENCE:", &ptr)) {
+            sequence = strtoll(ptr, NULL, 10);
+        } else if (av_strstart(line, "#EXT-X-SKIP:SKIPPED-SEGMENTS=", &ptr)) {
+            segments += strtoll(ptr, NULL, 10);
+        } else if (av_strstart(line, "#EXTINF:", NULL)) {
+            segments++;
+            parts = 0;
+        } else if (av_strstart(line, "#EXT-X-PART:", NULL)) {
+            parts++;
+        } else if (av_strstart(line, "#EXT-X-ENDLIST", NULL)) {
+            ended = 1;
+        }
+    }
+
+    /* the parts after the last segment belong to the one being written */
+    if (ended || msn < sequence + segments)
+        return 1;
+    if (msn > sequence + segments + 1)
+        return AVERROR(EINVAL);
+    return msn == sequence + segments && part >= 0 && part < parts;
+}
+
+/**
+ * Parse the first buffered request and queue its response.
+ * @return 1 if a request was handled, 0 if it is not complete yet or waits
+ *         for a playlist update
+ */
+static int client_handle_request(HTTPServer *srv, HTTPServerClient *c)
+{
+    char method[16], path[REQUEST_SIZE], value[32], *end, *line, *query;
+    HTTPServerResource *res;
+    int64_t msn = -1, part = -1;
+    size_t size = 0;
+    int minor, ret, consumed, skip = 0, complete = 0, target_duration = 0;
+
+    c->request[c->request_len] = '\0';
+    end = strstr(c->request, "\r\n\r\n");
+    if (!end) {
+        if (c->request_len < REQUEST_SIZE)
+            return 0;
+        c->close = 1;
+        c->request_len = 0;
+        if (client_reply_status(c, 400, "Bad Request", "") < 0)
+            client_close(srv, c);
+        return 1;
+    }
+    *end = '\0';
+    consumed = end + 4 - c->request;
+
+    if (sscanf(c->request, "%15s %4095s HTTP/1.%d", method, path, &minor) != 3) {
+        c->close = 1;
+        ret = client_reply_status(c, 400, "Bad Request", "");
+        goto end;
+    }
+    path[strcspn(path, "#")] = '\0';
+    /* low-latency HLS playlist requests */
+    if ((query = strchr(path, '?'))) {
+        if (av_find_info_tag(value, sizeof(value), "_HLS_msn", query))
+            msn = strtoll(value, NULL, 10);
+        if (av_find_info_tag(value, sizeof(value), "_HLS_part", query))
+            part = strtoll(value, NULL, 10);
+        if (av_find_info_tag(value, sizeof(value), "_HLS_skip", query))
+            skip = !strcmp(value, "YES") || !strcmp(value, "v2");
+        *query = '\0';
+    }
+
+    c->close = minor < 1;
+    for (line = strstr(c->request, "\r\n"); line; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (!av_strncasecmp(line, "Connection:", 11)) {
+            const char *value = line + 11 + strspn(line + 11, " \t");
+            if (!av_strncasecmp(value, "close", 5))
+                c->close = 1;
+            else if (!av_strncasecmp(value, "keep-alive", 10))
+                c->close = 0;
+        }
+    }
+
+    if (strcmp(method, "GET") && strcmp(method, "HEAD")) {
+        ret = client_reply_status(c, 405, "Method Not Allowed",
+                                  "Allow: GET, HEAD\r\n");
+        goto end;
+    }
+
+    pthread_mutex_lock(&srv->mutex);
+    if (skip && av_match_ext(path, "m3u8")) {
+        char delta[REQUEST_SIZE];
+        snprintf(delta, sizeof(delta), "%.*s_delta.m3u8", (int)strlen(path) - 5, path);
+        if (*find_resource(srv, delta))
+            av_strlcpy(path, delta, sizeof(path));
+    }
+
+    res = *find_resource(srv, path);
+    ret = 1;
+    if ((msn >= 0 || part >= 0) && av_match_ext(path, "m3u8")) {
+        if (msn < 0 || part < -1)
+            ret = AVERROR(EINVAL);
+        else if (res && res->complete)
+            ret = playlist_has_part(res, msn, part, &target_duration);
+        else
+            ret = 0;
+    }
+    if (ret > 0 && res) {
+        res->refcount++;
+        size     = res->size;
+        complete = res->complete;
+    }
+    pthread_mutex_unlock(&srv->mutex);
+
+    if (ret < 0) {
+        c->blocked_until = 0;
+        ret = client_reply_status(c, 400, "Bad Request", "");
+        goto end;
+    }
+    if (!ret) {
+        int64_t now = av_gettime_relative();
+        if (!c->blocked_until)
+            c->blocked_until = now + (target_duration > 0 ?
+                                      3 * target_duration * INT64_C(1000000) : BLOCK_TIME);
+        if (now < c->blocked_until) {
+            /* keep the request buffered, it is handled again on updates */
+            *end = '\r';
+            return 0;
+        }
+        c->blocked_until = 0;
+        ret = client_reply_status(c, 503, "Service Unavailable", "");
+        goto end;
+    }
+    c->blocked_until = 0;
+    if (!res) {
+        ret = client_reply_status(c, 404, "Not Found", "");
+        goto end;
+    }
+
+    ret = client_printf(c, "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: %s\r\n", content_type(path));
+    if (ret >= 0) {
+        if (complete) {
+            ret = client_printf(c, "Content-Length: %zu\r\n", size);
+        } else if (minor >= 1) {
+            ret = client_printf(c, "Transfer-Encoding: chunked\r\n");
+            c->chunked = 1;
+        } else {
+            /* the end of the connection marks the end of the body */
+            c->close = 1;
+        }
+    }
+    if (ret >= 0)
+        ret = client_printf(c, "Connection: %s\r\n\r\n",
+                            c->close ? "close" : "keep-alive");
+    if (ret >= 0 && strcmp(method, "HEAD")) {
+        c->res     = res;
+        c->res_pos = 0;
+    } else {
+        c->chunked = 0;
+        pthread_mutex_lock(&srv->mutex);
+        resource_unref(&res);
+        pthread_mutex_unlock(&srv->mutex);
+    }
+
+end:
+    c->request_len -= consumed;
+    memmove(c->request, c->request + consumed, c->request_len);
+    if (ret < 0)
+        client_close(srv, c);
+    return 1;
+}
+
+static int client_send(HTTPServer *srv, HTTPServerClient *c,
+                       const uint8_t *buf, size_t size)
+{
+    ssize_t len = send(c->fd, buf, size, MSG_NOSIGNAL);
+    int ret;
+
+    if (len >= 0)
+        return len;
+    ret = ff_neterrno();
+    if (ret == AVERROR(EAGAIN))
+        client_set_events(srv, c, EPOLLOUT);
+    else if (ret != AVERROR(EINTR))
+        client_close(srv, c);
+    return ret;
+}
+
+/**
+ * Send as much of the response as possible, then wait for the next event
+ * the client needs. The data of the resources is sent from the buffers they
+ * are written to, without holding the mutex.
+ */
+static void client_update(HTTPServer *srv, HTTPServerClient *c)
+{
+    while (!c->dead) {
+        HTTPServerResource *res = c->res;
+        int ret = 0;
+
+        if (c->out_pos < c->out_size) {
+            ret = client_send(srv, c, c->out + c->out_pos, c->out_size - c->out_pos);
+            if (ret == AVERROR(EAGAIN))
+                return;
+            c->out_pos += FFMAX(ret, 0);
+            continue;
+        }
+        c->out_pos = c->out_size = 0;
+
+        if (c->data_len) {
+            ret = client_send(srv, c, c->data_ptr, c->data_len);
+            if (ret == AVERROR(EAGAIN))
+                return;
+            if (ret > 0) {
+                c->data_ptr += ret;
+                c->data_len -= ret;
+            }
+            continue;
+        }
+        if (c->chunk_end) {
+            c->chunk_end = 0;
+            if (client_append(c, "\r\n", 2) < 0)
+                client_close(srv, c);
+            continue;
+        }
+
+        if (res) {
+            size_t size;
+            int complete;
+
+            pthread_mutex_lock(&srv->mutex);
+            size     = res->size;
+            complete = res->complete;
+            if (c->res_pos < size && (!c->data || c->data->buffer != res->buf->buffer)) {
+                av_buffer_unref(&c->data);
+                c->data = av_buffer_ref(res->buf);
+            }
+            if (c->res_pos >= size && complete)
+                resource_unref(&c->res);
+            pthread_mutex_unlock(&srv->mutex);
+
+            if (c->res_pos < size) {
+                size = FFMIN(size - c->res_pos, CHUNK_SIZE);
+                if (!c->data)
+                    ret = AVERROR(ENOMEM);
+                else if (c->chunked)
+                    ret = client_printf(c, "%zx\r\n", size);
+                if (ret >= 0) {
+                    c->data_ptr  = c->data->data + c->res_pos;
+                    c->data_len  = size;
+                    c->chunk_end = c->chunked;
+                    c->res_pos  += size;
+                }
+            } else if (complete) {
+                av_buffer_unref(&c->data);
+                if (c->chunked)
+                    ret = client_append(c, "0\r\n\r\n", 5);
+                c->chunked = 0;
+            } else {
+                /* woken up once the resource gets more data */
+                client_set_events(srv, c, 0);
+                return;
+            }
+            if (ret < 0)
+                client_close(srv, c);
+            continue;
+        }
+
+        if (c->close) {
+            client_close(srv, c);
+            return;
+        }
+        if (!client_handle_request(srv, c)) {
+            /* a blocked request is woken up by the resource updates */
+            client_set_events(srv, c, c->blocked_until ? 0 : EPOLLIN);
+            return;
+        }
+    }
+}
+
+static void client_read(HTTPServer *srv, HTTPServerClient *c)
+{
+    while (c->request_len < REQUEST_SIZE) {
+        int ret = recv(c->fd, c->request + c->request_len,
+                       REQUEST_SIZE - c->request_len, 0);
+        if (ret > 0) {
+            c->request_len += ret;
+        } else if (!ret) {
+            client_close(srv, c);
+            return;
+        } else if (ff_neterrno() == AVERROR(EAGAIN)) {
+            break;
+        } else if (ff_neterrno() != AVERROR(EINTR)) {
+            client_close(srv, c);
+            return;
+        }
+    }
+    client_update(srv, c);
+}
+
+static void accept_clients(HTTPServer *srv)
+{
+    for (;;) {
+        struct epoll_event ev = { .events = EPOLLIN };
+        HTTPServerClient *c;
+        int fd = accept(srv->listen_fd, NULL, NULL);
+
+        if (fd < 0) {
+            int err = ff_neterrno();
+            if (err == AVERROR(EINTR))
+                continue;
+            if (err != AVERROR(EAGAIN))
+                av_log(srv, AV_LOG_WARNING, "accept() failed: %s\n",
+                       av_err2str(err));
+            return;
+        }
+        ff_socket_nonblock(fd, 1);
+        c = av_mallocz(sizeof(*c));
+        if (!c) {
+            closesocket(fd);
+            continue;
+        }
+        c->fd       = fd;
+        c->events   = ev.events;
+        ev.data.ptr = c;
+        if (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            closesocket(fd);
+            av_free(c);
+            continue;
+        }
+        c->next      = srv->clients;
+        srv->clients = c;
+    }
+}
+
+static void server_free(HTTPServer *srv)
+{
+    HTTPServerClient *c;
+
+    for (c = srv->clients; c; c = c->next)
+        client_close(srv, c);
+    free_dead_clients(srv);
+    while (srv->resources)
+        remove_resource(srv, &srv->resources);
+
+    if (srv->listen_fd >= 0)
+        closesocket(srv->listen_fd);
+    if (srv->epoll_fd >= 0)
+        close(srv->epoll_fd);
+    if (srv->wake_fd[0] >= 0)
+        close(srv->wake_fd[0]);
+    if (srv->wake_fd[1] >= 0)
+        close(srv->wake_fd[1]);
+    pthread_mutex_destroy(&srv->mutex);
+    av_freep(&srv->hostname);
+    av_free(srv);
+}
+
+/**
+ * Unregister an idle server.
+ * @return 1 if it was unregistered, 0 if it got referenced meanwhile
+ */
+static int server_stop(HTTPServer *srv)
+{
+    HTTPServer **link;
+    int stop;
+
+    /* servers_lock is taken first */
+    pthread_mutex_unlock(&srv->mutex);
+    pthread_mutex_lock(&servers_lock);
+    pthread_mutex_lock(&srv->mutex);
+    stop = !srv->refcount;
+    if (stop) {
+        for (link = &servers; *link != srv; link = &(*link)->next);
+        *link = srv->next;
+    }
+    pthread_mutex_unlock(&servers_lock);
+    return stop;
+}
+
+static void *server_thread(void *arg)
+{
+    HTTPServer *srv = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    for (;;) {
+        int i, nb_events, timeout = -1;
+        int64_t now = av_gettime_relative(), expiry;
+        HTTPServerClient *c;
+
+        pthread_mutex_lock(&srv->mutex);
+        if (!srv->refcount) {
+            int64_t idle = now - srv->idle_since;
+            if (idle >= LINGER_TIME && server_stop(srv))
+                break;
+            if (!srv->refcount)
+                timeout = (LINGER_TIME - idle) / 1000 + 1;
+        }
+        expiry = expire_resources(srv, now);
+        pthread_mutex_unlock(&srv->mutex);
+
+        if (expiry < INT64_MAX) {
+            int wait = FFMIN(FFMAX(expiry - now, 0) / 1000 + 1, INT_MAX);
+            if (timeout < 0 || wait < timeout)
+                timeout = wait;
+        }
+        for (c = srv->clients; c; c = c->next) {
+            if (c->blocked_until) {
+                int block = FFMAX(c->blocked_until - now, 0) / 1000 + 1;
+                if (timeout < 0 || block < timeout)
+                    timeout = block;
+            }
+        }
+
+        nb_events = epoll_wait(srv->epoll_fd, events, MAX_EVENTS, timeout);
+
+        for (i = 0; i < nb_events; i++) {
+            void *ptr = events[i].data.ptr;
+
+            if (ptr == &srv->listen_fd) {
+                accept_clients(srv);
+            } else if (ptr == srv->wake_fd) {
+                char buf[64];
+
+                pthread_mutex_lock(&srv->mutex);
+                while (read(srv->wake_fd[0], buf, sizeof(buf)) > 0);
+                srv->wake_pending = 0;
+                pthread_mutex_unlock(&srv->mutex);
+                for (c = srv->clients; c; c = c->next)
+                    if ((c->res || c->blocked_until) && !c->events)
+                        client_update(srv, c);
+            } else {
+                c = ptr;
+
+                if (c->dead)
+                    continue;
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                    client_close(srv, c);
+                else if (events[i].events & EPOLLIN)
+                    client_read(srv, c);
+                else
+                    client_update(srv, c);
+            }
+        }
+        now = av_gettime_relative();
+        for (c = srv->clients; c; c = c->next)
+            if (c->blocked_until && c->blocked_until <= now && !c->dead)
+                client_update(srv, c);
+        free_dead_clients(srv);
+    }
+    pthread_mutex_unlock(&srv->mutex);
+
+    server_free(srv);
+    return NULL;
+}
+
+static int server_start(HTTPServer *srv)
+{
+    struct addrinfo hints = { 0 }, *ai, *cur;
+    struct epoll_event ev = { .events = EPOLLIN };
+    pthread_attr_t attr;
+    pthread_t thread;
+    char portstr[10];
+    int ret;
+
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE;
+    snprintf(portstr, sizeof(portstr), "%d", srv->port);
+    ret = getaddrinfo(srv->hostname[0] ? srv->hostname : NULL, portstr, &hints, &ai);
+    if (ret) {
+        av_log(srv, AV_LOG_ERROR, "Failed to resolve hostname %s: %s\n",
+               srv->hostname, gai_strerror(ret));
+        return AVERROR(EIO);
+    }
+
+    ret = AVERROR(EIO);
+    for (cur = ai; cur; cur = cur->ai_next) {
+        int reuse = 1;
+        int fd = ff_socket(cur->ai_family, cur->ai_socktype, cur->ai_protocol);
+
+        if (fd < 0) {
+            ret = ff_neterrno();
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(fd, cur->ai_addr, cur->ai_addrlen) ||
+            listen(fd, SOMAXCONN)) {
+            ret = ff_neterrno();
+            closesocket(fd);
+            continue;
+        }
+        srv->listen_fd = fd;
+        break;
+    }
+    freeaddrinfo(ai);
+    if (srv->listen_fd < 0) {
+        av_log(srv, AV_LOG_ERROR, "Failed to listen on %s:%d: %s\n",
+               srv->hostname, srv->port, av_err2str(ret));
+        return ret;
+    }
+    ff_socket_nonblock(srv->listen_fd, 1);
+
+    srv->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (srv->epoll_fd < 0 || pipe2(srv->wake_fd, O_NONBLOCK | O_CLOEXEC) < 0)
+        return AVERROR(errno);
+    ev.data.ptr = &srv->listen_fd;
+    if (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, srv->listen_fd, &ev) < 0)
+        return AVERROR(errno);
+    ev.data.ptr = srv->wake_fd;
+    if (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, srv->wake_fd[0], &ev) < 0)
+        return AVERROR(errno);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&thread, &attr, server_thread, srv);
+    pthread_attr_destroy(&attr);
+    if (ret) {
+        av_log(srv, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        return AVERROR(ret);
+    }
+    return 0;
+}
+
+int ff_http_server_open(HTTPServer **server, const char *hostname, int port,
+                        int64_t max_size, int64_t max_age)
+{
+    HTTPServer *srv;
+    int ret;
+
+    pthread_mutex_lock(&servers_lock);
+    for (srv = servers; srv; srv = srv->next) {
+        if (srv->port == port && !strcmp(srv->hostname, hostname)) {
+            pthread_mutex_lock(&srv->mutex);
+            srv->refcount++;
+            srv->max_size = max_size;
+            srv->max_age  = max_age;
+            wake_server(srv);
+            pthread_mutex_unlock(&srv->mutex);
+            goto end;
+        }
+    }
+
+    srv = av_mallocz(sizeof(*srv));
+    if (!srv) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    srv->class      = &server_class;
+    srv->port       = port;
+    srv->refcount   = 1;
+    srv->max_size   = max_size;
+    srv->max_age    = max_age;
+    srv->listen_fd  = srv->epoll_fd   = -1;
+    srv->wake_fd[0] = srv->wake_fd[1] = -1;
+    srv->hostname   = av_strdup(hostname);
+    if ((ret = pthread_mutex_init(&srv->mutex, NULL))) {
+        av_freep(&srv->hostname);
+        av_freep(&srv);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if (!srv->hostname) {
+        server_free(srv);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = server_start(srv)) < 0) {
+        server_free(srv);
+        goto fail;
+    }
+    srv->next = servers;
+    servers   = srv;
+    av_log(srv, AV_LOG_VERBOSE, "Serving on %s:%d\n", hostname, port);
+
+end:
+    pthread_mutex_unlock(&servers_lock);
+    *server = srv;
+    return 0;
+fail:
+    pthread_mutex_unlock(&servers_lock);
+    return ret;
+}
+
+void ff_http_server_close(HTTPServer **server)
+{
+    HTTPServer *srv = *server;
+
+    if (!srv)
+        return;
+    pthread_mutex_lock(&srv->mutex);
+    if (!--srv->refcount) {
+        srv->idle_since = av_gettime_relative();
+        wake_server(srv);
+    }
+    pthread_mutex_unlock(&srv->mutex);
+    *server = NULL;
+}
+
+int ff_http_server_publish(HTTPServer *srv, const char *path,
+                           HTTPServerResource **pres)
+{
+    HTTPServerResource *res = av_mallocz(sizeof(*res)), **link;
+
+    if (!res)
+        return AVERROR(ENOMEM);
+    res->path = av_strdup(path);
+    if (!res->path) {
+        av_free(res);
+        return AVERROR(ENOMEM);
+    }
+    /* one reference for the server, one for the writer */
+    res->refcount = 2;
+    res->listed   = 1;
+
+    pthread_mutex_lock(&srv->mutex);
+    link = find_resource(srv, path);
+    if (*link)
+        remove_resource(srv, link);
+    res->next      = srv->resources;
+    srv->resources = res;
+    pthread_mutex_unlock(&srv->mutex);
+
+    *pres = res;
+    return 0;
+}
+
+int ff_http_server_write(HTTPServer *srv, HTTPServerResource *res,
+                         const uint8_t *buf, int size)
+{
+    size_t new_size;
+
+    pthread_mutex_lock(&srv->mutex);
+    new_size = res->size + size;
+    if (new_size > INT_MAX / 3 * 2) {
+        pthread_mutex_unlock(&srv->mutex);
+        return AVERROR(ENOMEM);
+    }
+    /* the data being sent is kept alive by the references of the clients
+     * to the previous buffer */
+    if (!res->buf || new_size > res->buf->size) {
+        AVBufferRef *new_buf = av_buffer_alloc(FFMAX(new_size + new_size / 2, 4096));
+        if (!new_buf) {
+            pthread_mutex_unlock(&srv->mutex);
+            return AVERROR(ENOMEM);
+        }
+        if (res->size)
+            memcpy(new_buf->data, res->buf->data, res->size);
+        av_buffer_unref(&res->buf);
+        res->buf = new_buf;
+    }
+    memcpy(res->buf->data + res->size, buf, size);
+    res->size = new_size;
+    if (res->listed) {
+        srv->total_size += size;
+        if (srv->max_size && srv->total_size > srv->max_size)
+            expire_resources(srv, av_gettime_relative());
+    }
+    wake_server(srv);
+    pthread_mutex_unlock(&srv->mutex);
+    return size;
+}
+
+void ff_http_server_finish(HTTPServer *srv, HTTPServerResource **res)
+{
+    if (!*res)
+        return;
+    pthread_mutex_lock(&srv->mutex);
+    (*res)->complete     = 1;
+    (*res)->completed_at = av_gettime_relative();
+    if ((*res)->listed && srv->max_size && srv->total_size > srv->max_size)
+        expire_resources(srv, (*res)->completed_at);
+    wake_server(srv);
+    resource_unref(res);
+    pthread_mutex_unlock(&srv->mutex);
+}
+
+int ff_http_server_delete(HTTPServer *srv, const char *path)
+{
+    HTTPServerResource **link;
+
+    pthread_mutex_lock(&srv->mutex);
+    link = find_resource(srv, path);
+    if (*link)
+        remove_resource(srv, link);
+    pthread_mutex_unlock(&srv->mutex);
+    return 0;
+}
+
+#else
+
+int ff_http_server_open(HTTPServer **server, const char *hostname, int port,
+                        int64_t max_size, int64_t max_age)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_http_server_close(HTTPServer **server)
+{
+}
+
+int ff_http_server_publish(HTTPServer *server, const char *path,
+                           HTTPServerResource **res)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_http_server_write(HTTPServer *server, HTTPServerResource *res,
+                         const uint8_t *buf, int size)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_http_server_finish(HTTPServer *server, HTTPServerResource **res)
+{
+}
+
+int ff_http_server_delete(HTTPServer *server, const char *path)
+{
+    return AVERROR(ENOSYS);
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * In-memory HTTP server
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HTTPSERVER_H
+#define AVFORMAT_HTTPSERVER_H
+
+#include <stdint.h>
+
+/**
+ * A server answering the GET and HEAD requests of any number of HTTP/1.1
+ * clients from the resources written to it. A resource still being written
+ * is sent with chunked transfer encoding as its data arrives.
+ *
+ * There is one server per listening address in the process. It keeps
+ * running as long as it is referenced, and for a few seconds after, so
+ * that the gaps between the resources written by a muxer are not noticed
+ * by the clients.
+ */
+typedef struct HTTPServer HTTPServer;
+
+typedef struct HTTPServerResource HTTPServerResource;
+
+/**
+ * Get a reference to the server listening on hostname:port, starting it
+ * if needed.
+ *
+ * The complete resources are dropped, the oldest first, while their total
+ * size exceeds max_size or once they are older than max_age. The limits
+ * given last apply to the whole server.
+ *
+ * @param hostname address to listen on, all addresses if empty
+ * @param max_size maximum size of the resources in bytes, 0 for no limit
+ * @param max_age  time in microseconds complete resources are served for,
+ *                 0 for no limit
+ */
+int ff_http_server_open(HTTPServer **server, const char *hostname, int port,
+                        int64_t max_size, int64_t max_age);
+
+/**
+ * Release a reference to a server and set *server to NULL.
+ */
+void ff_http_server_close(HTTPServer **server);
+
+/**
+ * Start writing a resource. Requests for path are answered with it from
+ * now on, instead of any previous resource with the same path.
+ */
+int ff_http_server_publish(HTTPServer *server, const char *path,
+                           HTTPServerResource **res);
+
+/**
+ * Append data to a resource being written.
+ */
+int ff_http_server_write(HTTPServer *server, HTTPServerResource *res,
+                         const uint8_t *buf, int size);
+
+/**
+ * Complete a resource and set *res to NULL.
+ */
+void ff_http_server_finish(HTTPServer *server, HTTPServerResource **res);
+
+/**
+ * Stop serving path. The transfers in progress are completed.
+ */
+int ff_http_server_delete(HTTPServer *server, const char *path);
+
+#endif /* AVFORMAT_HTTPSERVER_H */
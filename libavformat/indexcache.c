@@ -0,0 +1,401 @@
+/*
+ * On-disk cache of demuxer seek indexes
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * On-disk cache of demuxer seek indexes.
+ *
+ * A cache file holds a header identifying the input followed by one record
+ * per stream. Index entries are delta coded with variable length integers,
+ * which typically brings them down to 4-6 bytes per sample:
+ *
+ *   u32le   'FFIX'
+ *   v       version
+ *   v       key length, followed by the key itself
+ *   v       number of streams
+ *   for each stream:
+ *     v     stream index
+ *     s     aux[FF_INDEX_CACHE_AUX]
+ *     v     number of entries
+ *     v     number of extra values
+ *     for each entry:
+ *       s   pos delta
+ *       s   timestamp delta
+ *       v   size << 2 | flags
+ *       v   min_distance
+ *     s     extra value delta, for each extra value
+ *
+ * where v is an unsigned and s a zigzag coded signed variable length integer.
+ */
+
+#include <sys/stat.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/md5.h"
+
+#include "avio_internal.h"
+#include "indexcache.h"
+#include "internal.h"
+#include "os_support.h"
+#include "url.h"
+
+#define INDEX_CACHE_VERSION 2
+
+typedef struct FFIndexCacheStream {
+    int index;
+    int64_t aux[FF_INDEX_CACHE_AUX];
+    AVIndexEntry *entries;
+    int nb_entries;
+    int32_t *extra;
+    int nb_extra;
+} FFIndexCacheStream;
+
+struct FFIndexCache {
+    char *key;
+    char *path;
+    FFIndexCacheStream *streams;
+    int nb_streams;
+    /* streams added for ff_index_cache_store(), already encoded */
+    AVIOContext *dyn_buf;
+    int nb_added;
+};
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static void free_streams(FFIndexCache *c)
+{
+    int i;
+
+    for (i = 0; i < c->nb_streams; i++) {
+        av_freep(&c->streams[i].entries);
+        av_freep(&c->streams[i].extra);
+    }
+    av_freep(&c->streams);
+    c->nb_streams = 0;
+}
+
+static int read_stream(AVIOContext *pb, FFIndexCacheStream *cs)
+{
+    int64_t pos = 0, timestamp = 0;
+    int32_t extra = 0;
+    uint64_t nb_entries, nb_extra;
+    int i;
+
+    cs->index = ffio_read_varlen(pb);
+    for (i = 0; i < FF_INDEX_CACHE_AUX; i++)
+        cs->aux[i] = unzigzag(ffio_read_varlen(pb));
+    nb_entries = ffio_read_varlen(pb);
+    nb_extra   = ffio_read_varlen(pb);
+    if (pb->eof_reached || cs->index < 0 ||
+        nb_entries >= INT_MAX / sizeof(*cs->entries) ||
+        nb_extra   >= INT_MAX / sizeof(*cs->extra))
+        return AVERROR_INVALIDDATA;
+
+    if (nb_entries) {
+        cs->entries = av_malloc_array(nb_entries, sizeof(*cs->entries));
+        if (!cs->entries)
+            return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < nb_entries && !pb->eof_reached; i++) {
+        AVIndexEntry *e = &cs->entries[i];
+        uint64_t size_flags;
+
+        pos       += unzigzag(ffio_read_varlen(pb));
+        timestamp += unzigzag(ffio_read_varlen(pb));
+        size_flags = ffio_read_varlen(pb);
+        e->pos          = pos;
+        e->timestamp    = timestamp;
+        e->size         = size_flags >> 2;
+        e->flags        = size_flags & 3;
+        e->min_distance = ffio_read_varlen(pb);
+    }
+    cs->nb_entries = nb_entries;
+
+    if (nb_extra) {
+        cs->extra = av_malloc_array(nb_extra, sizeof(*cs->extra));
+        if (!cs->extra)
+            return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < nb_extra && !pb->eof_reached; i++) {
+        extra += unzigzag(ffio_read_varlen(pb));
+        cs->extra[i] = extra;
+    }
+    cs->nb_extra = nb_extra;
+
+    return pb->eof_reached ? AVERROR_INVALIDDATA : 0;
+}
+
+static int read_cache(AVFormatContext *s, FFIndexCache *c)
+{
+    AVIOContext *pb = NULL;
+    uint64_t key_len, nb_streams;
+    char *key = NULL;
+    int i, ret;
+
+    if (s->io_open(s, &pb, c->path, AVIO_FLAG_READ, NULL) < 0)
+        return 0;
+
+    ret = 0;
+    if (avio_rl32(pb) != MKTAG('F','F','I','X') ||
+        ffio_read_varlen(pb) != INDEX_CACHE_VERSION)
+        goto fail;
+
+    key_len = ffio_read_varlen(pb);
+    if (key_len != strlen(c->key))
+        goto fail;
+    key = av_malloc(key_len + 1);
+    if (!key) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if (avio_read(pb, key, key_len) != key_len)
+        goto fail;
+    key[key_len] = 0;
+    if (strcmp(key, c->key))
+        goto fail;
+
+    nb_streams = ffio_read_varlen(pb);
+    if (pb->eof_reached || nb_streams >= INT_MAX / sizeof(*c->streams))
+        goto fail;
+    c->streams = av_mallocz_array(nb_streams, sizeof(*c->streams));
+    if (!c->streams) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    c->nb_streams = nb_streams;
+    for (i = 0; i < nb_streams; i++) {
+        ret = read_stream(pb, &c->streams[i]);
+        if (ret < 0)
+            goto fail;
+    }
+
+    av_free(key);
+    ff_format_io_close(s, &pb);
+    return 1;
+
+fail:
+    if (ret != AVERROR(ENOMEM))
+        av_log(s, AV_LOG_WARNING, "Ignoring invalid index cache %s\n", c->path);
+    free_streams(c);
+    av_free(key);
+    ff_format_io_close(s, &pb);
+    return ret == AVERROR(ENOMEM) ? ret : 0;
+}
+
+int ff_index_cache_open(AVFormatContext *s, FFIndexCache **pc,
+                        const char *dir, const char *tag)
+{
+    URLContext *h = s->pb ? ffio_geturlcontext(s->pb) : NULL;
+    FFIndexCache *c;
+    struct stat st;
+    uint8_t md5[16];
+    char hex[33];
+    int fd, i, ret;
+
+    *pc = NULL;
+    if (!h || (fd = ffurl_get_file_handle(h)) < 0 || fstat(fd, &st) < 0)
+        return 0;
+
+    c = av_mallocz(sizeof(*c));
+    if (!c)
+        return AVERROR(ENOMEM);
+
+    c->key = av_asprintf("%s|%s|%"PRId64"|%"PRId64, tag, s->url,
+                         (int64_t)st.st_size, (int64_t)st.st_mtime);
+    if (!c->key) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    av_md5_sum(md5, c->key, strlen(c->key));
+    for (i = 0; i < 16; i++)
+        snprintf(hex + 2 * i, 3, "%02x", md5[i]);
+    c->path = av_asprintf("%s/%s.idx", dir, hex);
+    if (!c->path) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ret = read_cache(s, c);
+    if (ret < 0)
+        goto fail;
+    av_log(s, AV_LOG_DEBUG, "Index cache %s: %s\n",
+           c->path, ret ? "hit" : "miss");
+
+    *pc = c;
+    return ret;
+fail:
+    ff_index_cache_free(&c);
+    return ret;
+}
+
+static FFIndexCacheStream *find_stream(FFIndexCache *c, int stream_index)
+{
+    int i;
+
+    for (i = 0; i < c->nb_streams; i++)
+        if (c->streams[i].index == stream_index)
+            return &c->streams[i];
+    return NULL;
+}
+
+int ff_index_cache_find(FFIndexCache *c, int stream_index,
+                        int64_t aux[FF_INDEX_CACHE_AUX])
+{
+    FFIndexCacheStream *cs = find_stream(c, stream_index);
+
+    if (!cs)
+        return 0;
+    if (aux)
+        memcpy(aux, cs->aux, sizeof(cs->aux));
+    return 1;
+}
+
+int ff_index_cache_take(FFIndexCache *c, int stream_index,
+                        AVIndexEntry **entries, int *nb_entries,
+                        int32_t **extra, int *nb_extra)
+{
+    FFIndexCacheStream *cs = find_stream(c, stream_index);
+
+    if (!cs)
+        return AVERROR(ENOENT);
+
+    *entries    = cs->entries;
+    *nb_entries = cs->nb_entries;
+    cs->entries    = NULL;
+    cs->nb_entries = 0;
+    if (extra) {
+        *extra    = cs->extra;
+        *nb_extra = cs->nb_extra;
+        cs->extra    = NULL;
+        cs->nb_extra = 0;
+    }
+    return 0;
+}
+
+int ff_index_cache_add(FFIndexCache *c, int stream_index,
+                       const AVIndexEntry *entries, int nb_entries,
+                       const int32_t *extra, int nb_extra,
+                       const int64_t aux[FF_INDEX_CACHE_AUX])
+{
+    AVIOContext *pb;
+    int64_t pos = 0, timestamp = 0;
+    int32_t prev = 0;
+    int i, ret;
+
+    if (!c->dyn_buf && (ret = avio_open_dyn_buf(&c->dyn_buf)) < 0)
+        return ret;
+    pb = c->dyn_buf;
+
+    ff_put_v(pb, stream_index);
+    for (i = 0; i < FF_INDEX_CACHE_AUX; i++)
+        ff_put_v(pb, zigzag(aux ? aux[i] : 0));
+    ff_put_v(pb, nb_entries);
+    ff_put_v(pb, extra ? nb_extra : 0);
+    for (i = 0; i < nb_entries; i++) {
+        const AVIndexEntry *e = &entries[i];
+
+        ff_put_v(pb, zigzag(e->pos - pos));
+        ff_put_v(pb, zigzag(e->timestamp - timestamp));
+        ff_put_v(pb, (uint64_t)e->size << 2 | (e->flags & 3));
+        ff_put_v(pb, e->min_distance);
+        pos       = e->pos;
+        timestamp = e->timestamp;
+    }
+    for (i = 0; extra && i < nb_extra; i++) {
+        ff_put_v(pb, zigzag((int64_t)extra[i] - prev));
+        prev = extra[i];
+    }
+    c->nb_added++;
+
+    return 0;
+}
+
+int ff_index_cache_store(AVFormatContext *s, FFIndexCache *c)
+{
+    AVIOContext *pb = NULL;
+    uint8_t *buf = NULL;
+    char *tmp;
+    int size, ret;
+
+    if (!c->dyn_buf)
+        return 0;
+
+    tmp = av_asprintf("%s.tmp", c->path);
+    if (!tmp)
+        return AVERROR(ENOMEM);
+
+    ret = s->io_open(s, &pb, tmp, AVIO_FLAG_WRITE, NULL);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Could not open index cache %s\n", tmp);
+        goto end;
+    }
+
+    avio_wl32(pb, MKTAG('F','F','I','X'));
+    ff_put_v(pb, INDEX_CACHE_VERSION);
+    ff_put_v(pb, strlen(c->key));
+    avio_write(pb, c->key, strlen(c->key));
+    ff_put_v(pb, c->nb_added);
+    size = avio_close_dyn_buf(c->dyn_buf, &buf);
+    c->dyn_buf = NULL;
+    avio_write(pb, buf, size);
+    av_free(buf);
+    avio_flush(pb);
+    ret = pb->error;
+    ff_format_io_close(s, &pb);
+
+    if (ret >= 0)
+        ret = ff_rename(tmp, c->path, s);
+    if (ret < 0)
+        av_log(s, AV_LOG_WARNING, "Could not write index cache %s\n", c->path);
+end:
+    av_free(tmp);
+    return ret;
+}
+
+int ff_index_cache_remove(AVFormatContext *s, FFIndexCache *c)
+{
+    int ret = avpriv_io_delete(c->path);
+
+    if (ret < 0 && ret != AVERROR(ENOENT))
+        av_log(s, AV_LOG_WARNING, "Could not remove index cache %s\n", c->path);
+    return ret;
+}
+
+void ff_index_cache_free(FFIndexCache **pc)
+{
+    FFIndexCache *c = *pc;
+
+    if (!c)
+        return;
+    free_streams(c);
+    ffio_free_dyn_buf(&c->dyn_buf);
+    av_freep(&c->key);
+    av_freep(&c->path);
+    av_freep(pc);
+}
@@ -0,0 +1,100 @@
+/*
+ * On-disk cache of demuxer seek indexes
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_INDEXCACHE_H
+#define AVFORMAT_INDEXCACHE_H
+
+#include <stdint.h>
+
+#include "avformat.h"
+
+/**
+ * Number of demuxer specific values stored along with each stream.
+ */
+#define FF_INDEX_CACHE_AUX 6
+
+typedef struct FFIndexCache FFIndexCache;
+
+/**
+ * Look up the cached index of the local file s->pb is reading from.
+ *
+ * The cache file is named after a hash of tag, s->url and the size and
+ * modification time of the input, so it is ignored as soon as the file
+ * changes.
+ *
+ * @param pc  set to the cache on success, or to NULL if the input is not
+ *            a local file and can thus not be cached
+ * @param dir directory holding the cache files
+ * @param tag string identifying the demuxer and every option that
+ *            changes the index it builds
+ * @return 1 if a cached index was found, 0 if not (entries may then be
+ *         added with ff_index_cache_add() and written with
+ *         ff_index_cache_store()), a negative AVERROR code on failure
+ */
+int ff_index_cache_open(AVFormatContext *s, FFIndexCache **pc,
+                        const char *dir, const char *tag);
+
+/**
+ * Check whether the cache holds an index for the given stream.
+ *
+ * @param aux if not NULL, filled with the values passed to
+ *            ff_index_cache_add() for this stream
+ * @return 1 if it does, 0 otherwise
+ */
+int ff_index_cache_find(FFIndexCache *c, int stream_index,
+                        int64_t aux[FF_INDEX_CACHE_AUX]);
+
+/**
+ * Hand the cached index of a stream over to the caller, who becomes
+ * responsible for freeing the returned arrays.
+ *
+ * @param extra    if not NULL, set to the per sample values passed to
+ *                 ff_index_cache_add(), or NULL if there were none
+ * @param nb_extra number of elements in *extra
+ * @return 0 on success, AVERROR(ENOENT) if the stream is not in the cache
+ */
+int ff_index_cache_take(FFIndexCache *c, int stream_index,
+                        AVIndexEntry **entries, int *nb_entries,
+                        int32_t **extra, int *nb_extra);
+
+/**
+ * Add the index of a stream to a cache that is going to be stored.
+ *
+ * @param extra    optional demuxer specific per sample values
+ * @param aux      optional demuxer specific per stream values
+ */
+int ff_index_cache_add(FFIndexCache *c, int stream_index,
+                       const AVIndexEntry *entries, int nb_entries,
+                       const int32_t *extra, int nb_extra,
+                       const int64_t aux[FF_INDEX_CACHE_AUX]);
+
+/**
+ * Write the streams added with ff_index_cache_add() to the cache directory.
+ */
+int ff_index_cache_store(AVFormatContext *s, FFIndexCache *c);
+
+/**
+ * Delete the cache file, e.g. because it turned out to not match the input.
+ */
+int ff_index_cache_remove(AVFormatContext *s, FFIndexCache *c);
+
+void ff_index_cache_free(FFIndexCache **pc);
+
+#endif /* AVFORMAT_INDEXCACHE_H */
@@ -709,6 +709,13 @@ int ff_reshuffle_raw_rgb(AVFormatContext *s, AVPacket **ppkt, AVCodecParameters
  */
 int ff_get_packet_palette(AVFormatContext *s, AVPacket *pkt, int ret, uint32_t *palette);
 
+/**
+ * Like av_get_packet(), but large packets are read from the protocol
+ * straight into the packet buffer instead of through the AVIOContext
+ * buffer, saving a copy of the data.
+ */
+int ff_get_packet_direct(AVIOContext *s, AVPacket *pkt, int size);
+
 /**
  * Finalize buf into extradata and set its size appropriately.
  */
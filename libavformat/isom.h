@@ -35,6 +35,7 @@
 #include "avio.h"
 #include "internal.h"
 #include "dv.h"
+#include "indexcache.h"
 
 /* isom.c */
 extern const AVCodecTag ff_mp4_obj_type[];
@@ -179,6 +180,7 @@ typedef struct MOVStreamContext {
     unsigned int elst_count;
     int ctts_index;
     int ctts_sample;
+    int ctts_in_sync;     ///< ctts_data describes exactly the index samples, see mov_read_trun()
     unsigned int sample_size; ///< may contain value calculated from stsd or value from stsz atom
     unsigned int stsz_sample_size; ///< always contains sample size from stsz atom
     unsigned int sample_count;
@@ -241,6 +243,11 @@ typedef struct MOVStreamContext {
         AVEncryptionInfo *default_encrypted_sample;
         MOVEncryptionIndex *encryption_index;
     } cenc;
+
+    int index_cached;     ///< index is loaded from MOVContext.index_cache instead of the sample tables
+    int64_t index_cache_aux[FF_INDEX_CACHE_AUX];
+    MOVAtom index_cache_skipped[2]; ///< stsz and stco atoms skipped because of the index cache
+    int64_t index_cache_skipped_pos[2];
 } MOVStreamContext;
 
 typedef struct MOVContext {
@@ -291,6 +298,11 @@ typedef struct MOVContext {
     int decryption_key_len;
     int enable_drefs;
     int32_t movie_display_matrix[3][3]; ///< display matrix from mvhd
+    char *index_cache_dir;
+    int index_cache_write;
+    FFIndexCache *index_cache;
+    int index_cache_hit;
+    int index_cache_stale;
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
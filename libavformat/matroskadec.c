@@ -51,6 +51,7 @@
 
 #include "avformat.h"
 #include "avio_internal.h"
+#include "indexcache.h"
 #include "internal.h"
 #include "isom.h"
 #include "matroska.h"
@@ -386,6 +387,10 @@ typedef struct MatroskaDemuxContext {
 
     /* Bandwidth value for WebM DASH Manifest */
     int bandwidth;
+
+    /* Directory to cache the parsed CUES of local files in */
+    char *index_cache_dir;
+    int index_cache_write;
 } MatroskaDemuxContext;
 
 #define CHILD_OF(parent) { .def = { .n = parent } }
@@ -1009,7 +1014,12 @@ static int ebml_read_binary(AVIOContext *pb, int length,
     bin->data = bin->buf->data;
     bin->size = length;
     bin->pos  = pos;
-    if ((ret = avio_read(pb, bin->data, length)) != length) {
+    /* Read large blocks straight into their buffer */
+    if (length >= pb->buffer_size)
+        ret = ffio_read_direct(pb, bin->data, length);
+    else
+        ret = avio_read(pb, bin->data, length);
+    if (ret != length) {
         av_buffer_unref(&bin->buf);
         bin->data = NULL;
         bin->size = 0;
@@ -1938,6 +1948,49 @@ static void matroska_parse_cues(MatroskaDemuxContext *matroska) {
     matroska_add_index_entries(matroska);
 }
 
+/* Parse the CUES, or take the index they produced from the index cache. */
+static void matroska_load_cues(MatroskaDemuxContext *matroska)
+{
+    AVFormatContext *s = matroska->ctx;
+    FFIndexCache *cache = NULL;
+    int i, j, ret;
+
+    if (!matroska->index_cache_dir || (s->flags & AVFMT_FLAG_IGNIDX) ||
+        (ret = ff_index_cache_open(s, &cache, matroska->index_cache_dir,
+                                   "matroska")) < 0 || !cache) {
+        matroska_parse_cues(matroska);
+        return;
+    }
+
+    if (ret) {
+        for (i = 0; i < s->nb_streams; i++) {
+            AVStream *st = s->streams[i];
+            AVIndexEntry *entries;
+            int nb_entries;
+
+            if (ff_index_cache_take(cache, i, &entries, &nb_entries, NULL, NULL) < 0)
+                continue;
+            for (j = 0; j < nb_entries; j++)
+                av_add_index_entry(st, entries[j].pos, entries[j].timestamp,
+                                   entries[j].size, entries[j].min_distance,
+                                   entries[j].flags);
+            av_free(entries);
+        }
+    } else {
+        matroska_parse_cues(matroska);
+        if (matroska->index_cache_write && matroska->cues_parsing_deferred >= 0) {
+            for (i = 0; i < s->nb_streams && ret >= 0; i++)
+                ret = ff_index_cache_add(cache, i, s->streams[i]->index_entries,
+                                         s->streams[i]->nb_index_entries,
+                                         NULL, 0, NULL);
+            if (ret >= 0)
+                ff_index_cache_store(s, cache);
+        }
+    }
+
+    ff_index_cache_free(&cache);
+}
+
 static int matroska_aac_profile(char *codec_id)
 {
     static const char *const aac_profiles[] = { "MAIN", "LC", "SSR" };
@@ -3738,7 +3791,7 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     /* Parse the CUES now since we need the index data to seek. */
     if (matroska->cues_parsing_deferred > 0) {
         matroska->cues_parsing_deferred = 0;
-        matroska_parse_cues(matroska);
+        matroska_load_cues(matroska);
     }
 
     if (!st->nb_index_entries)
@@ -4207,6 +4260,19 @@ static const AVOption options[] = {
     { NULL },
 };
 
+static const AVOption matroska_options[] = {
+    { "index_cache", "Directory to cache the seek index of local files in", OFFSET(index_cache_dir), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
+    { "index_cache_write", "Write missing index cache files", OFFSET(index_cache_write), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 static const AVClass webm_dash_class = {
     .class_name = "WebM DASH Manifest demuxer",
     .item_name  = av_default_item_name,
@@ -4224,7 +4290,8 @@ AVInputFormat ff_matroska_demuxer = {
     .read_packet    = matroska_read_packet,
     .read_close     = matroska_read_close,
     .read_seek      = matroska_read_seek,
-    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska"
+    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska",
+    .priv_class     = &matroska_class,
 };
 
 AVInputFormat ff_webm_dash_manifest_demuxer = {
@@ -60,6 +60,7 @@
 #include "id3v1.h"
 #include "mov_chan.h"
 #include "replaygain.h"
+#include "indexcache.h"
 
 #if CONFIG_ZLIB
 #include <zlib.h>
@@ -1986,11 +1987,59 @@ static int mov_read_strf(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     return 0;
 }
 
+/* Per stream values stored along with the index in the index cache */
+enum MOVIndexCacheAux {
+    MOV_INDEX_CACHE_SAMPLE_COUNT,
+    MOV_INDEX_CACHE_CHUNK_COUNT,
+    MOV_INDEX_CACHE_DATA_SIZE,
+    MOV_INDEX_CACHE_STREAM_SIZE,
+    MOV_INDEX_CACHE_STSZ_SAMPLE_SIZE,
+    MOV_INDEX_CACHE_WALKED_SAMPLES,
+};
+
+static int mov_read_stco(MOVContext *c, AVIOContext *pb, MOVAtom atom);
+static int mov_read_stsz(MOVContext *c, AVIOContext *pb, MOVAtom atom);
+
+/**
+ * Stop using the index cache when it does not match the sample tables of
+ * the current track, and read back the tables skipped so far because of it.
+ * The following tracks are parsed normally as well.
+ */
+static int mov_discard_cached_index(MOVContext *c, AVIOContext *pb, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int64_t pos = avio_tell(pb);
+    int i, ret = 0;
+
+    av_log(c->fc, AV_LOG_WARNING, "stream %d, index cache does not match "
+           "the sample tables, ignoring it\n", st->index);
+    sc->index_cached = 0;
+    c->index_cache_hit = 0;
+    c->index_cache_stale = 1;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(sc->index_cache_skipped) && ret >= 0; i++) {
+        MOVAtom atom = sc->index_cache_skipped[i];
+
+        if (!atom.type)
+            continue;
+        sc->index_cache_skipped[i].type = 0;
+        if (avio_seek(pb, sc->index_cache_skipped_pos[i], SEEK_SET) < 0)
+            return AVERROR_INVALIDDATA;
+        ret = i ? mov_read_stco(c, pb, atom) : mov_read_stsz(c, pb, atom);
+    }
+    if (avio_seek(pb, pos, SEEK_SET) < 0)
+        return AVERROR_INVALIDDATA;
+
+    return ret;
+}
+
 static int mov_read_stco(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 {
     AVStream *st;
     MOVStreamContext *sc;
     unsigned int i, entries;
+    int64_t pos;
+    int ret;
 
     if (c->trak_index < 0) {
         av_log(c->fc, AV_LOG_WARNING, "STCO outside TRAK\n");
@@ -2000,15 +2049,28 @@ static int mov_read_stco(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         return 0;
     st = c->fc->streams[c->fc->nb_streams-1];
     sc = st->priv_data;
+    pos = avio_tell(pb);
 
     avio_r8(pb); /* version */
     avio_rb24(pb); /* flags */
 
     entries = avio_rb32(pb);
 
+    if (sc->index_cached &&
+        entries != sc->index_cache_aux[MOV_INDEX_CACHE_CHUNK_COUNT] &&
+        (ret = mov_discard_cached_index(c, pb, st)) < 0)
+        return ret;
+
     if (!entries)
         return 0;
 
+    if (sc->index_cached) {
+        sc->index_cache_skipped[1]     = atom;
+        sc->index_cache_skipped_pos[1] = pos;
+        sc->chunk_count = entries;
+        return 0;
+    }
+
     if (sc->chunk_offsets)
         av_log(c->fc, AV_LOG_WARNING, "Duplicated STCO atom\n");
     av_free(sc->chunk_offsets);
@@ -2819,12 +2881,14 @@ static int mov_read_stsz(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     unsigned int i, entries, sample_size, field_size, num_bytes;
     GetBitContext gb;
     unsigned char* buf;
+    int64_t pos;
     int ret;
 
     if (c->fc->nb_streams < 1)
         return 0;
     st = c->fc->streams[c->fc->nb_streams-1];
     sc = st->priv_data;
+    pos = avio_tell(pb);
 
     avio_r8(pb); /* version */
     avio_rb24(pb); /* flags */
@@ -2844,6 +2908,11 @@ static int mov_read_stsz(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 
     av_log(c->fc, AV_LOG_TRACE, "sample_size = %u sample_count = %u\n", sc->sample_size, entries);
 
+    if (sc->index_cached &&
+        entries != sc->index_cache_aux[MOV_INDEX_CACHE_SAMPLE_COUNT] &&
+        (ret = mov_discard_cached_index(c, pb, st)) < 0)
+        return ret;
+
     sc->sample_count = entries;
     if (sample_size)
         return 0;
@@ -2855,6 +2924,12 @@ static int mov_read_stsz(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 
     if (!entries)
         return 0;
+    if (sc->index_cached) {
+        sc->index_cache_skipped[0]     = atom;
+        sc->index_cache_skipped_pos[0] = pos;
+        sc->data_size = sc->index_cache_aux[MOV_INDEX_CACHE_DATA_SIZE];
+        return 0;
+    }
     if (entries >= (UINT_MAX - 4) / field_size)
         return AVERROR_INVALIDDATA;
     if (sc->sample_sizes)
@@ -3513,9 +3588,11 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     msc->current_index_range = msc->index_ranges;
     current_index_range = msc->index_ranges - 1;
 
-    // Clean AVStream from traces of old index
-    st->index_entries = NULL;
-    st->index_entries_allocated_size = 0;
+    // Clean AVStream from traces of old index. A single edit keeps at most
+    // all the old entries, so reserve that much instead of growing the new
+    // index geometrically while the old one is still around.
+    st->index_entries = av_malloc_array(nb_old, sizeof(*st->index_entries));
+    st->index_entries_allocated_size = st->index_entries ? nb_old * sizeof(*st->index_entries) : 0;
     st->nb_index_entries = 0;
 
     // Clean ctts fields of MOVStreamContext
@@ -3769,6 +3846,220 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     msc->current_index = msc->index_ranges[0].start;
 }
 
+/* only use old uncompressed audio chunk demuxing when stts specifies it */
+static int mov_has_chunk_index(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    return st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+           sc->stts_count == 1 && sc->stts_data[0].duration == 1;
+}
+
+/**
+ * Drop the ctts entries describing more than sample_count samples.
+ * The entries are kept run-length coded, see mov_expand_ctts().
+ */
+static void mov_truncate_ctts(MOVStreamContext *sc, unsigned int sample_count)
+{
+    unsigned int i;
+
+    for (i = 0; i < sc->ctts_count && sample_count; i++) {
+        if (sc->ctts_data[i].count > sample_count)
+            sc->ctts_data[i].count = sample_count;
+        sample_count -= sc->ctts_data[i].count;
+    }
+    sc->ctts_count = i;
+}
+
+/**
+ * Expand run-length coded ctts entries to a 1-1 mapping with samples.
+ * This is only needed once samples have to be inserted in the middle of the
+ * index, so it is done lazily by mov_read_trun().
+ */
+static int mov_expand_ctts(MOVStreamContext *sc)
+{
+    MOVStts *ctts_data = NULL;
+    unsigned int ctts_count = 0, allocated_size = 0;
+    uint64_t nb_samples = 0;
+    int64_t ctts_index = -1;
+    unsigned int i, j;
+    int expand = 0;
+
+    for (i = 0; i < sc->ctts_count; i++) {
+        if (i == sc->ctts_index)
+            ctts_index = nb_samples + sc->ctts_sample;
+        nb_samples += sc->ctts_data[i].count;
+        expand |= sc->ctts_data[i].count > 1;
+    }
+    if (!expand)
+        return 0;
+    if (nb_samples >= UINT_MAX / sizeof(*ctts_data))
+        return AVERROR_INVALIDDATA;
+
+    ctts_data = av_fast_realloc(NULL, &allocated_size, nb_samples * sizeof(*ctts_data));
+    if (!ctts_data)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < sc->ctts_count; i++)
+        for (j = 0; j < sc->ctts_data[i].count; j++)
+            add_ctts_entry(&ctts_data, &ctts_count, &allocated_size, 1,
+                           sc->ctts_data[i].duration);
+
+    av_free(sc->ctts_data);
+    sc->ctts_data = ctts_data;
+    sc->ctts_count = ctts_count;
+    sc->ctts_allocated_size = allocated_size;
+    sc->ctts_index = ctts_index >= 0 ? ctts_index : ctts_count;
+    sc->ctts_sample = 0;
+
+    return 0;
+}
+
+/**
+ * Make the run-length coded ctts entries describe exactly nb_samples
+ * samples, so that fragment samples can be appended to them. Samples
+ * without a ctts entry get a zero offset.
+ */
+static int mov_sync_ctts(MOVStreamContext *sc, unsigned int nb_samples)
+{
+    uint64_t count = 0;
+    unsigned int i;
+
+    for (i = 0; i < sc->ctts_count; i++)
+        count += sc->ctts_data[i].count;
+    if (count > nb_samples)
+        mov_truncate_ctts(sc, nb_samples);
+    else if (count < nb_samples &&
+             add_ctts_entry(&sc->ctts_data, &sc->ctts_count, &sc->ctts_allocated_size,
+                            nb_samples - count, 0) < 0)
+        return AVERROR(ENOMEM);
+    sc->ctts_in_sync = 1;
+
+    return 0;
+}
+
+/**
+ * Release the unused space mov_fix_index() and add_ctts_entry() leave at the
+ * end of the arrays they grow, which is up to half of them for long tracks.
+ */
+static void mov_shrink_index(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    size_t size;
+
+    size = st->nb_index_entries * sizeof(*st->index_entries);
+    if (size && size < st->index_entries_allocated_size) {
+        AVIndexEntry *entries = av_realloc(st->index_entries, size);
+        if (entries) {
+            st->index_entries = entries;
+            st->index_entries_allocated_size = size;
+        }
+    }
+
+    size = sc->ctts_count * sizeof(*sc->ctts_data);
+    if (size && size < sc->ctts_allocated_size) {
+        MOVStts *ctts_data = av_realloc(sc->ctts_data, size);
+        if (ctts_data) {
+            sc->ctts_data = ctts_data;
+            sc->ctts_allocated_size = size;
+        }
+    }
+}
+
+/**
+ * Apply the fixups the sample table walk of mov_build_index() makes to
+ * the stts and stsz data to a track whose index comes from the index cache,
+ * so that timestamps and sizes derived from them match a regular open.
+ */
+static void mov_fix_cached_tables(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int64_t nb_samples = sc->index_cache_aux[MOV_INDEX_CACHE_WALKED_SAMPLES];
+    int64_t sample = 0;
+    unsigned int stts_index = 0;
+
+    if (sc->stsz_sample_size != sc->index_cache_aux[MOV_INDEX_CACHE_STSZ_SAMPLE_SIZE]) {
+        av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid, ignoring\n",
+               sc->stsz_sample_size);
+        sc->stsz_sample_size = sc->index_cache_aux[MOV_INDEX_CACHE_STSZ_SAMPLE_SIZE];
+    }
+
+    /* Same walk through the stts entries as in mov_build_index() */
+    while (sample < nb_samples && stts_index < sc->stts_count) {
+        if (sc->stts_data[stts_index].duration < 0) {
+            av_log(mov->fc, AV_LOG_WARNING,
+                   "Invalid SampleDelta %d in STTS, at %d st:%d\n",
+                   sc->stts_data[stts_index].duration, stts_index,
+                   st->index);
+            sc->stts_data[stts_index].duration = 1;
+        }
+        if (stts_index + 1 == sc->stts_count || !sc->stts_data[stts_index].count)
+            break;
+        sample += sc->stts_data[stts_index].count;
+        stts_index++;
+    }
+}
+
+/**
+ * Take the index built by a previous mov_build_index() call from the index
+ * cache instead of walking the sample tables, which were not kept in memory.
+ */
+static int mov_load_cached_index(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    AVIndexEntry *entries;
+    int i, nb_entries;
+    int ret;
+
+    /* Same conditions as for building the index from the sample tables */
+    if (mov_has_chunk_index(st) ? !sc->chunk_count :
+        !sc->sample_count || st->nb_index_entries)
+        return 0;
+
+    ret = ff_index_cache_take(mov->index_cache, st->index, &entries, &nb_entries,
+                              NULL, NULL);
+    if (ret < 0)
+        return ret;
+
+    av_freep(&st->index_entries);
+    st->index_entries = entries;
+    st->nb_index_entries = nb_entries;
+    st->index_entries_allocated_size = nb_entries * sizeof(*entries);
+
+    if (!mov_has_chunk_index(st)) {
+        mov_truncate_ctts(sc, sc->sample_count);
+        mov_fix_cached_tables(mov, st);
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+            for (i = 0; i < FFMIN(nb_entries, 99); i++)
+                ff_rfps_add_frame(mov->fc, st, entries[i].timestamp);
+        if (st->duration > 0)
+            st->codecpar->bit_rate = sc->index_cache_aux[MOV_INDEX_CACHE_STREAM_SIZE]*8*sc->time_scale/st->duration;
+    }
+
+    return 0;
+}
+
+static void mov_add_cached_index(MOVContext *mov, AVStream *st,
+                                 uint64_t stream_size, unsigned int nb_samples)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int64_t aux[FF_INDEX_CACHE_AUX] = {
+        [MOV_INDEX_CACHE_SAMPLE_COUNT]     = sc->sample_count,
+        [MOV_INDEX_CACHE_CHUNK_COUNT]      = sc->chunk_count,
+        [MOV_INDEX_CACHE_DATA_SIZE]        = sc->data_size,
+        [MOV_INDEX_CACHE_STREAM_SIZE]      = stream_size,
+        [MOV_INDEX_CACHE_STSZ_SAMPLE_SIZE] = sc->stsz_sample_size,
+        [MOV_INDEX_CACHE_WALKED_SAMPLES]   = nb_samples,
+    };
+
+    if (!mov->index_cache || !mov->index_cache_write ||
+        mov->index_cache_hit || mov->index_cache_stale)
+        return;
+
+    ff_index_cache_add(mov->index_cache, st->index,
+                       st->index_entries, st->nb_index_entries,
+                       NULL, 0, aux);
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -3780,8 +4071,6 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     unsigned int stps_index = 0;
     unsigned int i, j;
     uint64_t stream_size = 0;
-    MOVStts *ctts_data_old = sc->ctts_data;
-    unsigned int ctts_count_old = sc->ctts_count;
 
     if (sc->elst_count) {
         int i, edit_start_index = 0, multiple_edits = 0;
@@ -3822,9 +4111,10 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             sc->start_pad = start_time;
     }
 
-    /* only use old uncompressed audio chunk demuxing when stts specifies it */
-    if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
-          sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
+    if (sc->index_cached) {
+        if (mov_load_cached_index(mov, st) < 0)
+            return;
+    } else if (!mov_has_chunk_index(st)) {
         unsigned int current_sample = 0;
         unsigned int stts_sample = 0;
         unsigned int sample_size;
@@ -3851,30 +4141,7 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         }
         st->index_entries_allocated_size = (st->nb_index_entries + sc->sample_count) * sizeof(*st->index_entries);
 
-        if (ctts_data_old) {
-            // Expand ctts entries such that we have a 1-1 mapping with samples
-            if (sc->sample_count >= UINT_MAX / sizeof(*sc->ctts_data))
-                return;
-            sc->ctts_count = 0;
-            sc->ctts_allocated_size = 0;
-            sc->ctts_data = av_fast_realloc(NULL, &sc->ctts_allocated_size,
-                                    sc->sample_count * sizeof(*sc->ctts_data));
-            if (!sc->ctts_data) {
-                av_free(ctts_data_old);
-                return;
-            }
-
-            memset((uint8_t*)(sc->ctts_data), 0, sc->ctts_allocated_size);
-
-            for (i = 0; i < ctts_count_old &&
-                        sc->ctts_count < sc->sample_count; i++)
-                for (j = 0; j < ctts_data_old[i].count &&
-                            sc->ctts_count < sc->sample_count; j++)
-                    add_ctts_entry(&sc->ctts_data, &sc->ctts_count,
-                                   &sc->ctts_allocated_size, 1,
-                                   ctts_data_old[i].duration);
-            av_free(ctts_data_old);
-        }
+        mov_truncate_ctts(sc, sc->sample_count);
 
         for (i = 0; i < sc->chunk_count; i++) {
             int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
@@ -3977,6 +4244,7 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                 }
             }
         }
+        mov_add_cached_index(mov, st, stream_size, current_sample);
         if (st->duration > 0)
             st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
     } else {
@@ -4079,6 +4347,7 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                 chunk_samples -= samples;
             }
         }
+        mov_add_cached_index(mov, st, 0, 0);
     }
 
     if (!mov->ignore_editlist && mov->advanced_editlist) {
@@ -4086,6 +4355,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         mov_fix_index(mov, st);
     }
 
+    mov_shrink_index(st);
+
     // Update start time of the stream.
     if (st->start_time == AV_NOPTS_VALUE && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->nb_index_entries > 0) {
         st->start_time = st->index_entries[0].timestamp + sc->dts_shift;
@@ -4224,6 +4495,9 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     st->codecpar->codec_type = AVMEDIA_TYPE_DATA;
     sc->ffindex = st->index;
     c->trak_index = st->index;
+    if (c->index_cache_hit)
+        sc->index_cached = ff_index_cache_find(c->index_cache, st->index,
+                                               sc->index_cache_aux);
 
     if ((ret = mov_read_default(c, pb, atom)) < 0)
         return ret;
@@ -4754,7 +5028,7 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     int64_t prev_dts = AV_NOPTS_VALUE;
     int next_frag_index = -1, index_entry_pos;
     size_t requested_size;
-    size_t old_ctts_allocated_size;
+    int insert, ret;
     AVIndexEntry *new_entries;
     MOVFragmentStreamInfo * frag_stream_info;
 
@@ -4859,21 +5133,26 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         return AVERROR(ENOMEM);
     st->index_entries= new_entries;
 
-    requested_size = (st->nb_index_entries + entries) * sizeof(*sc->ctts_data);
-    old_ctts_allocated_size = sc->ctts_allocated_size;
+    // Samples without ctts entries get zero valued ones. This ensures clips
+    // which mix boxes with and without ctts entries don't pickup
+    // uninitialized data. Only the first fragment of a track needs this,
+    // the following ones keep the entries in sync with the index.
+    if (!sc->ctts_in_sync && (ret = mov_sync_ctts(sc, st->nb_index_entries)) < 0)
+        return ret;
+
+    // Appended samples extend the run-length coded ctts entries, samples
+    // inserted before those of a later fragment need a 1-1 mapping.
+    insert = index_entry_pos < st->nb_index_entries;
+    if (insert && (ret = mov_expand_ctts(sc)) < 0)
+        return ret;
+    requested_size = (sc->ctts_count + entries) * sizeof(*sc->ctts_data);
     ctts_data = av_fast_realloc(sc->ctts_data, &sc->ctts_allocated_size,
                                 requested_size);
     if (!ctts_data)
         return AVERROR(ENOMEM);
     sc->ctts_data = ctts_data;
 
-    // In case there were samples without ctts entries, ensure they get
-    // zero valued entries. This ensures clips which mix boxes with and
-    // without ctts entries don't pickup uninitialized data.
-    memset((uint8_t*)(sc->ctts_data) + old_ctts_allocated_size, 0,
-           sc->ctts_allocated_size - old_ctts_allocated_size);
-
-    if (index_entry_pos < st->nb_index_entries) {
+    if (insert) {
         // Make hole in index_entries and ctts_data for new samples
         memmove(st->index_entries + index_entry_pos + entries,
                 st->index_entries + index_entry_pos,
@@ -4888,7 +5167,8 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     }
 
     st->nb_index_entries += entries;
-    sc->ctts_count = st->nb_index_entries;
+    if (insert)
+        sc->ctts_count = st->nb_index_entries;
 
     // Record the index_entry position in frag_index of this fragment
     if (frag_stream_info)
@@ -4950,8 +5230,18 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         st->index_entries[index_entry_pos].min_distance= distance;
         st->index_entries[index_entry_pos].flags = index_entry_flags;
 
-        sc->ctts_data[index_entry_pos].count = 1;
-        sc->ctts_data[index_entry_pos].duration = ctts_duration;
+        if (insert) {
+            sc->ctts_data[index_entry_pos].count = 1;
+            sc->ctts_data[index_entry_pos].duration = ctts_duration;
+        } else if (sc->ctts_index < sc->ctts_count &&
+                   sc->ctts_data[sc->ctts_count - 1].duration == ctts_duration) {
+            // packet reading has not moved past the last entry yet
+            sc->ctts_data[sc->ctts_count - 1].count++;
+        } else {
+            // cannot fail, room was reserved above
+            add_ctts_entry(&sc->ctts_data, &sc->ctts_count,
+                           &sc->ctts_allocated_size, 1, ctts_duration);
+        }
         index_entry_pos++;
 
         av_log(c->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %d, offset %"PRIx64", dts %"PRId64", "
@@ -4979,13 +5269,15 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
                 st->index_entries + index_entry_pos + gap,
                 sizeof(*st->index_entries) *
                 (st->nb_index_entries - (index_entry_pos + gap)));
-        memmove(sc->ctts_data + index_entry_pos,
-                sc->ctts_data + index_entry_pos + gap,
-                sizeof(*sc->ctts_data) *
-                (sc->ctts_count - (index_entry_pos + gap)));
+        if (insert) {
+            memmove(sc->ctts_data + index_entry_pos,
+                    sc->ctts_data + index_entry_pos + gap,
+                    sizeof(*sc->ctts_data) *
+                    (sc->ctts_count - (index_entry_pos + gap)));
+            sc->ctts_count -= gap;
+        }
 
         st->nb_index_entries -= gap;
-        sc->ctts_count -= gap;
         if (index_entry_pos < sc->current_sample) {
             sc->current_sample -= gap;
         }
@@ -7408,6 +7700,7 @@ static int mov_read_close(AVFormatContext *s)
 
     av_freep(&mov->aes_decrypt);
     av_freep(&mov->chapter_tracks);
+    ff_index_cache_free(&mov->index_cache);
 
     return 0;
 }
@@ -7568,6 +7861,15 @@ static int mov_read_header(AVFormatContext *s)
     else
         atom.size = INT64_MAX;
 
+    if (mov->index_cache_dir && (pb->seekable & AVIO_SEEKABLE_NORMAL)) {
+        char tag[32];
+        snprintf(tag, sizeof(tag), "mov:%d", mov->advanced_editlist);
+        err = ff_index_cache_open(s, &mov->index_cache, mov->index_cache_dir, tag);
+        if (err < 0)
+            return err;
+        mov->index_cache_hit = err;
+    }
+
     /* check MOV header */
     do {
         if (mov->moov_retry)
@@ -7585,6 +7887,17 @@ static int mov_read_header(AVFormatContext *s)
     }
     av_log(mov->fc, AV_LOG_TRACE, "on_parse_exit_offset=%"PRId64"\n", avio_tell(pb));
 
+    if (mov->index_cache && mov->index_cache_write) {
+        /* Remove a stale cache file, the next open writes a new one */
+        if (mov->index_cache_stale)
+            ff_index_cache_remove(s, mov->index_cache);
+        /* fragmented files extend the index while playing, do not cache those */
+        else if (!mov->index_cache_hit && !mov->frag_index.nb_items)
+            ff_index_cache_store(s, mov->index_cache);
+    }
+    ff_index_cache_free(&mov->index_cache);
+    mov->index_cache_hit = 0;
+
     if (pb->seekable & AVIO_SEEKABLE_NORMAL) {
         if (mov->nb_chapter_tracks > 0 && !mov->ignore_chapters)
             mov_read_chapters(s);
@@ -7892,7 +8205,7 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             goto retry;
         }
 
-        ret = av_get_packet(sc->pb, pkt, sample->size);
+        ret = ff_get_packet_direct(sc->pb, pkt, sample->size);
         if (ret < 0) {
             if (should_retry(sc->pb, ret)) {
                 mov_current_sample_dec(sc);
@@ -8156,6 +8469,10 @@ static const AVOption mov_options[] = {
     { "decryption_key", "The media decryption key (hex)", OFFSET(decryption_key), AV_OPT_TYPE_BINARY, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "enable_drefs", "Enable external track support.", OFFSET(enable_drefs), AV_OPT_TYPE_BOOL,
         {.i64 = 0}, 0, 1, FLAGS },
+    { "index_cache", "Directory to cache the sample index of local files in", OFFSET(index_cache_dir),
+        AV_OPT_TYPE_STRING, {.str = NULL}, .flags = FLAGS },
+    { "index_cache_write", "Write missing or stale index cache files", OFFSET(index_cache_write),
+        AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
 
     { NULL },
 };
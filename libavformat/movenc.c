@@ -69,6 +69,7 @@ static const AVOption options[] = {
     { "frag_custom", "Flush fragments on caller requests", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_CUSTOM}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "isml", "Create a live smooth streaming feed (for pushing to a publishing point)", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_ISML}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "faststart", "Run a second pass to put the index (moov atom) at the beginning of the file", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FASTSTART}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "reserve_moov", "Reserve estimated space for the index (moov atom) at the beginning of the file, moving the data only if it does not fit", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RESERVE_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "omit_tfhd_offset", "Omit the base data offset in tfhd atoms", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_OMIT_TFHD_OFFSET}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "disable_chpl", "Disable Nero chapter atom", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DISABLE_CHPL}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "default_base_moof", "Set the default-base-is-moof flag in tfhd atoms", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DEFAULT_BASE_MOOF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -119,6 +120,7 @@ static const AVClass flavor ## _muxer_class = {\
 };
 
 static int get_moov_size(AVFormatContext *s);
+static int estimate_moov_size(AVFormatContext *s);
 
 static int utf8len(const uint8_t *b)
 {
@@ -6296,6 +6298,15 @@ static int mov_init(AVFormatContext *s)
         mov->flags &= ~FF_MOV_FLAG_SKIP_SIDX;
     }
 
+    if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV) {
+        if (mov->flags & FF_MOV_FLAG_FRAGMENT || mov->reserved_moov_size) {
+            av_log(s, AV_LOG_WARNING, "reserve_moov is not supported with fragmented output or moov_size, ignoring\n");
+            mov->flags &= ~FF_MOV_FLAG_RESERVE_MOOV;
+        } else {
+            mov->flags |= FF_MOV_FLAG_FASTSTART;
+        }
+    }
+
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
         mov->reserved_moov_size = -1;
     }
@@ -6644,6 +6655,15 @@ static int mov_write_header(AVFormatContext *s)
             return ret;
     }
 
+    if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV) {
+        int size = estimate_moov_size(s);
+        if (size > 0)
+            mov->reserved_moov_size = size;
+        else
+            av_log(s, AV_LOG_WARNING, "Could not estimate the moov size, "
+                   "falling back to moving the data at the end\n");
+    }
+
     if (mov->reserved_moov_size){
         mov->reserved_header_pos = avio_tell(pb);
         if (mov->reserved_moov_size > 0)
@@ -6658,7 +6678,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -6732,6 +6752,53 @@ static int get_moov_size(AVFormatContext *s)
     return ffio_close_null_buf(moov_buf);
 }
 
+/*
+ * Estimate an upper bound of the final moov size from the stream durations
+ * and rates, so that it can be reserved at the beginning of the file.
+ * Returns 0 if some stream does not provide enough information.
+ */
+static int estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int64_t size = 4096 + s->nb_chapters * 64;
+    int i;
+
+    if (mov->flags & FF_MOV_FLAG_RTP_HINT)
+        return 0;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        AVCodecParameters *par = st->codecpar;
+        int64_t samples;
+
+        if (st->duration <= 0)
+            return 0;
+        /* stsz and co64 entries per sample, plus ctts and stss for video */
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+            if (st->avg_frame_rate.num <= 0 || st->avg_frame_rate.den <= 0)
+                return 0;
+            samples = av_rescale_q(st->duration, st->time_base,
+                                   av_inv_q(st->avg_frame_rate));
+            size += samples * 24;
+        } else if (par->codec_type == AVMEDIA_TYPE_AUDIO) {
+            if (par->sample_rate <= 0)
+                return 0;
+            samples = av_rescale_q(st->duration, st->time_base,
+                                   (AVRational){ par->frame_size > 0 ? par->frame_size : 1024,
+                                                 par->sample_rate });
+            size += samples * 12;
+        } else {
+            samples = av_rescale_q(st->duration, st->time_base, (AVRational){ 1, 1 });
+            size += samples * 24;
+        }
+        size += 1024 + par->extradata_size;
+        if (size > INT_MAX / 2)
+            return 0;
+    }
+
+    return size + size / 8;
+}
+
 static int get_sidx_size(AVFormatContext *s)
 {
     int ret;
@@ -6921,7 +6988,21 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV && mov->reserved_moov_size > 0) {
+            if ((res = get_moov_size(s)) < 0)
+                return res;
+            if (res + 8 > mov->reserved_moov_size) {
+                av_log(s, AV_LOG_WARNING, "Reserved moov space of %d bytes is too small, "
+                       "needed %d, moving the data instead\n", mov->reserved_moov_size, res + 8);
+                /* leave the reservation in place as a free atom */
+                avio_wb32(pb, mov->reserved_moov_size);
+                ffio_wfourcc(pb, "free");
+                avio_seek(pb, moov_pos, SEEK_SET);
+                mov->reserved_moov_size = -1;
+            }
+        }
+
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res < 0)
@@ -2879,7 +2879,7 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
 {
     MpegTSContext *ts = s->priv_data;
     AVIOContext *pb = s->pb;
-    int c, i;
+    int i;
     uint64_t pos = avio_tell(pb);
 
     avio_seek(pb, -FFMIN(seekback, pos), SEEK_CUR);
@@ -2890,15 +2890,29 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
         return 0;
     }
 
-    for (i = 0; i < ts->resync_size; i++) {
-        c = avio_r8(pb);
-        if (avio_feof(pb))
-            return AVERROR_EOF;
-        if (c == 0x47) {
+    for (i = 0; i < ts->resync_size;) {
+        const uint8_t *sync;
+        int left;
+
+        if (pb->buf_ptr >= pb->buf_end) {
+            /* let avio refill its buffer, the byte read is kept in it */
+            if (ffio_ensure_seekback(pb, 1) < 0)
+                return AVERROR(ENOMEM);
+            avio_r8(pb);
+            if (avio_feof(pb))
+                return AVERROR_EOF;
             avio_seek(pb, -1, SEEK_CUR);
+        }
+        /* scan what is already buffered instead of reading byte by byte */
+        left = FFMIN(pb->buf_end - pb->buf_ptr, ts->resync_size - i);
+        sync = memchr(pb->buf_ptr, 0x47, left);
+        if (sync) {
+            avio_skip(pb, sync - pb->buf_ptr);
             reanalyze(s->priv_data);
             return 0;
         }
+        avio_skip(pb, left);
+        i += left;
     }
     av_log(s, AV_LOG_ERROR,
            "max resync size reached, could not find sync byte\n");
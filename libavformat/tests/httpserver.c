@@ -0,0 +1,327 @@
+/*
+ * In-memory HTTP server test: serve resources to loopback clients, complete
+ * or streamed while they are written, with pipelined requests, a client not
+ * reading its response, and the size and age limits.
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/avstring.h"
+#include "libavutil/time.h"
+
+#include "libavformat/httpserver.h"
+#include "libavformat/network.h"
+
+#define SEGMENT_SIZE 100000
+#define BIG_SIZE     (8 << 20)
+
+typedef struct Client {
+    int fd;
+    uint8_t buf[65536];
+    int len, pos;
+} Client;
+
+static uint8_t data[BIG_SIZE];
+
+/* Find a free port by binding to port 0 */
+static int find_port(void)
+{
+    struct sockaddr_in addr = { 0 };
+    socklen_t addrlen = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0), port = -1;
+
+    if (fd < 0)
+        return -1;
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (!bind(fd, (struct sockaddr *)&addr, sizeof(addr)) &&
+        !getsockname(fd, (struct sockaddr *)&addr, &addrlen))
+        port = ntohs(addr.sin_port);
+    closesocket(fd);
+    return port;
+}
+
+static int client_open(Client *c, int port)
+{
+    struct sockaddr_in addr = { 0 };
+
+    c->len = c->pos = 0;
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->fd < 0)
+        return -1;
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        closesocket(c->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static void client_close(Client *c)
+{
+    closesocket(c->fd);
+}
+
+static int client_send(Client *c, const char *request)
+{
+    int size = strlen(request);
+
+    return send(c->fd, request, size, 0) == size ? 0 : -1;
+}
+
+static int client_fill(Client *c)
+{
+    int ret;
+
+    if (c->pos == c->len)
+        c->pos = c->len = 0;
+    if (c->len == sizeof(c->buf)) {
+        memmove(c->buf, c->buf + c->pos, c->len - c->pos);
+        c->len -= c->pos;
+        c->pos  = 0;
+    }
+    /* do not hang if the server does not answer */
+    if ((ret = ff_network_wait_fd_timeout(c->fd, 0, 10000000, NULL)) < 0)
+        return ret;
+    ret = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+    if (ret > 0)
+        c->len += ret;
+    return ret;
+}
+
+static int client_getline(Client *c, char *line, int size)
+{
+    for (;;) {
+        uint8_t *eol = memchr(c->buf + c->pos, '\n', c->len - c->pos);
+        if (eol) {
+            av_strlcpy(line, (char *)c->buf + c->pos, FFMIN(eol - (c->buf + c->pos), size));
+            line[strcspn(line, "\r")] = '\0';
+            c->pos = eol + 1 - c->buf;
+            return 0;
+        }
+        if (client_fill(c) <= 0)
+            return -1;
+    }
+}
+
+/* Read size bytes of body, or until the connection is closed if size < 0 */
+static int64_t client_read_body(Client *c, int64_t size, uint32_t *crc)
+{
+    int64_t total = 0;
+
+    while (size < 0 || total < size) {
+        int len;
+        if (c->pos == c->len && client_fill(c) <= 0)
+            break;
+        len = c->len - c->pos;
+        if (size >= 0)
+            len = FFMIN(len, size - total);
+        *crc   = av_adler32_update(*crc, c->buf + c->pos, len);
+        c->pos += len;
+        total  += len;
+    }
+    return total;
+}
+
+static void read_response(Client *c, const char *name, int head)
+{
+    char line[1024], type[64] = "";
+    int64_t length = -1, total = 0;
+    uint32_t crc = 1;
+    int status = -1, chunked = 0;
+
+    if (client_getline(c, line, sizeof(line)) < 0 ||
+        sscanf(line, "HTTP/1.1 %d", &status) != 1) {
+        printf("%s: no response\n", name);
+        return;
+    }
+    while (!client_getline(c, line, sizeof(line)) && line[0]) {
+        if (!av_strncasecmp(line, "Content-Length:", 15))
+            length = strtoll(line + 15, NULL, 10);
+        else if (!av_strncasecmp(line, "Transfer-Encoding: chunked", 26))
+            chunked = 1;
+        else if (!av_strncasecmp(line, "Content-Type:", 13))
+            av_strlcpy(type, line + 14, sizeof(type));
+    }
+
+    if (head) {
+    } else if (chunked) {
+        int64_t size;
+        do {
+            if (client_getline(c, line, sizeof(line)) < 0)
+                break;
+            size   = strtoll(line, NULL, 16);
+            total += client_read_body(c, size, &crc);
+            client_getline(c, line, sizeof(line));
+        } while (size > 0);
+    } else {
+        total = client_read_body(c, length, &crc);
+    }
+    printf("%s: %d%s%s, %s, %"PRId64" bytes 0x%08x\n", name, status,
+           type[0] ? " " : "", type, chunked ? "chunked" : "length",
+           head ? length : total, crc);
+}
+
+static void get(int port, const char *path, const char *name)
+{
+    Client c;
+    char request[256];
+
+    if (client_open(&c, port) < 0) {
+        printf("%s: connection failed\n", name);
+        return;
+    }
+    snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+    if (!client_send(&c, request))
+        read_response(&c, name, 0);
+    client_close(&c);
+}
+
+static int put(HTTPServer *srv, const char *path, const uint8_t *buf, int size,
+               int write_size)
+{
+    HTTPServerResource *res;
+    int pos, ret;
+
+    if ((ret = ff_http_server_publish(srv, path, &res)) < 0)
+        return ret;
+    for (pos = 0; pos < size; pos += write_size) {
+        ret = ff_http_server_write(srv, res, buf + pos, FFMIN(write_size, size - pos));
+        if (ret < 0)
+            break;
+    }
+    ff_http_server_finish(srv, &res);
+    return ret < 0 ? ret : 0;
+}
+
+static int test_serve(int port)
+{
+    HTTPServer *srv;
+    HTTPServerResource *live, *big;
+    Client c, slow;
+    int64_t start;
+    int i, ret;
+
+    if ((ret = ff_http_server_open(&srv, "127.0.0.1", port, 0, 0)) < 0)
+        return ret;
+
+    put(srv, "/seg0.ts", data, SEGMENT_SIZE, 30000);
+    put(srv, "/index.m3u8", (const uint8_t *)"#EXTM3U\n#EXTINF:2,\nseg0.ts\n", 27, 4096);
+    get(port, "/seg0.ts", "complete");
+    get(port, "/missing.ts", "missing");
+
+    /* pipelined requests on a keep-alive connection */
+    if (!client_open(&c, port)) {
+        client_send(&c, "HEAD /seg0.ts HTTP/1.1\r\n\r\n"
+                        "GET /index.m3u8 HTTP/1.1\r\n\r\n"
+                        "POST /seg0.ts HTTP/1.1\r\n\r\n"
+                        "GET /seg0.ts HTTP/1.1\r\n\r\n");
+        read_response(&c, "pipelined head", 1);
+        read_response(&c, "pipelined playlist", 0);
+        read_response(&c, "pipelined post", 0);
+        read_response(&c, "pipelined get", 0);
+        client_close(&c);
+    }
+
+    /* a resource streamed as it is written */
+    if ((ret = ff_http_server_publish(srv, "/live.ts", &live)) < 0)
+        return ret;
+    ff_http_server_write(srv, live, data, 1000);
+    if (!client_open(&c, port)) {
+        client_send(&c, "GET /live.ts HTTP/1.1\r\n\r\n");
+        /* wait for the response to start before writing the rest */
+        client_fill(&c);
+        for (i = 1; i < 10; i++)
+            ff_http_server_write(srv, live, data + i * 1000, 1000);
+        ff_http_server_finish(srv, &live);
+        read_response(&c, "live", 0);
+        client_close(&c);
+    }
+
+    /* a client not reading does not hold the writer nor the other clients */
+    if ((ret = ff_http_server_publish(srv, "/big.ts", &big)) < 0)
+        return ret;
+    if (!client_open(&slow, port)) {
+        client_send(&slow, "GET /big.ts HTTP/1.1\r\n\r\n");
+        start = av_gettime_relative();
+        for (i = 0; i < BIG_SIZE; i += 65536)
+            ff_http_server_write(srv, big, data + i, 65536);
+        ff_http_server_finish(srv, &big);
+        get(port, "/seg0.ts", "while stalled");
+        printf("stalled writes took %s than 5 seconds\n",
+               av_gettime_relative() - start < 5000000 ? "less" : "more");
+        read_response(&slow, "stalled", 0);
+        client_close(&slow);
+    }
+
+    ff_http_server_delete(srv, "/seg0.ts");
+    get(port, "/seg0.ts", "deleted");
+
+    ff_http_server_close(&srv);
+    return 0;
+}
+
+static int test_limits(int port)
+{
+    HTTPServer *srv;
+    int ret;
+
+    if ((ret = ff_http_server_open(&srv, "127.0.0.1", port, 2 * SEGMENT_SIZE + 100, 0)) < 0)
+        return ret;
+    put(srv, "/seg1.ts", data, SEGMENT_SIZE, 30000);
+    put(srv, "/seg2.ts", data + 1, SEGMENT_SIZE, 30000);
+    put(srv, "/seg3.ts", data + 2, SEGMENT_SIZE, 30000);
+    get(port, "/seg1.ts", "size limit oldest");
+    get(port, "/seg2.ts", "size limit second");
+    get(port, "/seg3.ts", "size limit newest");
+    ff_http_server_close(&srv);
+
+    /* the limits given last apply */
+    if ((ret = ff_http_server_open(&srv, "127.0.0.1", port, 0, 2000000)) < 0)
+        return ret;
+    put(srv, "/seg4.ts", data + 3, SEGMENT_SIZE, 30000);
+    get(port, "/seg4.ts", "age limit before");
+    av_usleep(2500000);
+    get(port, "/seg4.ts", "age limit after");
+    ff_http_server_close(&srv);
+    return 0;
+}
+
+int main(void)
+{
+    int i, port1 = find_port(), port2 = find_port();
+
+    if (port1 < 0 || port2 < 0) {
+        fprintf(stderr, "Could not find a free port\n");
+        return 1;
+    }
+    for (i = 0; i < BIG_SIZE; i++)
+        data[i] = i * 13 + (i >> 9);
+
+    if (test_serve(port1) < 0 || test_limits(port2) < 0) {
+        fprintf(stderr, "Could not start the server\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,291 @@
+/*
+ * Index cache test: open a mov file cold, with a missing, a valid and
+ * a stale index cache, and check all opens return the same index and
+ * packets as a regular open of the same file.
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <utime.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/avstring.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+
+#include "libavformat/avformat.h"
+
+#define NB_FRAMES   50
+#define NB_SAMPLES  400
+#define FILE_MTIME  1000000000
+
+/* Decode order to presentation order of an IPBB... GOP, so that the
+ * muxer writes a ctts table */
+static const int reorder[3] = { 3, 1, 2 };
+
+static char cache_path[1024];
+static int cache_result;    /* 1 hit, 0 miss, -1 no cache used */
+static int cache_stale;
+
+static void log_callback(void *avcl, int level, const char *fmt, va_list vl)
+{
+    va_list vl2;
+
+    if (!strcmp(fmt, "Index cache %s: %s\n")) {
+        va_copy(vl2, vl);
+        av_strlcpy(cache_path, va_arg(vl2, const char *), sizeof(cache_path));
+        cache_result = !strcmp(va_arg(vl2, const char *), "hit");
+        va_end(vl2);
+    } else if (strstr(fmt, "index cache does not match")) {
+        cache_stale = 1;
+    } else if (level <= AV_LOG_ERROR) {
+        av_log_default_callback(avcl, level, fmt, vl);
+    }
+}
+
+static int write_file(const char *filename)
+{
+    AVFormatContext *oc = NULL;
+    AVStream *video, *audio;
+    AVPacket pkt;
+    uint8_t data[4096];
+    int i, ret;
+
+    ret = avformat_alloc_output_context2(&oc, NULL, "mov", filename);
+    if (ret < 0)
+        return ret;
+
+    video = avformat_new_stream(oc, NULL);
+    audio = avformat_new_stream(oc, NULL);
+    if (!video || !audio) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    video->codecpar->codec_type  = AVMEDIA_TYPE_VIDEO;
+    video->codecpar->codec_id    = AV_CODEC_ID_MJPEG;
+    video->codecpar->width       = 64;
+    video->codecpar->height      = 48;
+    video->time_base             = (AVRational){ 1, 25 };
+    audio->codecpar->codec_type  = AVMEDIA_TYPE_AUDIO;
+    audio->codecpar->codec_id    = AV_CODEC_ID_PCM_S16LE;
+    audio->codecpar->channels    = 1;
+    audio->codecpar->sample_rate = 8000;
+    audio->codecpar->block_align = 2;
+    audio->time_base             = (AVRational){ 1, 8000 };
+
+    ret = avio_open(&oc->pb, filename, AVIO_FLAG_WRITE);
+    if (ret < 0)
+        goto end;
+    ret = avformat_write_header(oc, NULL);
+    if (ret < 0)
+        goto end;
+
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = i * 7 + (i >> 8);
+
+    for (i = 0; i < NB_FRAMES; i++) {
+        av_init_packet(&pkt);
+        pkt.stream_index = 0;
+        pkt.data         = data;
+        pkt.size         = 500 + (i * 397) % 3000;
+        pkt.dts          = i;
+        pkt.pts          = i ? i - 1 + reorder[(i - 1) % 3] : 0;
+        pkt.duration     = 1;
+        pkt.flags        = i % 12 ? 0 : AV_PKT_FLAG_KEY;
+        ret = av_interleaved_write_frame(oc, &pkt);
+        if (ret < 0)
+            goto end;
+
+        if (i % 5 == 4)
+            continue;
+        av_init_packet(&pkt);
+        pkt.stream_index = 1;
+        pkt.data         = data + i;
+        pkt.size         = NB_SAMPLES * 2;
+        pkt.pts          = pkt.dts = (int64_t)(i - i / 5) * NB_SAMPLES;
+        pkt.duration     = NB_SAMPLES;
+        pkt.flags        = AV_PKT_FLAG_KEY;
+        ret = av_interleaved_write_frame(oc, &pkt);
+        if (ret < 0)
+            goto end;
+    }
+    ret = av_write_trailer(oc);
+
+end:
+    avio_closep(&oc->pb);
+    avformat_free_context(oc);
+    return ret;
+}
+
+static int set_mtime(const char *filename)
+{
+    struct utimbuf times = { FILE_MTIME, FILE_MTIME };
+
+    if (utime(filename, &times) < 0) {
+        fprintf(stderr, "Could not set the modification time of %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/* Make the sample table of the first track one sample shorter, without
+ * changing the size of the file */
+static int patch_stsz(const char *filename)
+{
+    uint8_t buf[4096];
+    FILE *f = fopen(filename, "r+b");
+    long pos = 0;
+    int i, n;
+
+    if (!f)
+        return -1;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 16) {
+        for (i = 0; i + 16 <= n; i++) {
+            if (!memcmp(buf + i, "stsz", 4)) {
+                AV_WB32(buf + i + 12, AV_RB32(buf + i + 12) - 1);
+                fseek(f, pos + i + 12, SEEK_SET);
+                fwrite(buf + i + 12, 1, 4, f);
+                fclose(f);
+                return 0;
+            }
+        }
+        pos += n - 15;
+        fseek(f, pos, SEEK_SET);
+    }
+    fclose(f);
+    return -1;
+}
+
+static int open_file(const char *name, const char *filename,
+                     const char *cache_dir, int cache_write, int print)
+{
+    AVFormatContext *ic = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket pkt;
+    uint32_t index_crc[2] = { 1, 1 }, pkt_crc[2] = { 1, 1 };
+    int nb_pkts[2] = { 0 };
+    uint8_t tmp[8];
+    int i, j, ret;
+
+    cache_result = -1;
+    cache_stale  = 0;
+    if (cache_dir) {
+        av_dict_set(&opts, "index_cache", cache_dir, 0);
+        av_dict_set_int(&opts, "index_cache_write", cache_write, 0);
+    }
+    ret = avformat_open_input(&ic, filename, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        fprintf(stderr, "%s: could not open %s\n", name, filename);
+        return ret;
+    }
+    if (ic->nb_streams != 2) {
+        fprintf(stderr, "%s: unexpected stream count %d\n", name, ic->nb_streams);
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        for (j = 0; j < st->nb_index_entries; j++) {
+            const AVIndexEntry *e = &st->index_entries[j];
+            AV_WL64(tmp, e->pos);
+            index_crc[i] = av_adler32_update(index_crc[i], tmp, 8);
+            AV_WL64(tmp, e->timestamp);
+            index_crc[i] = av_adler32_update(index_crc[i], tmp, 8);
+            AV_WL32(tmp,     e->size);
+            AV_WL32(tmp + 4, e->flags | e->min_distance << 2);
+            index_crc[i] = av_adler32_update(index_crc[i], tmp, 8);
+        }
+    }
+
+    while ((ret = av_read_frame(ic, &pkt)) >= 0) {
+        i = pkt.stream_index;
+        nb_pkts[i]++;
+        AV_WL64(tmp, pkt.pts);
+        pkt_crc[i] = av_adler32_update(pkt_crc[i], tmp, 8);
+        AV_WL64(tmp, pkt.dts);
+        pkt_crc[i] = av_adler32_update(pkt_crc[i], tmp, 8);
+        AV_WL32(tmp,     pkt.duration);
+        AV_WL32(tmp + 4, pkt.flags);
+        pkt_crc[i] = av_adler32_update(pkt_crc[i], tmp, 8);
+        pkt_crc[i] = av_adler32_update(pkt_crc[i], pkt.data, pkt.size);
+        av_packet_unref(&pkt);
+    }
+    ret = ret == AVERROR_EOF ? 0 : ret;
+
+    if (print) {
+        printf("%s: cache %s%s\n", name,
+               cache_result < 0 ? "unused" : cache_result ? "hit" : "miss",
+               cache_stale ? ", stale" : "");
+        for (i = 0; i < ic->nb_streams; i++)
+            printf("  stream %d: %d entries, index 0x%08x, "
+                   "%d packets 0x%08x, duration %"PRId64"\n",
+                   i, ic->streams[i]->nb_index_entries, index_crc[i],
+                   nb_pkts[i], pkt_crc[i], ic->streams[i]->duration);
+    }
+
+end:
+    avformat_close_input(&ic);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    char filename[1024];
+    const char *dir;
+    int ret;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <output directory>\n", argv[0]);
+        return 1;
+    }
+    dir = argv[1];
+    snprintf(filename, sizeof(filename), "%s/indexcache.mov", dir);
+
+    av_log_set_callback(log_callback);
+
+    if (write_file(filename) < 0 || set_mtime(filename) < 0)
+        return 1;
+
+    /* Find out the name of the cache file and remove a leftover one */
+    if (open_file("probe", filename, dir, 0, 0) < 0 || cache_result < 0)
+        return 1;
+    remove(cache_path);
+
+    if (open_file("cold",  filename, NULL, 0, 1) < 0 ||
+        open_file("write", filename, dir,  1, 1) < 0 ||
+        open_file("read",  filename, dir,  0, 1) < 0)
+        return 1;
+
+    /* The cache is keyed on size and modification time, keep both */
+    if (patch_stsz(filename) < 0 || set_mtime(filename) < 0)
+        return 1;
+
+    if (open_file("patched cold",  filename, NULL, 0, 1) < 0 ||
+        open_file("patched stale", filename, dir,  1, 1) < 0 ||
+        open_file("patched write", filename, dir,  1, 1) < 0 ||
+        open_file("patched read",  filename, dir,  0, 1) < 0)
+        return 1;
+
+    ret = remove(cache_path);
+    remove(filename);
+
+    return ret < 0;
+}
@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* recvmmsg() and sendmmsg() */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -61,6 +62,17 @@
 #define IPPROTO_UDPLITE                                  136
 #endif
 
+#ifdef __linux__
+/* Segmentation offload is available since Linux 4.18 (sending) and 5.0
+ * (receiving), but the libc headers may not define the socket options yet. */
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT                                      103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO                                          104
+#endif
+#endif
+
 #if HAVE_W32THREADS
 #undef HAVE_PTHREAD_CANCEL
 #define HAVE_PTHREAD_CANCEL 1
@@ -79,6 +91,8 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_GSO_SIZE (65535 - 20 - UDP_HEADER_SIZE)
+#define UDP_MAX_GSO_SEGMENTS 64
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -117,6 +131,22 @@ typedef struct UDPContext {
     char *sources;
     char *block;
     IPSourceFilters filters;
+
+    int batch_size;
+    int gso;
+    int gro;
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+    /* datagrams exchanged with recvmmsg()/sendmmsg(), one slot each */
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    struct sockaddr_storage *msg_addrs;
+    uint8_t *msg_ctrl;
+    uint8_t *msg_buf;
+    int msg_buf_size;
+    int nb_msgs;    ///< number of datagrams received or queued for sending
+    int cur_msg;    ///< next received datagram to return
+    int cur_offset; ///< offset of the next GRO segment in it
+#endif
 } UDPContext;
 
 #define OFFSET(x) offsetof(UDPContext, x)
@@ -141,6 +171,9 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout (only in read mode)",     OFFSET(timeout),        AV_OPT_TYPE_INT,    { .i64 = 0 },      0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "batch_size",     "Number of datagrams received or sent per system call", OFFSET(batch_size), AV_OPT_TYPE_INT,  { .i64 = 1 },      1, 1024,    .flags = D|E },
+    { "gso",            "Use UDP segmentation offload to send batches",    OFFSET(gso),            AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       E },
+    { "gro",            "Use UDP receive offload",                         OFFSET(gro),            AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       D },
     { NULL }
 };
 
@@ -387,6 +420,206 @@ static int udp_port(struct sockaddr_storage *addr, int addr_len)
 }
 
 
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+#define UDP_CTRL_SIZE CMSG_SPACE(sizeof(int))
+
+static void udp_free_batch(UDPContext *s)
+{
+    av_freep(&s->msgs);
+    av_freep(&s->iovs);
+    av_freep(&s->msg_addrs);
+    av_freep(&s->msg_ctrl);
+    av_freep(&s->msg_buf);
+}
+
+static int udp_alloc_batch(URLContext *h, int is_output)
+{
+    UDPContext *s = h->priv_data;
+    int i;
+
+    s->msg_buf_size = is_output && h->max_packet_size > 0 ? h->max_packet_size
+                                                           : UDP_MAX_PKT_SIZE;
+    s->msgs      = av_mallocz_array(s->batch_size, sizeof(*s->msgs));
+    s->iovs      = av_mallocz_array(s->batch_size, sizeof(*s->iovs));
+    s->msg_addrs = av_mallocz_array(s->batch_size, sizeof(*s->msg_addrs));
+    s->msg_ctrl  = av_mallocz_array(s->batch_size, UDP_CTRL_SIZE);
+    s->msg_buf   = av_malloc_array(s->batch_size, s->msg_buf_size);
+    if (!s->msgs || !s->iovs || !s->msg_addrs || !s->msg_ctrl || !s->msg_buf) {
+        udp_free_batch(s);
+        return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < s->batch_size; i++) {
+        struct msghdr *hdr = &s->msgs[i].msg_hdr;
+
+        s->iovs[i].iov_base = s->msg_buf + i * s->msg_buf_size;
+        s->iovs[i].iov_len  = s->msg_buf_size;
+        hdr->msg_iov        = &s->iovs[i];
+        hdr->msg_iovlen     = 1;
+        if (!is_output) {
+            hdr->msg_name    = &s->msg_addrs[i];
+            hdr->msg_control = s->msg_ctrl + i * UDP_CTRL_SIZE;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Append a datagram of size bytes to the batch to send.
+ * @return the buffer to copy the datagram to
+ */
+static uint8_t *udp_queue_datagram(UDPContext *s, int size)
+{
+    struct msghdr *hdr = &s->msgs[s->nb_msgs].msg_hdr;
+
+    hdr->msg_name    = s->is_connected ? NULL : &s->dest_addr;
+    hdr->msg_namelen = s->is_connected ? 0    : s->dest_addr_len;
+    s->iovs[s->nb_msgs].iov_len = size;
+    return s->msg_buf + s->nb_msgs++ * s->msg_buf_size;
+}
+
+#ifdef UDP_SEGMENT
+/**
+ * Send the datagrams starting at first as one buffer segmented by the
+ * kernel. Only full-sized datagrams are contiguous in msg_buf, so the run
+ * ends after the first shorter one.
+ * @return the number of datagrams sent, -1 on error
+ */
+static int udp_send_segments(UDPContext *s, int first)
+{
+    struct msghdr hdr = s->msgs[first].msg_hdr;
+    struct iovec iov  = s->iovs[first];
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } ctrl = { { 0 } };
+    int nb = 1;
+
+    if (iov.iov_len == s->msg_buf_size) {
+        while (first + nb < s->nb_msgs && nb < UDP_MAX_GSO_SEGMENTS &&
+               iov.iov_len + s->iovs[first + nb].iov_len <= UDP_MAX_GSO_SIZE) {
+            iov.iov_len += s->iovs[first + nb].iov_len;
+            if (s->iovs[first + nb++].iov_len != s->msg_buf_size)
+                break;
+        }
+    }
+    hdr.msg_iov = &iov;
+
+    if (nb > 1) {
+        uint16_t segment_size = s->msg_buf_size;
+        struct cmsghdr *cmsg;
+
+        hdr.msg_control    = ctrl.buf;
+        hdr.msg_controllen = sizeof(ctrl.buf);
+        cmsg               = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level   = IPPROTO_UDP;
+        cmsg->cmsg_type    = UDP_SEGMENT;
+        cmsg->cmsg_len     = CMSG_LEN(sizeof(segment_size));
+        memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+    }
+
+    return sendmsg(s->udp_fd, &hdr, 0) < 0 ? -1 : nb;
+}
+#endif
+
+/**
+ * Send all the queued datagrams.
+ */
+static int udp_send_batch(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int sent = 0;
+
+    while (sent < s->nb_msgs) {
+        int ret;
+#ifdef UDP_SEGMENT
+        if (s->gso)
+            ret = udp_send_segments(s, sent);
+        else
+#endif
+            ret = sendmmsg(s->udp_fd, s->msgs + sent, s->nb_msgs - sent, 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret == AVERROR(EAGAIN))
+                ret = ff_network_wait_fd_timeout(s->udp_fd, 1, h->rw_timeout,
+                                                 &h->interrupt_callback);
+            if (ret == AVERROR(EINTR) || ret == 0)
+                continue;
+            s->nb_msgs = 0;
+            return ret;
+        }
+        sent += ret;
+    }
+    s->nb_msgs = 0;
+    return 0;
+}
+
+/**
+ * Receive up to batch_size datagrams.
+ * @return the number of datagrams received, -1 on error
+ */
+static int udp_recv_batch(UDPContext *s, int flags)
+{
+    int i, ret;
+
+    for (i = 0; i < s->batch_size; i++) {
+        s->msgs[i].msg_hdr.msg_namelen    = sizeof(s->msg_addrs[i]);
+        s->msgs[i].msg_hdr.msg_controllen = s->gro ? UDP_CTRL_SIZE : 0;
+    }
+    ret = recvmmsg(s->udp_fd, s->msgs, s->batch_size, flags, NULL);
+    s->nb_msgs    = FFMAX(ret, 0);
+    s->cur_msg    = 0;
+    s->cur_offset = 0;
+    return ret;
+}
+
+static int udp_gro_segment_size(struct msghdr *hdr)
+{
+#ifdef UDP_GRO
+    struct cmsghdr *cmsg;
+    int size;
+
+    for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+            memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            return size;
+        }
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Return the next datagram of the received batch, splitting the buffers
+ * coalesced by GRO and skipping the filtered sources.
+ * @return the size of the datagram, AVERROR(EAGAIN) once the batch is empty
+ */
+static int udp_next_datagram(UDPContext *s, uint8_t **data)
+{
+    while (s->cur_msg < s->nb_msgs) {
+        struct mmsghdr *msg = &s->msgs[s->cur_msg];
+        int len = msg->msg_len - s->cur_offset;
+        int segment_size;
+
+        if (ff_ip_check_source_lists(&s->msg_addrs[s->cur_msg], &s->filters)) {
+            s->cur_msg++;
+            continue;
+        }
+
+        *data = s->msg_buf + s->cur_msg * s->msg_buf_size + s->cur_offset;
+        segment_size = udp_gro_segment_size(&msg->msg_hdr);
+        if (segment_size > 0 && len > segment_size) {
+            s->cur_offset += segment_size;
+            return segment_size;
+        }
+        s->cur_msg++;
+        s->cur_offset = 0;
+        return len;
+    }
+    return AVERROR(EAGAIN);
+}
+#endif
+
 /**
  * If no filename is given to av_open_input_file because you want to
  * get the local port first, then you must call this function to set
@@ -460,6 +693,34 @@ static int udp_get_file_handle(URLContext *h)
 }
 
 #if HAVE_PTHREAD_CANCEL
+/**
+ * Write a received datagram to the circular buffer.
+ * @return 0 if it was written or dropped on a nonfatal overrun, <0 on overrun
+ */
+static int circular_buffer_put(URLContext *h, const uint8_t *buf, int len)
+{
+    UDPContext *s = h->priv_data;
+    uint8_t tmp[4];
+
+    if(av_fifo_space(s->fifo) < len + 4) {
+        /* No Space left */
+        if (s->overrun_nonfatal) {
+            av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                    "Surviving due to overrun_nonfatal option\n");
+            return 0;
+        } else {
+            av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                    "To avoid, increase fifo_size URL option. "
+                    "To survive in such case, use overrun_nonfatal option\n");
+            return AVERROR(EIO);
+        }
+    }
+    AV_WL32(tmp, len);
+    av_fifo_generic_write(s->fifo, tmp, 4, NULL);
+    av_fifo_generic_write(s->fifo, (uint8_t *)buf, len, NULL);
+    return 0;
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -483,6 +744,11 @@ static void *circular_buffer_task_rx( void *_URLContext)
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+        if (s->msgs)
+            len = udp_recv_batch(s, MSG_WAITFORONE);
+        else
+#endif
         len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
@@ -493,25 +759,27 @@ static void *circular_buffer_task_rx( void *_URLContext)
             }
             continue;
         }
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+        if (s->msgs) {
+            uint8_t *data;
+
+            while ((len = udp_next_datagram(s, &data)) >= 0) {
+                if (circular_buffer_put(h, data, len) < 0) {
+                    s->circular_buffer_error = AVERROR(EIO);
+                    goto end;
+                }
+            }
+            pthread_cond_signal(&s->cond);
+            continue;
+        }
+#endif
         if (ff_ip_check_source_lists(&addr, &s->filters))
             continue;
-        AV_WL32(s->tmp, len);
 
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
-                continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
-            }
+        if (circular_buffer_put(h, s->tmp + 4, len) < 0) {
+            s->circular_buffer_error = AVERROR(EIO);
+            goto end;
         }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
         pthread_cond_signal(&s->cond);
     }
 
@@ -586,6 +854,40 @@ static void *circular_buffer_task_tx( void *_URLContext)
             target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+        if (s->msgs && len <= s->msg_buf_size) {
+            int ret;
+
+            memcpy(udp_queue_datagram(s, len), s->tmp, len);
+
+            /* send the following datagrams along if they are already due */
+            pthread_mutex_lock(&s->mutex);
+            while (s->nb_msgs < s->batch_size && av_fifo_size(s->fifo) >= 4) {
+                av_fifo_generic_peek(s->fifo, tmp, 4, NULL);
+                len = AV_RL32(tmp);
+                if (len > s->msg_buf_size ||
+                    (s->bitrate && av_gettime_relative() < target_timestamp))
+                    break;
+                av_fifo_drain(s->fifo, 4);
+                av_fifo_generic_read(s->fifo, udp_queue_datagram(s, len), len, NULL);
+                if (s->bitrate) {
+                    sent_bits += len * 8;
+                    target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
+                }
+            }
+            pthread_mutex_unlock(&s->mutex);
+
+            ret = udp_send_batch(h);
+            pthread_mutex_lock(&s->mutex);
+            if (ret < 0) {
+                s->circular_buffer_error = ret;
+                pthread_mutex_unlock(&s->mutex);
+                return NULL;
+            }
+            continue;
+        }
+#endif
+
         p = s->tmp;
         while (len) {
             int ret;
@@ -628,7 +930,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     char hostname[1024], localaddr[1024] = "";
     int port, udp_fd = -1, tmp, bind_ret = -1, dscp = -1;
     UDPContext *s = h->priv_data;
-    int is_output;
+    int is_output, tx_batch = 0;
     const char *p;
     char buf[256];
     struct sockaddr_storage my_addr;
@@ -726,6 +1028,12 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             s->timeout = strtol(buf, NULL, 10);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
             s->is_broadcast = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "batch_size", p))
+            s->batch_size = av_clip(strtol(buf, NULL, 10), 1, 1024);
+        if (av_find_info_tag(buf, sizeof(buf), "gso", p))
+            s->gso = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "gro", p))
+            s->gro = strtol(buf, NULL, 10);
     }
     /* handling needed to support options picking from both AVOption and URL */
     s->circular_buffer_size *= 188;
@@ -878,11 +1186,47 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     s->udp_fd = udp_fd;
 
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+    if (s->gso && is_output) {
+#ifdef UDP_SEGMENT
+        int segment_size;
+        socklen_t optlen = sizeof(segment_size);
+        if (getsockopt(udp_fd, IPPROTO_UDP, UDP_SEGMENT, &segment_size, &optlen) < 0)
+#endif
+        {
+            av_log(h, AV_LOG_WARNING, "UDP segmentation offload is not supported\n");
+            s->gso = 0;
+        }
+    }
+    if (s->gro && !is_output) {
+#ifdef UDP_GRO
+        int one = 1;
+        if (setsockopt(udp_fd, IPPROTO_UDP, UDP_GRO, &one, sizeof(one)) < 0)
+#endif
+        {
+            av_log(h, AV_LOG_WARNING, "UDP receive offload is not supported\n");
+            s->gro = 0;
+        }
+    }
+    s->gso &= is_output;
+    s->gro &= !is_output;
+    if ((s->batch_size > 1 || s->gso || s->gro) && udp_alloc_batch(h, is_output) < 0)
+        goto fail;
+    tx_batch = is_output && s->msgs;
+#else
+    if (s->batch_size > 1 || s->gso || s->gro)
+        av_log(h, AV_LOG_WARNING,
+               "'batch_size', 'gso' and 'gro' options were set but they are not "
+               "supported on this build (recvmmsg() and sendmmsg() are required)\n");
+#endif
+
 #if HAVE_PTHREAD_CANCEL
     /*
       Create thread in case of:
       1. Input and circular_buffer_size is set
       2. Output and bitrate and circular_buffer_size is set
+      3. Output and batching and circular_buffer_size is set, the thread
+         sends the datagrams queued meanwhile together
     */
 
     if (is_output && s->bitrate && !s->circular_buffer_size) {
@@ -890,7 +1234,8 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         av_log(h, AV_LOG_WARNING,"'bitrate' option was set but 'circular_buffer_size' is not, but required\n");
     }
 
-    if ((!is_output && s->circular_buffer_size) || (is_output && s->bitrate && s->circular_buffer_size)) {
+    if ((!is_output && s->circular_buffer_size) ||
+        (is_output && (s->bitrate || tx_batch) && s->circular_buffer_size)) {
         int ret;
 
         /* start the task going */
@@ -913,6 +1258,13 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         s->thread_started = 1;
     }
 #endif
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+    if (tx_batch && !s->fifo) {
+        av_log(h, AV_LOG_WARNING, "Sending batches requires a non zero "
+               "'fifo_size' and thread support, datagrams are sent one by one\n");
+        udp_free_batch(s);
+    }
+#endif
 
     return 0;
 #if HAVE_PTHREAD_CANCEL
@@ -925,6 +1277,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep(&s->fifo);
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+    udp_free_batch(s);
+#endif
     ff_ip_reset_filters(&s->filters);
     return AVERROR(EIO);
 }
@@ -991,6 +1346,28 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     }
 #endif
 
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+    if (s->msgs) {
+        uint8_t *data;
+
+        while ((ret = udp_next_datagram(s, &data)) < 0) {
+            if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+                ret = ff_network_wait_fd(s->udp_fd, 0);
+                if (ret < 0)
+                    return ret;
+            }
+            if (udp_recv_batch(s, 0) < 0)
+                return ff_neterrno();
+        }
+        if (ret > size) {
+            av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
+            ret = size;
+        }
+        memcpy(buf, data, ret);
+        return ret;
+    }
+#endif
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 0);
         if (ret < 0)
@@ -1038,6 +1415,7 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
         return size;
     }
 #endif
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 1);
         if (ret < 0)
@@ -1091,6 +1469,9 @@ static int udp_close(URLContext *h)
         pthread_mutex_destroy(&s->mutex);
         pthread_cond_destroy(&s->cond);
     }
+#endif
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+    udp_free_batch(s);
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep(&s->fifo);
@@ -0,0 +1,416 @@
+/*
+ * Background upload queue for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avassert.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "uploadqueue.h"
+#include "url.h"
+
+#if HAVE_THREADS
+
+typedef struct UploadJob {
+    UploadQueue *q;
+    char *url;
+    AVDictionary *options;
+    uint8_t *data;
+    int size;
+    int pos;
+    int allocated_size;
+    int error;
+    int ordered;
+    int running;
+    struct UploadJob *next;
+} UploadJob;
+
+struct UploadQueue {
+    AVFormatContext *s;
+    int64_t max_size;
+    int max_retries;
+
+    pthread_t *threads;
+    int nb_threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    /* closed files not written yet, in closing order */
+    UploadJob *jobs;
+    int nb_jobs;
+    int64_t size;
+    int error;
+    int abort;
+};
+
+static void job_free(UploadJob **pjob)
+{
+    UploadJob *job = *pjob;
+
+    if (!job)
+        return;
+    av_freep(&job->url);
+    av_dict_free(&job->options);
+    av_freep(&job->data);
+    av_freep(pjob);
+}
+
+/* The files are written to memory through a URLContext of their own, so that
+ * closing them with avio_close() queues them, whatever closes them. */
+static int upload_url_write(URLContext *h, const unsigned char *buf, int size)
+{
+    UploadJob *job = h->priv_data;
+    int ret;
+
+    if (size > INT_MAX - job->pos)
+        return AVERROR(ERANGE);
+    if (job->pos + size > job->allocated_size) {
+        int new_size = FFMAX(job->pos + size, FFMIN(job->allocated_size, INT_MAX / 2) * 2);
+        if ((ret = av_reallocp(&job->data, new_size)) < 0) {
+            job->allocated_size = job->size = job->pos = 0;
+            return job->error = ret;
+        }
+        job->allocated_size = new_size;
+    }
+    if (job->pos > job->size)
+        memset(job->data + job->size, 0, job->pos - job->size);
+    memcpy(job->data + job->pos, buf, size);
+    job->pos += size;
+    job->size = FFMAX(job->size, job->pos);
+    return size;
+}
+
+static int64_t upload_url_seek(URLContext *h, int64_t pos, int whence)
+{
+    UploadJob *job = h->priv_data;
+
+    switch (whence) {
+    case AVSEEK_SIZE:
+        return job->size;
+    case SEEK_CUR:
+        pos += job->pos;
+        break;
+    case SEEK_END:
+        pos += job->size;
+        break;
+    case SEEK_SET:
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0 || pos > INT_MAX)
+        return AVERROR(EINVAL);
+    job->pos = pos;
+    return pos;
+}
+
+static int upload_url_close(URLContext *h)
+{
+    UploadJob *job = h->priv_data, **p;
+    UploadQueue *q = job->q;
+    int ret;
+
+    if (job->error < 0) {
+        ret = job->error;
+        job_free(&job);
+        return ret;
+    }
+
+    pthread_mutex_lock(&q->mutex);
+    for (p = &q->jobs; *p; p = &(*p)->next) {
+        UploadJob *old = *p;
+        if (!old->running && !strcmp(old->url, job->url)) {
+            av_log(q->s, AV_LOG_DEBUG, "Dropping the queued previous version of '%s'\n",
+                   old->url);
+            *p = old->next;
+            q->size -= old->size;
+            q->nb_jobs--;
+            job_free(&old);
+            break;
+        }
+    }
+    for (p = &q->jobs; *p; p = &(*p)->next)
+        ;
+    *p = job;
+    q->size += job->size;
+    q->nb_jobs++;
+    pthread_cond_broadcast(&q->cond);
+
+    while (q->size > q->max_size && q->nb_jobs > 1)
+        pthread_cond_wait(&q->cond, &q->mutex);
+    ret = q->error;
+    q->error = 0;
+    pthread_mutex_unlock(&q->mutex);
+    return ret;
+}
+
+static const URLProtocol upload_queue_protocol = {
+    .name      = "uploadqueue",
+    .url_write = upload_url_write,
+    .url_seek  = upload_url_seek,
+    .url_close = upload_url_close,
+};
+
+/* Must be called with the mutex locked. */
+static UploadJob *next_job(UploadQueue *q)
+{
+    UploadJob *job, *prev;
+
+    for (job = q->jobs; job; job = job->next) {
+        if (job->running)
+            continue;
+        if (job->ordered && job != q->jobs)
+            continue;
+        for (prev = q->jobs; prev != job; prev = prev->next)
+            if (!strcmp(prev->url, job->url))
+                break;
+        if (prev == job)
+            return job;
+    }
+    return NULL;
+}
+
+static int upload_job(UploadQueue *q, UploadJob *job)
+{
+    AVFormatContext *s = q->s;
+    int attempt, ret;
+
+    for (attempt = 0;; attempt++) {
+        AVDictionary *options = NULL;
+        AVIOContext *pb = NULL;
+
+        av_dict_copy(&options, job->options, 0);
+        ret = s->io_open(s, &pb, job->url, AVIO_FLAG_WRITE, &options);
+        av_dict_free(&options);
+        if (ret >= 0) {
+            avio_write(pb, job->data, job->size);
+            avio_flush(pb);
+            ret = pb->error;
+            ff_format_io_close(s, &pb);
+        }
+        if (ret >= 0)
+            return 0;
+        if (attempt >= q->max_retries || ff_check_interrupt(&s->interrupt_callback))
+            break;
+        av_log(s, AV_LOG_WARNING, "Failed to write '%s': %s, retrying\n",
+               job->url, av_err2str(ret));
+        av_usleep(100000 << FFMIN(attempt, 4));
+    }
+    av_log(s, AV_LOG_ERROR, "Failed to write '%s': %s\n", job->url, av_err2str(ret));
+    return ret;
+}
+
+static void *upload_thread(void *arg)
+{
+    UploadQueue *q = arg;
+
+    pthread_mutex_lock(&q->mutex);
+    for (;;) {
+        UploadJob *job, **p;
+        int ret;
+
+        while (!(job = next_job(q)) && !q->abort)
+            pthread_cond_wait(&q->cond, &q->mutex);
+        if (!job)
+            break;
+        job->running = 1;
+        pthread_mutex_unlock(&q->mutex);
+
+        ret = upload_job(q, job);
+
+        pthread_mutex_lock(&q->mutex);
+        for (p = &q->jobs; *p != job; p = &(*p)->next)
+            av_assert0(*p);
+        *p = job->next;
+        q->size -= job->size;
+        q->nb_jobs--;
+        if (ret < 0 && !q->error)
+            q->error = ret;
+        job_free(&job);
+        pthread_cond_broadcast(&q->cond);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return NULL;
+}
+
+int ff_upload_queue_alloc(UploadQueue **pq, AVFormatContext *s, int nb_threads,
+                          int64_t max_size, int max_retries)
+{
+    UploadQueue *q;
+    int i, ret;
+
+    q = av_mallocz(sizeof(*q));
+    if (!q)
+        return AVERROR(ENOMEM);
+    q->s           = s;
+    q->max_size    = max_size;
+    q->max_retries = max_retries;
+    q->threads     = av_mallocz_array(nb_threads, sizeof(*q->threads));
+    if (!q->threads) {
+        av_free(q);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = pthread_mutex_init(&q->mutex, NULL))) {
+        av_free(q->threads);
+        av_free(q);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&q->cond, NULL))) {
+        pthread_mutex_destroy(&q->mutex);
+        av_free(q->threads);
+        av_free(q);
+        return AVERROR(ret);
+    }
+    for (i = 0; i < nb_threads; i++) {
+        ret = pthread_create(&q->threads[i], NULL, upload_thread, q);
+        if (ret)
+            break;
+        q->nb_threads++;
+    }
+    if (!q->nb_threads) {
+        ff_upload_queue_free(&q);
+        return AVERROR(ret);
+    }
+    *pq = q;
+    return 0;
+}
+
+int ff_upload_queue_open(UploadQueue *q, AVIOContext **pb, const char *url,
+                         int ordered, AVDictionary **options)
+{
+    UploadJob *job;
+    URLContext *h = NULL;
+    int ret;
+
+    job = av_mallocz(sizeof(*job));
+    if (!job)
+        return AVERROR(ENOMEM);
+    job->q       = q;
+    job->ordered = ordered;
+    job->url     = av_strdup(url);
+    if (!job->url || (options && av_dict_copy(&job->options, *options, 0) < 0) ||
+        !(h = av_mallocz(sizeof(*h)))) {
+        job_free(&job);
+        return AVERROR(ENOMEM);
+    }
+    h->av_class     = &ffurl_context_class;
+    h->prot         = &upload_queue_protocol;
+    h->priv_data    = job;
+    h->filename     = job->url;
+    h->flags        = AVIO_FLAG_WRITE;
+    h->is_connected = 1;
+
+    ret = ffio_fdopen(pb, h);
+    if (ret < 0) {
+        av_free(h);
+        job_free(&job);
+    }
+    return ret;
+}
+
+int ff_upload_queue_owns(AVIOContext *pb)
+{
+    URLContext *h = ffio_geturlcontext(pb);
+
+    return h && h->prot == &upload_queue_protocol;
+}
+
+int ff_upload_queue_flush(UploadQueue *q)
+{
+    int ret;
+
+    pthread_mutex_lock(&q->mutex);
+    while (q->jobs)
+        pthread_cond_wait(&q->cond, &q->mutex);
+    ret = q->error;
+    q->error = 0;
+    pthread_mutex_unlock(&q->mutex);
+    return ret;
+}
+
+void ff_upload_queue_free(UploadQueue **pq)
+{
+    UploadQueue *q = *pq;
+    UploadJob **p;
+    int i, dropped = 0;
+
+    if (!q)
+        return;
+
+    pthread_mutex_lock(&q->mutex);
+    for (p = &q->jobs; *p;) {
+        UploadJob *job = *p;
+        if (job->running) {
+            p = &job->next;
+            continue;
+        }
+        *p = job->next;
+        q->size -= job->size;
+        q->nb_jobs--;
+        job_free(&job);
+        dropped++;
+    }
+    q->abort = 1;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->mutex);
+
+    for (i = 0; i < q->nb_threads; i++)
+        pthread_join(q->threads[i], NULL);
+    if (dropped)
+        av_log(q->s, AV_LOG_WARNING, "%d queued files were not written\n", dropped);
+
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->mutex);
+    av_freep(&q->threads);
+    av_freep(pq);
+}
+
+#else
+
+int ff_upload_queue_alloc(UploadQueue **q, AVFormatContext *s, int nb_threads,
+                          int64_t max_size, int max_retries)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_upload_queue_open(UploadQueue *q, AVIOContext **pb, const char *url,
+                         int ordered, AVDictionary **options)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_upload_queue_owns(AVIOContext *pb)
+{
+    return 0;
+}
+
+int ff_upload_queue_flush(UploadQueue *q)
+{
+    return 0;
+}
+
+void ff_upload_queue_free(UploadQueue **q)
+{
+}
+
+#endif /* HAVE_THREADS */
@@ -0,0 +1,87 @@
+/*
+ * Background upload queue for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_UPLOADQUEUE_H
+#define AVFORMAT_UPLOADQUEUE_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avformat.h"
+
+/**
+ * A set of threads writing the files of a muxer in the background.
+ *
+ * A file opened through the queue is written to memory. Once it is closed,
+ * with avio_closep() or ff_format_io_close(), it is written out with
+ * s->io_open() by one of the threads, while the muxer goes on.
+ *
+ * Files are written in parallel, except that an ordered file, such as a
+ * playlist, is only written once all the files closed before it are done,
+ * and that the writes of a same URL are never concurrent. A file closed
+ * while an earlier version of it is still waiting in the queue replaces it.
+ *
+ * Closing a file returns the first error the threads met since it was last
+ * returned, so that write errors are reported to the muxer with a delay.
+ */
+typedef struct UploadQueue UploadQueue;
+
+/**
+ * Start the threads of a queue.
+ *
+ * @param s           muxer the files are written for, its io_open() and
+ *                    io_close() callbacks are called from the threads
+ * @param nb_threads  number of files written at once
+ * @param max_size    number of bytes waiting in the queue above which closing
+ *                    a file blocks until some of them are written
+ * @param max_retries number of times a failed write is retried
+ * @return 0 on success, AVERROR(ENOSYS) without thread support
+ */
+int ff_upload_queue_alloc(UploadQueue **q, AVFormatContext *s, int nb_threads,
+                          int64_t max_size, int max_retries);
+
+/**
+ * Open a file to be written by the queue once closed.
+ *
+ * @param ordered only write the file after all the files closed before it
+ * @param options options passed to s->io_open(), copied
+ */
+int ff_upload_queue_open(UploadQueue *q, AVIOContext **pb, const char *url,
+                         int ordered, AVDictionary **options);
+
+/**
+ * Check whether pb was opened with ff_upload_queue_open().
+ */
+int ff_upload_queue_owns(AVIOContext *pb);
+
+/**
+ * Wait until all the files closed so far are written.
+ *
+ * @return the first error met since the last call, 0 if there was none
+ */
+int ff_upload_queue_flush(UploadQueue *q);
+
+/**
+ * Stop the threads and free the queue. The files which were not being
+ * written yet are dropped.
+ */
+void ff_upload_queue_free(UploadQueue **q);
+
+#endif /* AVFORMAT_UPLOADQUEUE_H */
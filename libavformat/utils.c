@@ -311,6 +311,33 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     return append_packet_chunked(s, pkt, size);
 }
 
+int ff_get_packet_direct(AVIOContext *s, AVPacket *pkt, int size)
+{
+    int ret;
+
+    /* Small packets are cheaper to copy out of the IO buffer than to read
+     * on their own. Huge ones go through the chunked reading, which limits
+     * the allocation to what the input can actually hold. */
+    if (size < s->buffer_size || size > SANE_CHUNK_SIZE/10 || s->write_flag)
+        return av_get_packet(s, pkt, size);
+
+    if ((ret = av_new_packet(pkt, size)) < 0)
+        return ret;
+    pkt->pos = avio_tell(s);
+
+    ret = ffio_read_direct(s, pkt->data, size);
+    if (ret <= 0) {
+        av_packet_unref(pkt);
+        return ret;
+    }
+    if (ret < size) {
+        av_shrink_packet(pkt, ret);
+        pkt->flags |= AV_PKT_FLAG_CORRUPT;
+    }
+
+    return ret;
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     if (!pkt->size)
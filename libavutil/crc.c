@@ -24,7 +24,43 @@
 #include "avassert.h"
 #include "bswap.h"
 #include "common.h"
+#include "cpu.h"
 #include "crc.h"
+#include "mem.h"
+#if ARCH_X86
+#include "x86/cpu.h"
+#include "x86/crc.h"
+#endif
+
+/**
+ * Fill ctx with the byte table followed by nb_slices - 1 derived tables,
+ * slice k giving the CRC of a byte followed by k zero bytes.
+ */
+static void crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int nb_slices)
+{
+    unsigned i, j;
+    uint32_t c;
+
+    for (i = 0; i < 256; i++) {
+        if (le) {
+            for (c = i, j = 0; j < 8; j++)
+                c = (c >> 1) ^ (poly & (-(c & 1)));
+            ctx[i] = c;
+        } else {
+            for (c = i << 24, j = 0; j < 8; j++)
+                c = (c << 1) ^ ((poly << (32 - bits)) & (((int32_t) c) >> 31));
+            ctx[i] = av_bswap32(c);
+        }
+    }
+    ctx[256] = 1;
+#if !CONFIG_SMALL
+    if (nb_slices >= 4)
+        for (i = 0; i < 256; i++)
+            for (j = 0; j < nb_slices - 1; j++)
+                ctx[256 * (j + 1) + i] =
+                    (ctx[256 * j + i] >> 8) ^ ctx[ctx[256 * j + i] & 0xFF];
+#endif
+}
 
 #if CONFIG_HARDCODED_TABLES
 static const AVCRC av_crc_table[AV_CRC_MAX][257] = {
@@ -312,61 +348,88 @@ static const AVCRC av_crc_table[AV_CRC_MAX][257] = {
     },
 };
 #else
+static const struct {
+    uint8_t le, bits;
+    uint32_t poly;
+} crc_params[AV_CRC_MAX] = {
+    [AV_CRC_8_ATM]      = { 0,  8,       0x07 },
+    [AV_CRC_8_EBU]      = { 0,  8,       0x1D },
+    [AV_CRC_16_ANSI]    = { 0, 16,     0x8005 },
+    [AV_CRC_16_CCITT]   = { 0, 16,     0x1021 },
+    [AV_CRC_24_IEEE]    = { 0, 24,   0x864CFB },
+    [AV_CRC_32_IEEE]    = { 0, 32, 0x04C11DB7 },
+    [AV_CRC_32_IEEE_LE] = { 1, 32, 0xEDB88320 },
+    [AV_CRC_16_ANSI_LE] = { 1, 16,     0xA001 },
+};
+
 #if CONFIG_SMALL
 #define CRC_TABLE_SIZE 257
 #else
-#define CRC_TABLE_SIZE 1024
+/**
+ * The built-in tables start with a header, told apart from the tables of
+ * av_crc_init() by its first entry, the table type: there it is the CRC of
+ * a zero byte, always 0. The rest of the header holds the constants of the
+ * SIMD versions. It is followed by 8 slices, user tables have at most 4.
+ */
+#define CRC_HEADER_SIZE 24
+#define CRC_TABLE_SIZE (CRC_HEADER_SIZE + 8 * 256)
+
+enum CRCTableType {
+    CRC_TABLE_SLICES = 1,   ///< 8 slices
+    CRC_TABLE_CLMUL,        ///< 8 slices, the constants of crc_clmul() in the header
+};
+
+#if HAVE_CLMUL_INLINE
+static DECLARE_ALIGNED(16, AVCRC, crc_table_clmul)[AV_CRC_MAX][CRC_TABLE_SIZE];
 #endif
-static AVCRC av_crc_table[AV_CRC_MAX][CRC_TABLE_SIZE];
+#endif
+static DECLARE_ALIGNED(16, AVCRC, av_crc_table)[AV_CRC_MAX][CRC_TABLE_SIZE];
+
+static void crc_init_table(AVCRCId id)
+{
+    int le = crc_params[id].le, bits = crc_params[id].bits;
+    uint32_t poly = crc_params[id].poly;
 
-#define DECLARE_CRC_INIT_TABLE_ONCE(id, le, bits, poly)                                       \
+#if CONFIG_SMALL
+    crc_init(av_crc_table[id], le, bits, poly, 1);
+#else
+    av_crc_table[id][0] = CRC_TABLE_SLICES;
+    crc_init(av_crc_table[id] + CRC_HEADER_SIZE, le, bits, poly, 8);
+#if HAVE_CLMUL_INLINE
+    memcpy(crc_table_clmul[id], av_crc_table[id], sizeof(av_crc_table[id]));
+    crc_table_clmul[id][0] = CRC_TABLE_CLMUL;
+    crc_clmul_init(crc_table_clmul[id], le, bits, poly);
+#endif
+#endif
+}
+
+#define DECLARE_CRC_INIT_TABLE_ONCE(id)                                                       \
 static AVOnce id ## _once_control = AV_ONCE_INIT;                                             \
 static void id ## _init_table_once(void)                                                      \
 {                                                                                             \
-    av_assert0(av_crc_init(av_crc_table[id], le, bits, poly, sizeof(av_crc_table[id])) >= 0); \
+    crc_init_table(id);                                                                       \
 }
 
 #define CRC_INIT_TABLE_ONCE(id) ff_thread_once(&id ## _once_control, id ## _init_table_once)
 
-DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_8_ATM,      0,  8,       0x07)
-DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_8_EBU,      0,  8,       0x1D)
-DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_16_ANSI,    0, 16,     0x8005)
-DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_16_CCITT,   0, 16,     0x1021)
-DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_24_IEEE,    0, 24,   0x864CFB)
-DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_32_IEEE,    0, 32, 0x04C11DB7)
-DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_32_IEEE_LE, 1, 32, 0xEDB88320)
-DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_16_ANSI_LE, 1, 16,     0xA001)
+DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_8_ATM)
+DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_8_EBU)
+DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_16_ANSI)
+DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_16_CCITT)
+DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_24_IEEE)
+DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_32_IEEE)
+DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_32_IEEE_LE)
+DECLARE_CRC_INIT_TABLE_ONCE(AV_CRC_16_ANSI_LE)
 #endif
 
 int av_crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size)
 {
-    unsigned i, j;
-    uint32_t c;
-
     if (bits < 8 || bits > 32 || poly >= (1LL << bits))
         return AVERROR(EINVAL);
     if (ctx_size != sizeof(AVCRC) * 257 && ctx_size != sizeof(AVCRC) * 1024)
         return AVERROR(EINVAL);
 
-    for (i = 0; i < 256; i++) {
-        if (le) {
-            for (c = i, j = 0; j < 8; j++)
-                c = (c >> 1) ^ (poly & (-(c & 1)));
-            ctx[i] = c;
-        } else {
-            for (c = i << 24, j = 0; j < 8; j++)
-                c = (c << 1) ^ ((poly << (32 - bits)) & (((int32_t) c) >> 31));
-            ctx[i] = av_bswap32(c);
-        }
-    }
-    ctx[256] = 1;
-#if !CONFIG_SMALL
-    if (ctx_size >= sizeof(AVCRC) * 1024)
-        for (i = 0; i < 256; i++)
-            for (j = 0; j < 3; j++)
-                ctx[256 * (j + 1) + i] =
-                    (ctx[256 * j + i] >> 8) ^ ctx[ctx[256 * j + i] & 0xFF];
-#endif
+    crc_init(ctx, le, bits, poly, ctx_size / (256 * sizeof(AVCRC)));
 
     return 0;
 }
@@ -385,6 +448,10 @@ const AVCRC *av_crc_get_table(AVCRCId crc_id)
     case AV_CRC_16_ANSI_LE: CRC_INIT_TABLE_ONCE(AV_CRC_16_ANSI_LE); break;
     default: av_assert0(0);
     }
+#if HAVE_CLMUL_INLINE && !CONFIG_SMALL
+    if (INLINE_CLMUL(av_get_cpu_flags()))
+        return crc_table_clmul[crc_id];
+#endif
 #endif
     return av_crc_table[crc_id];
 }
@@ -395,10 +462,39 @@ uint32_t av_crc(const AVCRC *ctx, uint32_t crc,
     const uint8_t *end = buffer + length;
 
 #if !CONFIG_SMALL
-    if (!ctx[256]) {
+    int nb_slices = ctx[256] ? 1 : 4;
+
+#if !CONFIG_HARDCODED_TABLES
+    if (ctx[0]) {
+#if HAVE_CLMUL_INLINE
+        if (ctx[0] == CRC_TABLE_CLMUL)
+            buffer += crc_clmul(ctx, &crc, buffer, length);
+#endif
+        ctx      += CRC_HEADER_SIZE;
+        nb_slices = 8;
+    }
+#endif
+
+    if (nb_slices > 1) {
         while (((intptr_t) buffer & 3) && buffer < end)
             crc = ctx[((uint8_t) crc) ^ *buffer++] ^ (crc >> 8);
 
+        if (nb_slices == 8) {
+            while (buffer < end - 7) {
+                uint32_t lo = crc ^ av_le2ne32(*(const uint32_t *)  buffer);
+                uint32_t hi =       av_le2ne32(*(const uint32_t *) (buffer + 4));
+                buffer += 8;
+                crc = ctx[7 * 256 + ( lo        & 0xFF)] ^
+                      ctx[6 * 256 + ((lo >> 8 ) & 0xFF)] ^
+                      ctx[5 * 256 + ((lo >> 16) & 0xFF)] ^
+                      ctx[4 * 256 + ((lo >> 24)       )] ^
+                      ctx[3 * 256 + ( hi        & 0xFF)] ^
+                      ctx[2 * 256 + ((hi >> 8 ) & 0xFF)] ^
+                      ctx[1 * 256 + ((hi >> 16) & 0xFF)] ^
+                      ctx[0 * 256 + ((hi >> 24)       )];
+            }
+        }
+
         while (buffer < end - 3) {
             crc ^= av_le2ne32(*(const uint32_t *) buffer); buffer += 4;
             crc = ctx[3 * 256 + ( crc        & 0xFF)] ^
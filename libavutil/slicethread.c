@@ -18,6 +18,8 @@
 
 #include <stdatomic.h>
 #include "slicethread.h"
+#include "threadpool.h"
+#include "cpu.h"
 #include "mem.h"
 #include "thread.h"
 #include "avassert.h"
@@ -48,8 +50,36 @@ struct AVSliceThread {
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
+
+    /* contexts using the process-wide pool, protected by the pool mutex */
+    int             shared;
+    int             nb_slots;       ///< number of pool threads still welcome
+    int             nb_helpers;     ///< number of pool threads running jobs
+    AVSliceThread   *next;          ///< next context waiting for help
 };
 
+/* Process-wide pool: idle threads help whichever shared context is waiting
+   for its jobs to be run. The threads only exist while shared contexts do.
+   The pool size also bounds the number of threads running at once among
+   the pool threads and the threads holding a slot of the pool, see
+   avpriv_thread_pool_enter(). The mutex also protects the nb_slots,
+   nb_helpers and next fields of the queued contexts. */
+static AVOnce          pool_once = AV_ONCE_INIT;
+static AVMutex         pool_resize_mutex = AV_MUTEX_INITIALIZER;
+static pthread_mutex_t pool_mutex;
+static pthread_cond_t  pool_cond;
+static pthread_t       *pool_threads;       ///< protected by pool_resize_mutex
+static int             pool_nb_threads;     ///< protected by pool_resize_mutex
+static int             pool_users;          ///< protected by pool_resize_mutex
+static int             pool_nb_wanted;      ///< number of threads to keep
+static int             pool_size = -1;
+static int             pool_nb_running;     ///< number of slots in use
+static pthread_t       *pool_holders;       ///< threads holding a slot
+static unsigned        pool_holders_size;
+static atomic_int      pool_nb_holders;
+static atomic_int      pool_enabled;
+static AVSliceThread   *pool_queue;
+
 static int run_jobs(AVSliceThread *ctx)
 {
     unsigned nb_jobs    = ctx->nb_jobs;
@@ -64,6 +94,214 @@ static int run_jobs(AVSliceThread *ctx)
     return current_job == nb_jobs + nb_active_threads - 1;
 }
 
+/* Jobs are not assigned to threads beforehand: the pool threads joining
+   the execution are not known in advance. */
+static void run_shared_jobs(AVSliceThread *ctx)
+{
+    unsigned nb_jobs  = ctx->nb_jobs;
+    unsigned threadnr = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
+    unsigned current_job;
+
+    while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs)
+        ctx->worker_func(ctx->priv, current_job, threadnr, nb_jobs, ctx->nb_active_threads);
+}
+
+static void pool_init(void)
+{
+    pthread_mutex_init(&pool_mutex, NULL);
+    pthread_cond_init(&pool_cond, NULL);
+}
+
+static void pool_dequeue(AVSliceThread *ctx)
+{
+    AVSliceThread **p = &pool_queue;
+
+    while (*p && *p != ctx)
+        p = &(*p)->next;
+    if (*p)
+        *p = ctx->next;
+    ctx->next = NULL;
+}
+
+static void pool_release_slot(void)
+{
+    /* wake up the threads waiting for a slot, if one just became free */
+    if (--pool_nb_running == pool_size - 1)
+        pthread_cond_broadcast(&pool_cond);
+}
+
+static void *attribute_align_arg pool_worker(void *v)
+{
+    int index = (intptr_t)v;
+
+    pthread_mutex_lock(&pool_mutex);
+    while (index < pool_nb_wanted) {
+        AVSliceThread *ctx = pool_queue;
+
+        if (!ctx || pool_nb_running >= pool_size) {
+            pthread_cond_wait(&pool_cond, &pool_mutex);
+            continue;
+        }
+        if (!--ctx->nb_slots)
+            pool_dequeue(ctx);
+        ctx->nb_helpers++;
+        pool_nb_running++;
+        pthread_mutex_unlock(&pool_mutex);
+
+        run_shared_jobs(ctx);
+
+        pthread_mutex_lock(&pool_mutex);
+        pool_release_slot();
+        if (!--ctx->nb_helpers)
+            pthread_cond_signal(&ctx->done_cond);
+    }
+    pthread_mutex_unlock(&pool_mutex);
+    return NULL;
+}
+
+/**
+ * Start or stop pool threads, so that pool_size of them run while shared
+ * contexts exist, and none otherwise. Must be called with pool_resize_mutex
+ * held.
+ */
+static int pool_update(void)
+{
+    int nb_wanted = pool_users ? FFMAX(pool_size, 0) : 0;
+    pthread_t *threads;
+    int i, ret = 0;
+
+    pthread_mutex_lock(&pool_mutex);
+    pool_nb_wanted = nb_wanted;
+    if (nb_wanted < pool_nb_threads) {
+        pthread_cond_broadcast(&pool_cond);
+        pthread_mutex_unlock(&pool_mutex);
+        /* the threads only leave between two jobs */
+        for (i = nb_wanted; i < pool_nb_threads; i++)
+            pthread_join(pool_threads[i], NULL);
+        pthread_mutex_lock(&pool_mutex);
+        pool_nb_threads = nb_wanted;
+        if (!pool_nb_threads)
+            av_freep(&pool_threads);
+    } else if (nb_wanted > pool_nb_threads) {
+        threads = av_realloc_array(pool_threads, nb_wanted, sizeof(*threads));
+        if (!threads) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        pool_threads = threads;
+        for (i = pool_nb_threads; i < nb_wanted; i++) {
+            if ((ret = pthread_create(&pool_threads[i], NULL, pool_worker,
+                                      (void *)(intptr_t)i))) {
+                ret = AVERROR(ret);
+                break;
+            }
+            pool_nb_threads++;
+        }
+    }
+    if (!pool_users && !atomic_load_explicit(&pool_nb_holders, memory_order_relaxed)) {
+        av_freep(&pool_holders);
+        pool_holders_size = 0;
+    }
+end:
+    pthread_mutex_unlock(&pool_mutex);
+    return ret;
+}
+
+int av_thread_pool_set_size(int nb_threads)
+{
+    int ret;
+
+    ff_thread_once(&pool_once, pool_init);
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+    nb_threads = FFMAX(nb_threads, -1);
+
+    ff_mutex_lock(&pool_resize_mutex);
+    pthread_mutex_lock(&pool_mutex);
+    pool_size = nb_threads;
+    atomic_store_explicit(&pool_enabled, nb_threads >= 0, memory_order_relaxed);
+    /* threads waiting for a slot may run now, or without one */
+    pthread_cond_broadcast(&pool_cond);
+    pthread_mutex_unlock(&pool_mutex);
+    ret = pool_update();
+    ff_mutex_unlock(&pool_resize_mutex);
+    return ret;
+}
+
+/* Must be called with pool_mutex held. */
+static int pool_add_holder(pthread_t self)
+{
+    int nb_holders = atomic_load_explicit(&pool_nb_holders, memory_order_relaxed);
+    pthread_t *holders = av_fast_realloc(pool_holders, &pool_holders_size,
+                                         (nb_holders + 1) * sizeof(*holders));
+
+    /* the thread then runs without being counted */
+    if (!holders)
+        return 0;
+    pool_holders = holders;
+    pool_holders[nb_holders] = self;
+    atomic_store_explicit(&pool_nb_holders, nb_holders + 1, memory_order_relaxed);
+    pool_nb_running++;
+    return 1;
+}
+
+int avpriv_thread_pool_enter(void)
+{
+    pthread_t self = pthread_self();
+    int i, nb_holders, ret = 0;
+
+    if (!atomic_load_explicit(&pool_enabled, memory_order_relaxed))
+        return 0;
+
+    pthread_mutex_lock(&pool_mutex);
+    nb_holders = atomic_load_explicit(&pool_nb_holders, memory_order_relaxed);
+    for (i = 0; i < nb_holders; i++)
+        if (pthread_equal(pool_holders[i], self))
+            goto end;
+    while (pool_size >= 0 && pool_nb_running >= pool_size)
+        pthread_cond_wait(&pool_cond, &pool_mutex);
+    if (pool_size >= 0)
+        ret = pool_add_holder(self);
+end:
+    pthread_mutex_unlock(&pool_mutex);
+    return ret;
+}
+
+int avpriv_thread_pool_leave(void)
+{
+    pthread_t self = pthread_self();
+    int i, nb_holders, ret = 0;
+
+    /* a thread always sees its own slot */
+    if (!atomic_load_explicit(&pool_nb_holders, memory_order_relaxed))
+        return 0;
+
+    pthread_mutex_lock(&pool_mutex);
+    nb_holders = atomic_load_explicit(&pool_nb_holders, memory_order_relaxed);
+    for (i = 0; i < nb_holders; i++) {
+        if (pthread_equal(pool_holders[i], self)) {
+            pool_holders[i] = pool_holders[--nb_holders];
+            atomic_store_explicit(&pool_nb_holders, nb_holders, memory_order_relaxed);
+            pool_release_slot();
+            ret = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_mutex);
+    return ret;
+}
+
+void avpriv_thread_pool_resume(int left)
+{
+    if (!left)
+        return;
+    /* waiting for a slot here could deadlock: the threads holding all of
+       them may be waiting for a lock the caller holds */
+    pthread_mutex_lock(&pool_mutex);
+    pool_add_holder(pthread_self());
+    pthread_mutex_unlock(&pool_mutex);
+}
+
 static void *attribute_align_arg thread_worker(void *v)
 {
     WorkerContext *w = v;
@@ -116,6 +354,17 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     if (!ctx)
         return AVERROR(ENOMEM);
 
+    /* main_func may wait for the jobs: it needs threads of its own */
+    ff_thread_once(&pool_once, pool_init);
+    ff_mutex_lock(&pool_resize_mutex);
+    ctx->shared = pool_size >= 0 && !main_func;
+    /* if no pool thread can be started, the jobs run on the calling thread */
+    if (ctx->shared && !pool_users++)
+        pool_update();
+    ff_mutex_unlock(&pool_resize_mutex);
+    if (ctx->shared)
+        nb_workers = 0;
+
     if (nb_workers && !(ctx->workers = av_calloc(nb_workers, sizeof(*ctx->workers)))) {
         av_freep(pctx);
         return AVERROR(ENOMEM);
@@ -168,6 +417,34 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     av_assert0(nb_jobs > 0);
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
+
+    if (ctx->shared) {
+        atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
+        atomic_store_explicit(&ctx->current_job, 0, memory_order_relaxed);
+        if (ctx->nb_active_threads > 1) {
+            AVSliceThread **p = &pool_queue;
+
+            pthread_mutex_lock(&pool_mutex);
+            ctx->nb_slots = ctx->nb_active_threads - 1;
+            while (*p)
+                p = &(*p)->next;
+            *p = ctx;
+            pthread_cond_broadcast(&pool_cond);
+            pthread_mutex_unlock(&pool_mutex);
+        }
+
+        run_shared_jobs(ctx);
+
+        if (ctx->nb_active_threads > 1) {
+            pthread_mutex_lock(&pool_mutex);
+            if (ctx->nb_slots)
+                pool_dequeue(ctx);
+            while (ctx->nb_helpers)
+                pthread_cond_wait(&ctx->done_cond, &pool_mutex);
+            pthread_mutex_unlock(&pool_mutex);
+        }
+        return;
+    }
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
     atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads, memory_order_relaxed);
     nb_workers             = ctx->nb_active_threads;
@@ -208,6 +485,8 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
     nb_workers = ctx->nb_threads;
     if (!ctx->main_func)
         nb_workers--;
+    if (ctx->shared)
+        nb_workers = 0;
 
     ctx->finished = 1;
     for (i = 0; i < nb_workers; i++) {
@@ -225,6 +504,13 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
         pthread_mutex_destroy(&w->mutex);
     }
 
+    if (ctx->shared) {
+        ff_mutex_lock(&pool_resize_mutex);
+        if (!--pool_users)
+            pool_update();
+        ff_mutex_unlock(&pool_resize_mutex);
+    }
+
     pthread_cond_destroy(&ctx->done_cond);
     pthread_mutex_destroy(&ctx->done_mutex);
     av_freep(&ctx->workers);
@@ -233,6 +519,25 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
 
 #else /* HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS32THREADS */
 
+int av_thread_pool_set_size(int nb_threads)
+{
+    return nb_threads > 0 ? AVERROR(ENOSYS) : 0;
+}
+
+int avpriv_thread_pool_enter(void)
+{
+    return 0;
+}
+
+int avpriv_thread_pool_leave(void)
+{
+    return 0;
+}
+
+void avpriv_thread_pool_resume(int left)
+{
+}
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
@@ -49,4 +49,28 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
  */
 void avpriv_slicethread_free(AVSliceThread **pctx);
 
+/**
+ * Wait for a slot of the process-wide thread pool, before running a task
+ * on a thread of its own, so that no more threads than the pool size run
+ * at the same time. Must not be called while holding a lock other threads
+ * of the pool may wait for.
+ * @return 1 if the calling thread now holds a slot, 0 if the pool is
+ *         disabled or the thread already holds one
+ */
+int avpriv_thread_pool_enter(void);
+
+/**
+ * Give back the pool slot of the calling thread, after running a task or
+ * before waiting for another thread.
+ * @return 1 if the calling thread held a slot, 0 otherwise
+ */
+int avpriv_thread_pool_leave(void);
+
+/**
+ * Take back a slot given back before waiting for another thread, without
+ * waiting for it to be free.
+ * @param left value returned by avpriv_thread_pool_leave()
+ */
+void avpriv_thread_pool_resume(int left);
+
 #endif
@@ -19,29 +19,58 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "libavutil/cpu.h"
 #include "libavutil/crc.h"
 
+static const struct {
+    int le, bits;
+    uint32_t poly;
+} crcs[AV_CRC_MAX] = {
+    [AV_CRC_8_ATM]      = { 0,  8,       0x07 },
+    [AV_CRC_8_EBU]      = { 0,  8,       0x1D },
+    [AV_CRC_16_ANSI]    = { 0, 16,     0x8005 },
+    [AV_CRC_16_CCITT]   = { 0, 16,     0x1021 },
+    [AV_CRC_24_IEEE]    = { 0, 24,   0x864CFB },
+    [AV_CRC_32_IEEE]    = { 0, 32, 0x04C11DB7 },
+    [AV_CRC_32_IEEE_LE] = { 1, 32, 0xEDB88320 },
+    [AV_CRC_16_ANSI_LE] = { 1, 16,     0xA001 },
+};
+
 int main(void)
 {
     uint8_t buf[1999];
-    int i;
-    static const unsigned p[7][3] = {
-        { AV_CRC_32_IEEE_LE, 0xEDB88320, 0x3D5CDD04 },
-        { AV_CRC_32_IEEE   , 0x04C11DB7, 0xC0F5BAE0 },
-        { AV_CRC_24_IEEE   , 0x864CFB  , 0xB704CE   },
-        { AV_CRC_16_ANSI_LE, 0xA001    , 0xBFD8     },
-        { AV_CRC_16_ANSI   , 0x8005    , 0x1FBB     },
-        { AV_CRC_8_ATM     , 0x07      , 0xE3       },
-        { AV_CRC_8_EBU     , 0x1D      , 0xD6       },
-    };
+    AVCRC ref[257];
     const AVCRC *ctx;
+    int i, id, cpu, ret = 0;
 
     for (i = 0; i < sizeof(buf); i++)
         buf[i] = i + i * i;
 
-    for (i = 0; i < 7; i++) {
-        ctx = av_crc_get_table(p[i][0]);
-        printf("crc %08X = %X\n", p[i][1], av_crc(ctx, 0, buf, sizeof(buf)));
+    for (id = 0; id < AV_CRC_MAX; id++) {
+        ctx = av_crc_get_table(id);
+        printf("crc %08X = %X\n", crcs[id].poly, av_crc(ctx, 0, buf, sizeof(buf)));
+    }
+
+    /* the built-in tables, with and without the SIMD versions, must match a
+     * bytewise table for any alignment and tail */
+    for (cpu = 0; cpu < 2; cpu++) {
+        av_force_cpu_flags(cpu ? 0 : -1);
+        for (id = 0; id < AV_CRC_MAX; id++) {
+            int offset, len;
+            ctx = av_crc_get_table(id);
+            av_crc_init(ref, crcs[id].le, crcs[id].bits, crcs[id].poly, sizeof(ref));
+            for (offset = 0; offset < 8; offset++)
+                for (len = 0; len <= 300; len = len < 80 ? len + 1 : len * 5 / 4 + 1)
+                    if (av_crc(ctx, id, buf + offset, len) != av_crc(ref, id, buf + offset, len)) {
+                        fprintf(stderr, "crc %08X mismatch at offset %d len %d%s\n",
+                                crcs[id].poly, offset, len, cpu ? " without SIMD" : "");
+                        ret = 1;
+                    }
+            if (av_crc(ctx, id, buf, sizeof(buf)) != av_crc(ref, id, buf, sizeof(buf))) {
+                fprintf(stderr, "crc %08X mismatch%s\n", crcs[id].poly, cpu ? " without SIMD" : "");
+                ret = 1;
+            }
+        }
     }
-    return 0;
+    return ret;
 }
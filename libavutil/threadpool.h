@@ -0,0 +1,67 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_THREADPOOL_H
+#define AVUTIL_THREADPOOL_H
+
+/**
+ * @file
+ * @ingroup lavu_threadpool
+ * Process-wide thread pool
+ */
+
+/**
+ * @defgroup lavu_threadpool Thread pool
+ * @ingroup lavu_misc
+ *
+ * By default, every codec, filter or scaling context using slice threading
+ * starts its own threads. Once a process-wide pool is enabled, the slice
+ * threading contexts created afterwards start no thread of their own: the
+ * slices are processed by the thread requesting them, helped by the idle
+ * threads of the pool. The number of threads started for slice threading
+ * in the whole process is then bounded by the size of the pool.
+ *
+ * Frame threading of decoders and encoders and the frame threads of filter
+ * graphs keep threads of their own, as they wait for each other's progress,
+ * but they share the slots of the pool with its threads: no more threads
+ * than the pool size run at the same time. A thread waiting for another one
+ * gives its slot back meanwhile.
+ *
+ * The threads of the pool only exist while slice threading contexts use it.
+ *
+ * @{
+ */
+
+/**
+ * Enable or resize the process-wide thread pool.
+ *
+ * This function is thread-safe. A pool that is shrunk waits for the jobs
+ * its removed threads are running.
+ *
+ * @param nb_threads maximum number of threads of the pool, 0 for the number
+ *                   of CPUs, negative to disable the pool: contexts created
+ *                   afterwards start their own threads again
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int av_thread_pool_set_size(int nb_threads);
+
+/**
+ * @}
+ */
+
+#endif /* AVUTIL_THREADPOOL_H */
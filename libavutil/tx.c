@@ -91,17 +91,50 @@ int ff_tx_gen_compound_mapping(AVTXContext *s)
     return 0;
 }
 
-int ff_tx_gen_ptwo_revtab(AVTXContext *s)
+static const int avx_tab[] = {
+    0, 4, 1, 5, 8, 12, 9, 13, 2, 6, 3, 7, 10, 14, 11, 15
+};
+
+static int is_second_half_of_fft32(int i, int n)
+{
+    if (n <= 32)
+        return i >= 16;
+    else if (i < n/2)
+        return is_second_half_of_fft32(i, n/2);
+    else if (i < 3*n/4)
+        return is_second_half_of_fft32(i - n/2, n/4);
+    else
+        return is_second_half_of_fft32(i - 3*n/4, n/4);
+}
+
+int ff_tx_gen_ptwo_revtab(AVTXContext *s, enum TXPermutation perm)
 {
     const int m = s->m, inv = s->inv;
 
     if (!(s->revtab = av_malloc(m*sizeof(*s->revtab))))
         return AVERROR(ENOMEM);
 
-    /* Default */
+    if (perm == FF_TX_PERM_AVX) {
+        /* The AVX FFT keeps 8 wide blocks and handles the second half of each
+         * 32 point sub-transform differently */
+        for (int i = 0; i < m; i += 16) {
+            for (int k = 0; k < 16; k++) {
+                int j = i + k;
+                if (is_second_half_of_fft32(i, m))
+                    j = i + avx_tab[k];
+                else
+                    j = (j & ~7) | ((j >> 1) & 3) | ((j << 2) & 4);
+                s->revtab[-split_radix_permutation(i + k, m, inv) & (m - 1)] = j;
+            }
+        }
+        return 0;
+    }
+
     for (int i = 0; i < m; i++) {
-        int k = -split_radix_permutation(i, m, inv) & (m - 1);
-        s->revtab[k] = i;
+        int j = i, k = -split_radix_permutation(i, m, inv) & (m - 1);
+        if (perm == FF_TX_PERM_SWAP_LSBS)
+            j = (j & ~3) | ((j >> 1) & 1) | ((j << 1) & 2);
+        s->revtab[k] = j;
     }
 
     return 0;
@@ -112,12 +112,26 @@ struct AVTXContext {
     FFTComplex *tmp;    /* Temporary buffer needed for all compound transforms */
     int        *pfatab; /* Input/Output mapping for compound transforms */
     int        *revtab; /* Input mapping for power of two transforms */
+
+    /* Power of two FFT on input permuted via revtab, set by SIMD init */
+    void (*ptwo_fft)(FFTComplex *z, int nbits);
+
+    /* In-place MDCT or IMDCT post-rotation of the FFT output, set by SIMD
+     * init, only used for power of two transforms with a contiguous output */
+    void (*mdct_postrot)(FFTComplex *z, const FFTComplex *exp, int len8);
+};
+
+/* Input permutations required by the power of two FFTs */
+enum TXPermutation {
+    FF_TX_PERM_DEFAULT,
+    FF_TX_PERM_SWAP_LSBS,
+    FF_TX_PERM_AVX,
 };
 
 /* Shared functions */
 int ff_tx_type_is_mdct(enum AVTXType type);
 int ff_tx_gen_compound_mapping(AVTXContext *s);
-int ff_tx_gen_ptwo_revtab(AVTXContext *s);
+int ff_tx_gen_ptwo_revtab(AVTXContext *s, enum TXPermutation perm);
 
 /* Also used by SIMD init */
 static inline int split_radix_permutation(int i, int n, int inverse)
@@ -146,6 +160,10 @@ int ff_tx_init_mdct_fft_int32(AVTXContext *s, av_tx_fn *tx,
                               enum AVTXType type, int inv, int len,
                               const void *scale, uint64_t flags);
 
+/* Sets ptwo_fft and mdct_postrot if possible, returns the input permutation
+ * ptwo_fft needs */
+enum TXPermutation ff_tx_init_float_x86(AVTXContext *s);
+
 typedef struct CosTabsInitOnce {
     void (*func)(void);
     AVOnce control;
@@ -359,6 +359,15 @@ static void (* const fft_dispatch[])(FFTComplex*) = {
     fft1024, fft2048, fft4096, fft8192, fft16384, fft32768, fft65536, fft131072
 };
 
+static av_always_inline void fft_ptwo(AVTXContext *s, FFTComplex *z)
+{
+    const int mb = av_log2(s->m);
+    if (s->ptwo_fft)
+        s->ptwo_fft(z, mb);
+    else
+        fft_dispatch[mb](z);
+}
+
 #define DECL_COMP_FFT(N)                                                       \
 static void compound_fft_##N##xM(AVTXContext *s, void *_out,                   \
                                  void *_in, ptrdiff_t stride)                  \
@@ -367,7 +376,6 @@ static void compound_fft_##N##xM(AVTXContext *s, void *_out,                   \
     FFTComplex *in = _in;                                                      \
     FFTComplex *out = _out;                                                    \
     FFTComplex fft##N##in[N];                                                  \
-    void (*fftp)(FFTComplex *z) = fft_dispatch[av_log2(m)];                    \
                                                                                \
     for (int i = 0; i < m; i++) {                                              \
         for (int j = 0; j < N; j++)                                            \
@@ -376,7 +384,7 @@ static void compound_fft_##N##xM(AVTXContext *s, void *_out,                   \
     }                                                                          \
                                                                                \
     for (int i = 0; i < N; i++)                                                \
-        fftp(s->tmp + m*i);                                                    \
+        fft_ptwo(s, s->tmp + m*i);                                             \
                                                                                \
     for (int i = 0; i < N*m; i++)                                              \
         out[i] = s->tmp[out_map[i]];                                           \
@@ -391,10 +399,10 @@ static void monolithic_fft(AVTXContext *s, void *_out, void *_in,
 {
     FFTComplex *in = _in;
     FFTComplex *out = _out;
-    int m = s->m, mb = av_log2(m);
+    int m = s->m;
     for (int i = 0; i < m; i++)
         out[s->revtab[i]] = in[i];
-    fft_dispatch[mb](out);
+    fft_ptwo(s, out);
 }
 
 #define DECL_COMP_IMDCT(N)                                                     \
@@ -406,7 +414,6 @@ static void compound_imdct_##N##xM(AVTXContext *s, void *_dst, void *_src,     \
     const int m = s->m, len8 = N*m >> 1;                                       \
     const int *in_map = s->pfatab, *out_map = in_map + N*m;                    \
     const FFTSample *src = _src, *in1, *in2;                                   \
-    void (*fftp)(FFTComplex *) = fft_dispatch[av_log2(m)];                     \
                                                                                \
     stride /= sizeof(*src); /* To convert it from bytes */                     \
     in1 = src;                                                                 \
@@ -422,7 +429,7 @@ static void compound_imdct_##N##xM(AVTXContext *s, void *_dst, void *_src,     \
     }                                                                          \
                                                                                \
     for (int i = 0; i < N; i++)                                                \
-        fftp(s->tmp + m*i);                                                    \
+        fft_ptwo(s, s->tmp + m*i);                                             \
                                                                                \
     for (int i = 0; i < len8; i++) {                                           \
         const int i0 = len8 + i, i1 = len8 - i - 1;                            \
@@ -447,7 +454,6 @@ static void compound_mdct_##N##xM(AVTXContext *s, void *_dst, void *_src,      \
     FFTComplex *exp = s->exptab, tmp, fft##N##in[N];                           \
     const int m = s->m, len4 = N*m, len3 = len4 * 3, len8 = len4 >> 1;         \
     const int *in_map = s->pfatab, *out_map = in_map + N*m;                    \
-    void (*fftp)(FFTComplex *) = fft_dispatch[av_log2(m)];                     \
                                                                                \
     stride /= sizeof(*dst);                                                    \
                                                                                \
@@ -468,7 +474,7 @@ static void compound_mdct_##N##xM(AVTXContext *s, void *_dst, void *_src,      \
     }                                                                          \
                                                                                \
     for (int i = 0; i < N; i++)                                                \
-        fftp(s->tmp + m*i);                                                    \
+        fft_ptwo(s, s->tmp + m*i);                                             \
                                                                                \
     for (int i = 0; i < len8; i++) {                                           \
         const int i0 = len8 + i, i1 = len8 - i - 1;                            \
@@ -493,7 +499,6 @@ static void monolithic_imdct(AVTXContext *s, void *_dst, void *_src,
     FFTComplex *z = _dst, *exp = s->exptab;
     const int m = s->m, len8 = m >> 1;
     const FFTSample *src = _src, *in1, *in2;
-    void (*fftp)(FFTComplex *) = fft_dispatch[av_log2(m)];
 
     stride /= sizeof(*src);
     in1 = src;
@@ -504,7 +509,12 @@ static void monolithic_imdct(AVTXContext *s, void *_dst, void *_src,
         CMUL3(z[s->revtab[i]], tmp, exp[i]);
     }
 
-    fftp(z);
+    fft_ptwo(s, z);
+
+    if (s->mdct_postrot) {
+        s->mdct_postrot(z, exp, len8);
+        return;
+    }
 
     for (int i = 0; i < len8; i++) {
         const int i0 = len8 + i, i1 = len8 - i - 1;
@@ -522,7 +532,6 @@ static void monolithic_mdct(AVTXContext *s, void *_dst, void *_src,
     FFTSample *src = _src, *dst = _dst;
     FFTComplex *exp = s->exptab, tmp, *z = _dst;
     const int m = s->m, len4 = m, len3 = len4 * 3, len8 = len4 >> 1;
-    void (*fftp)(FFTComplex *) = fft_dispatch[av_log2(m)];
 
     stride /= sizeof(*dst);
 
@@ -539,7 +548,12 @@ static void monolithic_mdct(AVTXContext *s, void *_dst, void *_src,
              exp[i].re, exp[i].im);
     }
 
-    fftp(z);
+    fft_ptwo(s, z);
+
+    if (s->mdct_postrot && stride == 1) {
+        s->mdct_postrot(z, exp, len8);
+        return;
+    }
 
     for (int i = 0; i < len8; i++) {
         const int i0 = len8 + i, i1 = len8 - i - 1;
@@ -627,7 +641,12 @@ int TX_NAME(ff_tx_init_mdct_fft)(AVTXContext *s, av_tx_fn *tx,
     if (n != 1)
         init_cos_tabs(0);
     if (m != 1) {
-        ff_tx_gen_ptwo_revtab(s);
+        enum TXPermutation perm = FF_TX_PERM_DEFAULT;
+#if defined(TX_FLOAT) && ARCH_X86 && HAVE_X86ASM
+        perm = ff_tx_init_float_x86(s);
+#endif
+        if ((err = ff_tx_gen_ptwo_revtab(s, perm)))
+            return err;
         for (int i = 4; i <= av_log2(m); i++)
             init_cos_tabs(i);
     }
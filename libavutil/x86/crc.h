@@ -0,0 +1,286 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * CRC computation by folding with carry-less multiplications, after
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+ * (Intel, 2009).
+ */
+
+#ifndef AVUTIL_X86_CRC_H
+#define AVUTIL_X86_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "libavutil/bswap.h"
+#include "libavutil/crc.h"
+#include "libavutil/reverse.h"
+#include "libavutil/x86/asm.h"
+
+#if HAVE_CLMUL_INLINE
+
+/**
+ * Number of table entries used by crc_clmul_init(), the table must be
+ * 16-byte aligned. Entry 0 is left to the caller, entry 1 tells the bit
+ * order, the constants start at entry 4.
+ */
+#define CRC_CLMUL_SIZE 24
+
+/* Any CRC of up to 32 bits is computed as a 32-bit one: a big-endian CRC of
+ * n bits uses the polynomial multiplied by x^(32 - n), and a little-endian
+ * one already runs in the low bits of a 32-bit register. The polynomials P
+ * below are given without their x^32 term. */
+
+/* x^e mod P */
+static uint32_t crc_clmul_xpow(int e, uint32_t p)
+{
+    uint32_t r = 1;
+
+    while (e--)
+        r = (r << 1) ^ (p & -(r >> 31));
+    return r;
+}
+
+/* floor(x^64 / P), with its x^32 term */
+static uint64_t crc_clmul_mu(uint32_t p)
+{
+    uint64_t t = (uint64_t)p << 32, q = 1ULL << 32;
+    int k;
+
+    for (k = 31; k >= 0; k--) {
+        if (t >> (32 + k) & 1) {
+            q |= 1ULL << k;
+            t ^= (1ULL << (32 + k)) ^ ((uint64_t)p << k);
+        }
+    }
+    return q;
+}
+
+static uint32_t crc_clmul_rev32(uint32_t x)
+{
+    return av_bswap32(ff_reverse[x & 0xFF] | ff_reverse[x >> 8 & 0xFF] << 8 |
+                      ff_reverse[x >> 16 & 0xFF] << 16 |
+                      (uint32_t)ff_reverse[x >> 24] << 24);
+}
+
+/* bit reversal of a 33-bit value: the reflected constants */
+static uint64_t crc_clmul_rev33(uint64_t x)
+{
+    return (uint64_t)crc_clmul_rev32(x) << 1 | x >> 32;
+}
+
+static void crc_clmul_set(AVCRC *dst, uint64_t lo, uint64_t hi)
+{
+    dst[0] = lo;
+    dst[1] = lo >> 32;
+    dst[2] = hi;
+    dst[3] = hi >> 32;
+}
+
+/**
+ * Fill the folding constants of a CRC, with the parameters of av_crc_init().
+ *
+ * A big-endian CRC is folded with the data in bit order. For x^e mod P, the
+ * constants are: x^512 and x^576 to fold 4 blocks of 128 bits into the next
+ * 4, x^128 and x^192 to fold one block, x^96 and x^64 to reduce the last
+ * block to 64 bits, and P and x^64 / P for the Barrett reduction.
+ *
+ * A little-endian CRC is folded with the bits of each byte reflected, which
+ * shifts the products by one bit, absorbed in the exponents.
+ */
+static av_unused void crc_clmul_init(AVCRC *ctx, int le, int bits, uint32_t poly)
+{
+    uint32_t p = le ? crc_clmul_rev32(poly) : poly << (32 - bits);
+    uint64_t mu = crc_clmul_mu(p);
+
+#define K(e) crc_clmul_xpow(e, p)
+#define R(e) crc_clmul_rev33(K(e))
+    ctx[1] = le;
+    if (le) {
+        crc_clmul_set(ctx +  4, R(544), R(480));
+        crc_clmul_set(ctx +  8, R(160), R(96));
+        crc_clmul_set(ctx + 12, R(64),  0);
+        crc_clmul_set(ctx + 16, crc_clmul_rev33(1ULL << 32 | p), crc_clmul_rev33(mu));
+    } else {
+        crc_clmul_set(ctx +  4, K(512), K(576));
+        crc_clmul_set(ctx +  8, K(128), K(192));
+        crc_clmul_set(ctx + 12, K(96),  K(64));
+        crc_clmul_set(ctx + 16, 1ULL << 32 | p, mu);
+        /* pshufb mask reversing the bytes of a block */
+        crc_clmul_set(ctx + 20, 0x08090A0B0C0D0E0FULL, 0x0001020304050607ULL);
+    }
+#undef K
+#undef R
+}
+
+#define CRC_CLMUL_NOSHUF(x)
+#define CRC_CLMUL_SHUF(x) "pshufb      %%xmm7, %%"#x"          \n\t"
+
+/* fold the register x over the block at off(buf), with the constants in xmm4 */
+#define CRC_CLMUL_FOLD(x, off, shuf)                  \
+    "movdqa      %%"#x", %%xmm5          \n\t"        \
+    "pclmulqdq   $0x00, %%xmm4, %%"#x"   \n\t"        \
+    "pclmulqdq   $0x11, %%xmm4, %%xmm5   \n\t"        \
+    "pxor        %%xmm5, %%"#x"          \n\t"        \
+    "movdqu      "#off"(%[buf]), %%xmm5  \n\t"        \
+    shuf(xmm5)                                        \
+    "pxor        %%xmm5, %%"#x"          \n\t"
+
+/* fold the register a into b */
+#define CRC_CLMUL_FOLD_INTO(a, b)                     \
+    "movdqa      %%"#a", %%xmm5          \n\t"        \
+    "pclmulqdq   $0x00, %%xmm4, %%"#a"   \n\t"        \
+    "pclmulqdq   $0x11, %%xmm4, %%xmm5   \n\t"        \
+    "pxor        %%xmm5, %%"#b"          \n\t"        \
+    "pxor        %%"#a", %%"#b"          \n\t"
+
+/* fold the buffer into xmm3, 4 blocks at a time then one by one */
+#define CRC_CLMUL_LOOP(shuf)                          \
+    "movdqu        (%[buf]), %%xmm0      \n\t"        \
+    "movdqu      16(%[buf]), %%xmm1      \n\t"        \
+    "movdqu      32(%[buf]), %%xmm2      \n\t"        \
+    "movdqu      48(%[buf]), %%xmm3      \n\t"        \
+    shuf(xmm0) shuf(xmm1) shuf(xmm2) shuf(xmm3)       \
+    "pxor        %%xmm4, %%xmm0          \n\t"        \
+    "movdqa      %[fold4], %%xmm4        \n\t"        \
+    "add         $64, %[buf]             \n\t"        \
+    "sub         $4, %[blocks]           \n\t"        \
+    "cmp         $4, %[blocks]           \n\t"        \
+    "jl          2f                      \n\t"        \
+    "1:                                  \n\t"        \
+    CRC_CLMUL_FOLD(xmm0,  0, shuf)                    \
+    CRC_CLMUL_FOLD(xmm1, 16, shuf)                    \
+    CRC_CLMUL_FOLD(xmm2, 32, shuf)                    \
+    CRC_CLMUL_FOLD(xmm3, 48, shuf)                    \
+    "add         $64, %[buf]             \n\t"        \
+    "sub         $4, %[blocks]           \n\t"        \
+    "cmp         $4, %[blocks]           \n\t"        \
+    "jge         1b                      \n\t"        \
+    "2:                                  \n\t"        \
+    "movdqa      %[fold1], %%xmm4        \n\t"        \
+    CRC_CLMUL_FOLD_INTO(xmm0, xmm1)                   \
+    CRC_CLMUL_FOLD_INTO(xmm1, xmm2)                   \
+    CRC_CLMUL_FOLD_INTO(xmm2, xmm3)                   \
+    "test        %[blocks], %[blocks]    \n\t"        \
+    "jz          4f                      \n\t"        \
+    "3:                                  \n\t"        \
+    CRC_CLMUL_FOLD(xmm3, 0, shuf)                     \
+    "add         $16, %[buf]             \n\t"        \
+    "dec         %[blocks]               \n\t"        \
+    "jnz         3b                      \n\t"        \
+    "4:                                  \n\t"
+
+#define CRC_CLMUL_OPERANDS                                            \
+    : [crc]"+r"(crc), [buf]"+r"(buffer), [blocks]"+r"(blocks)         \
+    : [fold4]  "m"(*(const xmm_reg *)(ctx +  4)),                     \
+      [fold1]  "m"(*(const xmm_reg *)(ctx +  8)),                     \
+      [red]    "m"(*(const xmm_reg *)(ctx + 12)),                     \
+      [barrett]"m"(*(const xmm_reg *)(ctx + 16)),                     \
+      [shuf]   "m"(*(const xmm_reg *)(ctx + 20))                      \
+    : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",                \
+                   "%xmm4", "%xmm5", "%xmm7",)                        \
+      "memory"
+
+/**
+ * Update the CRC with the 16-byte blocks of the buffer, if it holds at
+ * least 64 bytes, using the constants of crc_clmul_init().
+ *
+ * @return the number of bytes processed
+ */
+static size_t crc_clmul(const AVCRC *ctx, uint32_t *pcrc,
+                        const uint8_t *buffer, size_t length)
+{
+    x86_reg blocks = length >> 4;
+    uint32_t crc = *pcrc;
+
+    if (length < 64)
+        return 0;
+
+    if (ctx[1]) {
+        __asm__ volatile(
+            "movd        %[crc], %%xmm4          \n\t"
+            CRC_CLMUL_LOOP(CRC_CLMUL_NOSHUF)
+            /* 128 to 64 bits */
+            "movdqa      %%xmm3, %%xmm5          \n\t"
+            "pclmulqdq   $0x10, %%xmm4, %%xmm5   \n\t"
+            "psrldq      $8, %%xmm3              \n\t"
+            "pxor        %%xmm5, %%xmm3          \n\t"
+            "movdqa      %%xmm3, %%xmm5          \n\t"
+            "psrldq      $4, %%xmm5              \n\t"
+            "psllq       $32, %%xmm3             \n\t"
+            "psrlq       $32, %%xmm3             \n\t"
+            "movdqa      %[red], %%xmm4          \n\t"
+            "pclmulqdq   $0x00, %%xmm4, %%xmm3   \n\t"
+            "pxor        %%xmm5, %%xmm3          \n\t"
+            /* Barrett reduction to 32 bits */
+            "movdqa      %[barrett], %%xmm4      \n\t"
+            "movdqa      %%xmm3, %%xmm5          \n\t"
+            "psllq       $32, %%xmm5             \n\t"
+            "psrlq       $32, %%xmm5             \n\t"
+            "pclmulqdq   $0x10, %%xmm4, %%xmm5   \n\t"
+            "psllq       $32, %%xmm5             \n\t"
+            "psrlq       $32, %%xmm5             \n\t"
+            "pclmulqdq   $0x00, %%xmm4, %%xmm5   \n\t"
+            "pxor        %%xmm5, %%xmm3          \n\t"
+            "psrldq      $4, %%xmm3              \n\t"
+            "movd        %%xmm3, %[crc]          \n\t"
+            CRC_CLMUL_OPERANDS
+        );
+    } else {
+        crc = av_bswap32(crc);
+        __asm__ volatile(
+            "movdqa      %[shuf], %%xmm7         \n\t"
+            "movd        %[crc], %%xmm4          \n\t"
+            "pslldq      $12, %%xmm4             \n\t"
+            CRC_CLMUL_LOOP(CRC_CLMUL_SHUF)
+            /* 128 to 64 bits */
+            "movdqa      %[red], %%xmm4          \n\t"
+            "movdqa      %%xmm3, %%xmm5          \n\t"
+            "pclmulqdq   $0x01, %%xmm4, %%xmm5   \n\t"
+            "movq        %%xmm3, %%xmm3          \n\t"
+            "pslldq      $4, %%xmm3              \n\t"
+            "pxor        %%xmm5, %%xmm3          \n\t"
+            "movdqa      %%xmm3, %%xmm5          \n\t"
+            "pclmulqdq   $0x11, %%xmm4, %%xmm5   \n\t"
+            "movq        %%xmm3, %%xmm3          \n\t"
+            "pxor        %%xmm5, %%xmm3          \n\t"
+            /* Barrett reduction to 32 bits */
+            "movdqa      %[barrett], %%xmm4      \n\t"
+            "movdqa      %%xmm3, %%xmm5          \n\t"
+            "psrlq       $32, %%xmm5             \n\t"
+            "pclmulqdq   $0x10, %%xmm4, %%xmm5   \n\t"
+            "psrlq       $32, %%xmm5             \n\t"
+            "pclmulqdq   $0x00, %%xmm4, %%xmm5   \n\t"
+            "pxor        %%xmm5, %%xmm3          \n\t"
+            "movd        %%xmm3, %[crc]          \n\t"
+            CRC_CLMUL_OPERANDS
+        );
+        crc = av_bswap32(crc);
+    }
+
+    *pcrc = crc;
+    return length & ~15;
+}
+
+#endif /* HAVE_CLMUL_INLINE */
+
+#endif /* AVUTIL_X86_CRC_H */
@@ -0,0 +1,76 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define TX_FLOAT
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/tx_priv.h"
+#include "cpu.h"
+
+void ff_tx_fft_float_sse(FFTComplex *z, int nbits);
+void ff_tx_fft_float_avx(FFTComplex *z, int nbits);
+void ff_tx_fft_float_fma3(FFTComplex *z, int nbits);
+
+#define DECL_POSTROT(type, cpu) \
+void ff_tx_##type##_postrot_float_##cpu(FFTComplex *z, const FFTComplex *exp, int len8);
+
+DECL_POSTROT(mdct,  sse)
+DECL_POSTROT(imdct, sse)
+DECL_POSTROT(mdct,  avx)
+DECL_POSTROT(imdct, avx)
+DECL_POSTROT(mdct,  fma3)
+DECL_POSTROT(imdct, fma3)
+
+av_cold enum TXPermutation ff_tx_init_float_x86(AVTXContext *s)
+{
+    enum TXPermutation perm = FF_TX_PERM_DEFAULT;
+    int cpu_flags = av_get_cpu_flags();
+    int nbits = av_log2(s->m);
+    /* Only the monolithic (i)MDCTs have a separate post-rotation */
+    int postrot = s->n == 1 && ff_tx_type_is_mdct(s->type);
+
+    if (nbits < 2)
+        return perm;
+
+    if (EXTERNAL_SSE(cpu_flags)) {
+        s->ptwo_fft = ff_tx_fft_float_sse;
+        perm = FF_TX_PERM_SWAP_LSBS;
+        if (postrot)
+            s->mdct_postrot = s->inv ? ff_tx_imdct_postrot_float_sse :
+                                       ff_tx_mdct_postrot_float_sse;
+    }
+    if (EXTERNAL_AVX_FAST(cpu_flags)) {
+        if (nbits >= 5) {
+            s->ptwo_fft = ff_tx_fft_float_avx;
+            perm = FF_TX_PERM_AVX;
+        }
+        if (postrot && nbits >= 3)
+            s->mdct_postrot = s->inv ? ff_tx_imdct_postrot_float_avx :
+                                       ff_tx_mdct_postrot_float_avx;
+    }
+    if (EXTERNAL_FMA3_FAST(cpu_flags)) {
+        if (nbits >= 5)
+            s->ptwo_fft = ff_tx_fft_float_fma3;
+        if (postrot && nbits >= 3)
+            s->mdct_postrot = s->inv ? ff_tx_imdct_postrot_float_fma3 :
+                                       ff_tx_mdct_postrot_float_fma3;
+    }
+
+    return perm;
+}
@@ -242,6 +242,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
      * and faster */
     const int dstW                   = c->dstW;
     const int dstH                   = c->dstH;
+    const int dstSliceEnd            = c->dstSliceEnd ? c->dstSliceEnd : dstH;
 
     const enum AVPixelFormat dstFormat = c->dstFormat;
     const int flags                  = c->flags;
@@ -334,7 +335,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
      * will not get executed. This is not really intended but works
      * currently, so people might do it. */
     if (srcSliceY == 0) {
-        dstY         = 0;
+        dstY         = c->dstSliceStart;
         lastInLumBuf = -1;
         lastInChrBuf = -1;
     }
@@ -366,7 +367,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         hout_slice->width = dstW;
     }
 
-    for (; dstY < dstH; dstY++) {
+    for (; dstY < dstSliceEnd; dstY++) {
         const int chrDstY = dstY >> c->chrDstVSubSample;
         int use_mmx_vfilter= c->use_mmx_vfilter;
 
@@ -732,6 +733,38 @@ static void rgb48Toxyz12(struct SwsContext *c, uint16_t *dst,
     }
 }
 
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads)
+{
+    SwsContext *parent = priv;
+    SwsContext      *c = parent->slice_ctx[threadnr];
+    /* keep the bands aligned to whole chroma lines */
+    const int align    = 1 << c->chrDstVSubSample;
+    const int slice_h  = FFALIGN(c->dstH / nb_jobs, align);
+    const uint8_t *src[4];
+    uint8_t *dst[4];
+    int srcStride[4], dstStride[4];
+
+    c->dstSliceStart = FFMIN(jobnr * slice_h, c->dstH);
+    c->dstSliceEnd   = jobnr == nb_jobs - 1 ? c->dstH :
+                       FFMIN(c->dstSliceStart + slice_h, c->dstH);
+    if (c->dstSliceStart >= c->dstSliceEnd)
+        return;
+
+    /* swscale() modifies the pointer and stride arrays it is given */
+    memcpy(src,       parent->thread_src,       sizeof(src));
+    memcpy(srcStride, parent->thread_srcStride, sizeof(srcStride));
+    memcpy(dst,       parent->thread_dst,       sizeof(dst));
+    memcpy(dstStride, parent->thread_dstStride, sizeof(dstStride));
+
+    if (usePal(c->srcFormat)) {
+        memcpy(c->pal_yuv, parent->pal_yuv, sizeof(c->pal_yuv));
+        memcpy(c->pal_rgb, parent->pal_rgb, sizeof(c->pal_rgb));
+    }
+
+    swscale(c, src, srcStride, 0, c->srcH, dst, dstStride);
+}
+
 /**
  * swscale wrapper, so we don't need to export the SwsContext.
  * Assumes planar YUV to be in YUV order instead of YVU.
@@ -961,7 +994,17 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     /* reset slice direction at end of frame */
     if (srcSliceY_internal + srcSliceH == c->srcH)
         c->sliceDir = 0;
-    ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
+    if (c->slicethread && srcSliceY_internal == 0 && srcSliceH == c->srcH) {
+        /* whole picture given at once, let each thread render one band */
+        memcpy(c->thread_src,       src2,       sizeof(c->thread_src));
+        memcpy(c->thread_srcStride, srcStride2, sizeof(c->thread_srcStride));
+        memcpy(c->thread_dst,       dst2,       sizeof(c->thread_dst));
+        memcpy(c->thread_dstStride, dstStride2, sizeof(c->thread_dstStride));
+
+        avpriv_slicethread_execute(c->slicethread, c->nb_slice_ctx, 0);
+        ret = c->dstH;
+    } else
+        ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
 
     if (c->dstXYZ && !(c->srcXYZ && c->srcW==c->dstW && c->srcH==c->dstH)) {
         int dstY = c->dstY ? c->dstY : srcSliceY + srcSliceH;
@@ -32,6 +32,7 @@
 #include "libavutil/pixfmt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/ppc/util_altivec.h"
+#include "libavutil/slicethread.h"
 
 #define STR(s) AV_TOSTRING(s) // AV_STRINGIFY is too long
 
@@ -321,6 +322,22 @@ typedef struct SwsContext {
     uint8_t *cascaded1_tmp[4];
     int cascaded_mainindex;
 
+    /* Slice threading: when more than one thread is requested, each thread
+     * gets its own fully initialized copy of the scaler (and thus its own
+     * ring buffers) and renders one horizontal band of the destination from
+     * the complete source picture.
+     */
+    int nb_threads;                    ///< Number of threads requested by the user, 0 for automatic.
+    AVSliceThread *slicethread;
+    struct SwsContext **slice_ctx;
+    int nb_slice_ctx;
+    const uint8_t *thread_src[4];      ///< Source planes of the picture being scaled by the threads.
+    int thread_srcStride[4];
+    uint8_t *thread_dst[4];            ///< Destination planes of the picture being scaled by the threads.
+    int thread_dstStride[4];
+    int dstSliceStart;                 ///< First destination line rendered by this context, used by slice contexts.
+    int dstSliceEnd;                   ///< Destination line after the last one rendered by this context, 0 for dstH.
+
     double gamma_value;
     int gamma_flag;
     int is_internal_gamma;
@@ -855,6 +872,9 @@ void ff_get_unscaled_swscale_aarch64(SwsContext *c);
  */
 SwsFunc ff_getSwsFunc(SwsContext *c);
 
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads);
+
 void ff_sws_init_input_funcs(SwsContext *c);
 void ff_sws_init_output_funcs(SwsContext *c,
                               yuv2planar1_fn *yuv2plane1,
@@ -856,6 +856,17 @@ static void fill_xyztables(struct SwsContext *c)
     }
 }
 
+static void free_slice_threads(SwsContext *c)
+{
+    int i;
+
+    avpriv_slicethread_free(&c->slicethread);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    c->nb_slice_ctx = 0;
+}
+
 int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
                              int srcRange, const int table[4], int dstRange,
                              int brightness, int contrast, int saturation)
@@ -863,11 +874,27 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
     int need_reinit = 0;
+    int i;
 
     handle_formats(c);
     desc_dst = av_pix_fmt_desc_get(c->dstFormat);
     desc_src = av_pix_fmt_desc_get(c->srcFormat);
 
+    if (c->nb_slice_ctx) {
+        if ((isYUV(c->dstFormat) || isGray(c->dstFormat)) &&
+            (isYUV(c->srcFormat) || isGray(c->srcFormat)) &&
+            memcmp(inv_table, table, sizeof(int) * 4)) {
+            /* YUV->YUV matrix conversions are done through cascaded
+             * contexts, which are not run from the slice threads */
+            free_slice_threads(c);
+        } else {
+            for (i = 0; i < c->nb_slice_ctx; i++)
+                sws_setColorspaceDetails(c->slice_ctx[i], inv_table, srcRange,
+                                         table, dstRange, brightness,
+                                         contrast, saturation);
+        }
+    }
+
     if(!isYUV(c->dstFormat) && !isGray(c->dstFormat))
         dstRange = 0;
     if(!isYUV(c->srcFormat) && !isGray(c->srcFormat))
@@ -1163,6 +1190,60 @@ static enum AVPixelFormat alphaless_fmt(enum AVPixelFormat fmt)
     }
 }
 
+/* minimum number of destination lines rendered by one thread */
+#define MIN_SLICE_LINES 16
+
+static av_cold int context_init_threaded(SwsContext *c,
+                                         SwsFilter *srcFilter, SwsFilter *dstFilter)
+{
+    int i, ret, nb_threads;
+
+    /* Error diffusion carries state from one line to the next and the
+     * XYZ output conversion works on the lines returned by the last call,
+     * so neither can be split into independent bands. */
+    if (c->nb_threads == 1 || c->dither == SWS_DITHER_ED || c->dstXYZ)
+        return 0;
+
+    nb_threads = c->nb_threads ? c->nb_threads : av_cpu_count();
+    nb_threads = FFMIN(nb_threads, c->dstH / MIN_SLICE_LINES);
+    if (nb_threads <= 1)
+        return 0;
+
+    ret = avpriv_slicethread_create(&c->slicethread, c, ff_sws_slice_worker,
+                                    NULL, nb_threads);
+    if (ret == AVERROR(ENOSYS))
+        return 0;
+    if (ret < 0)
+        return ret;
+    nb_threads = ret;
+
+    c->slice_ctx = av_mallocz_array(nb_threads, sizeof(*c->slice_ctx));
+    if (!c->slice_ctx)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_threads; i++) {
+        SwsContext *slice = sws_alloc_context();
+        if (!slice)
+            return AVERROR(ENOMEM);
+        c->slice_ctx[c->nb_slice_ctx++] = slice;
+
+        ret = av_opt_copy(slice, c);
+        if (ret < 0)
+            return ret;
+        slice->nb_threads = 1;
+
+        ret = sws_init_context(slice, srcFilter, dstFilter);
+        if (ret < 0)
+            return ret;
+
+        sws_setColorspaceDetails(slice, c->srcColorspaceTable, c->srcRange,
+                                 c->dstColorspaceTable, c->dstRange,
+                                 c->brightness, c->contrast, c->saturation);
+    }
+
+    return 0;
+}
+
 av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                              SwsFilter *dstFilter)
 {
@@ -1831,7 +1912,11 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
     }
 
     c->swscale = ff_getSwsFunc(c);
-    return ff_init_filters(c);
+    ret = ff_init_filters(c);
+    if (ret < 0)
+        return ret;
+
+    return context_init_threaded(c, srcFilter, dstFilter);
 fail: // FIXME replace things by appropriate error codes
     if (ret == RETCODE_USE_CASCADE)  {
         int tmpW = sqrt(srcW * (int64_t)dstW);
@@ -2316,6 +2401,8 @@ void sws_freeContext(SwsContext *c)
     if (!c)
         return;
 
+    free_slice_threads(c);
+
     for (i = 0; i < 4; i++)
         av_freep(&c->dither_error[i]);
 
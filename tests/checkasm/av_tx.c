@@ -0,0 +1,151 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <math.h>
+
+#include "checkasm.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+#define TX_FLOAT
+#include "libavutil/tx_priv.h"
+
+#define MAX_BITS 10
+#define MAX_LEN  (1 << MAX_BITS)
+#define EPS      0.002f
+
+static void ref_dft(AVComplexFloat *out, const AVComplexFloat *in, int len, int inv)
+{
+    for (int k = 0; k < len; k++) {
+        double re = 0.0, im = 0.0;
+        for (int j = 0; j < len; j++) {
+            double phi = 2 * M_PI * ((int64_t)j * k % len) / len * (inv ? 1 : -1);
+            re += in[j].re * cos(phi) - in[j].im * sin(phi);
+            im += in[j].re * sin(phi) + in[j].im * cos(phi);
+        }
+        out[k].re = re;
+        out[k].im = im;
+    }
+}
+
+static void check_fft(int nbits, int inv)
+{
+    LOCAL_ALIGNED_32(AVComplexFloat, in,  [MAX_LEN]);
+    LOCAL_ALIGNED_32(AVComplexFloat, ref, [MAX_LEN]);
+    LOCAL_ALIGNED_32(AVComplexFloat, new, [MAX_LEN]);
+    const int len = 1 << nbits;
+    const float scale = 1.0f;
+    AVTXContext *s;
+    av_tx_fn fn;
+
+    declare_func(void, AVComplexFloat *z, int nbits);
+
+    if (av_tx_init(&s, &fn, AV_TX_FLOAT_FFT, inv, len, &scale, 0) < 0) {
+        fail();
+        return;
+    }
+
+    if (check_func(s->ptwo_fft, "tx_fft_float_%d%s", len, inv ? "_inv" : "")) {
+        for (int i = 0; i < len; i++) {
+            in[i].re = (rnd() & 0xffff) / 32768.0f - 1.0f;
+            in[i].im = (rnd() & 0xffff) / 32768.0f - 1.0f;
+        }
+        ref_dft(ref, in, len, inv);
+
+        for (int i = 0; i < len; i++)
+            new[s->revtab[i]] = in[i];
+        call_new(new, nbits);
+        if (!float_near_abs_eps_array(&ref[0].re, &new[0].re, EPS, 2 * len))
+            fail();
+
+        bench_new(new, nbits);
+    }
+
+    av_tx_uninit(&s);
+}
+
+static void ref_mdct_postrot(AVComplexFloat *z, const AVComplexFloat *exp,
+                             int len8, int inv)
+{
+    for (int i = 0; i < len8; i++) {
+        const int i0 = len8 + i, i1 = len8 - i - 1;
+        AVComplexFloat z0 = z[i0], z1 = z[i1], e0 = exp[i0], e1 = exp[i1];
+
+        if (inv) {
+            z[i1].re = z1.im * e1.im - z1.re * e1.re;
+            z[i0].im = z1.im * e1.re + z1.re * e1.im;
+            z[i0].re = z0.im * e0.im - z0.re * e0.re;
+            z[i1].im = z0.im * e0.re + z0.re * e0.im;
+        } else {
+            z[i1].im = z0.re * e0.im - z0.im * e0.re;
+            z[i0].re = z0.re * e0.re + z0.im * e0.im;
+            z[i0].im = z1.re * e1.im - z1.im * e1.re;
+            z[i1].re = z1.re * e1.re + z1.im * e1.im;
+        }
+    }
+}
+
+static void check_mdct_postrot(int nbits, int inv)
+{
+    LOCAL_ALIGNED_32(AVComplexFloat, ref, [MAX_LEN]);
+    LOCAL_ALIGNED_32(AVComplexFloat, new, [MAX_LEN]);
+    const int len = 1 << nbits, len8 = len >> 1;
+    const float scale = 1.0f;
+    AVTXContext *s;
+    av_tx_fn fn;
+
+    declare_func(void, AVComplexFloat *z, const AVComplexFloat *exp, int len8);
+
+    /* An MDCT of 2*len outputs uses a len point FFT */
+    if (av_tx_init(&s, &fn, AV_TX_FLOAT_MDCT, inv, 2 * len, &scale, 0) < 0) {
+        fail();
+        return;
+    }
+
+    if (check_func(s->mdct_postrot, "tx_%smdct_postrot_float_%d",
+                   inv ? "i" : "", len)) {
+        for (int i = 0; i < len; i++) {
+            ref[i].re = (rnd() & 0xffff) / 32768.0f - 1.0f;
+            ref[i].im = (rnd() & 0xffff) / 32768.0f - 1.0f;
+            new[i] = ref[i];
+        }
+
+        ref_mdct_postrot(ref, s->exptab, len8, inv);
+        call_new(new, s->exptab, len8);
+        if (!float_near_abs_eps_array(&ref[0].re, &new[0].re, EPS, 2 * len))
+            fail();
+
+        bench_new(new, s->exptab, len8);
+    }
+
+    av_tx_uninit(&s);
+}
+
+void checkasm_check_av_tx(void)
+{
+    for (int inv = 0; inv < 2; inv++)
+        for (int nbits = 2; nbits <= MAX_BITS; nbits++)
+            check_fft(nbits, inv);
+    report("fft");
+
+    for (int inv = 0; inv < 2; inv++)
+        for (int nbits = 2; nbits <= MAX_BITS; nbits++)
+            check_mdct_postrot(nbits, inv);
+    report("mdct_postrot");
+}
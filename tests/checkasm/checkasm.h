@@ -43,16 +43,19 @@ void checkasm_check_aacpsdsp(void);
 void checkasm_check_afir(void);
 void checkasm_check_alacdsp(void);
 void checkasm_check_audiodsp(void);
+void checkasm_check_av_tx(void);
 void checkasm_check_blend(void);
 void checkasm_check_blockdsp(void);
 void checkasm_check_bswapdsp(void);
 void checkasm_check_colorspace(void);
+void checkasm_check_crc(void);
 void checkasm_check_exrdsp(void);
 void checkasm_check_fixed_dsp(void);
 void checkasm_check_flacdsp(void);
 void checkasm_check_float_dsp(void);
 void checkasm_check_fmtconvert(void);
 void checkasm_check_g722dsp(void);
+void checkasm_check_h264chroma(void);
 void checkasm_check_h264dsp(void);
 void checkasm_check_h264pred(void);
 void checkasm_check_h264qpel(void);
@@ -75,6 +78,7 @@ void checkasm_check_v210enc(void);
 void checkasm_check_vf_eq(void);
 void checkasm_check_vf_gblur(void);
 void checkasm_check_vf_hflip(void);
+void checkasm_check_vf_overlay(void);
 void checkasm_check_vf_threshold(void);
 void checkasm_check_vp8dsp(void);
 void checkasm_check_vp9dsp(void);
@@ -112,6 +116,10 @@ static av_unused void *func_ref, *func_new;
 /* Decide whether or not the specified function needs to be tested */
 #define check_func(func, ...) (func_ref = checkasm_check_func((func_new = func), __VA_ARGS__))
 
+/* Same for a key selecting a version other than by a function pointer,
+ * e.g. a table; the key tested before is returned */
+#define check_key(key, ...) checkasm_check_func((func_new = (void *)(key)), __VA_ARGS__)
+
 /* Declare the function prototype. The first argument is the return value, the remaining
  * arguments are the function parameters. Naming parameters is optional. */
 #define declare_func(ret, ...) declare_new(ret, __VA_ARGS__) typedef ret func_type(__VA_ARGS__)
@@ -224,22 +232,21 @@ typedef struct CheckasmPerf {
 #define PERF_STOP(t)  t = AV_READ_TIME() - t
 #endif
 
-/* Benchmark the function */
-#define bench_new(...)\
+/* Benchmark an expression */
+#define bench(...)\
     do {\
         if (checkasm_bench_func()) {\
             struct CheckasmPerf *perf = checkasm_get_perf_context();\
             av_unused const int sysfd = perf->sysfd;\
-            func_type *tfunc = func_new;\
             uint64_t tsum = 0;\
             int ti, tcount = 0;\
             uint64_t t = 0; \
             for (ti = 0; ti < BENCH_RUNS; ti++) {\
                 PERF_START(t);\
-                tfunc(__VA_ARGS__);\
-                tfunc(__VA_ARGS__);\
-                tfunc(__VA_ARGS__);\
-                tfunc(__VA_ARGS__);\
+                __VA_ARGS__;\
+                __VA_ARGS__;\
+                __VA_ARGS__;\
+                __VA_ARGS__;\
                 PERF_STOP(t);\
                 if (t*tcount <= tsum*4 && ti > 0) {\
                     tsum += t;\
@@ -251,7 +258,15 @@ typedef struct CheckasmPerf {
             perf->iterations++;\
         }\
     } while (0)
+
+/* Benchmark the function */
+#define bench_new(...)\
+    do {\
+        func_type *tfunc = func_new;\
+        bench(tfunc(__VA_ARGS__));\
+    } while (0)
 #else
+#define bench(...)     while(0)
 #define bench_new(...) while(0)
 #define PERF_START(t)  while(0)
 #define PERF_STOP(t)   while(0)
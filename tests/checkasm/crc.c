@@ -0,0 +1,73 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "checkasm.h"
+#include "libavutil/crc.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+
+#define BUF_SIZE 8192
+
+static const char *const crc_names[AV_CRC_MAX] = {
+    [AV_CRC_8_ATM]      = "8_atm",
+    [AV_CRC_8_EBU]      = "8_ebu",
+    [AV_CRC_16_ANSI]    = "16_ansi",
+    [AV_CRC_16_CCITT]   = "16_ccitt",
+    [AV_CRC_24_IEEE]    = "24_ieee",
+    [AV_CRC_32_IEEE]    = "32_ieee",
+    [AV_CRC_32_IEEE_LE] = "32_ieee_le",
+    [AV_CRC_16_ANSI_LE] = "16_ansi_le",
+};
+
+/* The version of av_crc() used depends on the built-in table returned for
+ * the cpu flags, which is the key tested. */
+static void check_crc(AVCRCId id, const uint8_t *buf)
+{
+    const AVCRC *table_new = av_crc_get_table(id);
+    const AVCRC *table_ref = check_key(table_new, "crc_%s", crc_names[id]);
+    uint32_t crc = rnd();
+    int i;
+
+    if (!table_ref)
+        return;
+
+    /* all alignments, short buffers and tails of any length */
+    for (i = 0; i < 64; i++) {
+        int offset = rnd() & 15;
+        int len    = i < 32 ? rnd() % 256 : rnd() % (BUF_SIZE - offset);
+        if (av_crc(table_ref, crc, buf + offset, len) !=
+            av_crc(table_new, crc, buf + offset, len)) {
+            fail();
+            break;
+        }
+    }
+    bench(av_crc(table_new, crc, buf, BUF_SIZE));
+}
+
+void checkasm_check_crc(void)
+{
+    LOCAL_ALIGNED_16(uint8_t, buf, [BUF_SIZE]);
+    int i, id;
+
+    for (i = 0; i < BUF_SIZE; i += 4)
+        AV_WN32A(buf + i, rnd());
+
+    for (id = 0; id < AV_CRC_MAX; id++)
+        check_crc(id, buf);
+    report("crc");
+}
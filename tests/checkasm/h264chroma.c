@@ -0,0 +1,89 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavcodec/h264chroma.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/intreadwrite.h"
+
+static const uint32_t pixel_mask[3] = { 0xffffffff, 0x01ff01ff, 0x03ff03ff };
+
+#define STRIDE (16 * 2)
+#define BUF_SIZE (STRIDE * (16 + 1))
+
+#define randomize_buffers()                        \
+    do {                                           \
+        uint32_t mask = pixel_mask[bit_depth - 8]; \
+        int k;                                     \
+        for (k = 0; k < BUF_SIZE; k += 4) {        \
+            uint32_t r = rnd() & mask;             \
+            AV_WN32A(src0 + k, r);                 \
+            AV_WN32A(src1 + k, r);                 \
+            r = rnd() & mask;                      \
+            AV_WN32A(dst0 + k, r);                 \
+            AV_WN32A(dst1 + k, r);                 \
+        }                                          \
+    } while (0)
+
+/* block heights used by H.264 for each width, 4:2:2 doubles the 4:2:0 ones */
+static const int heights[3][4] = {
+    { 4, 8, 16 },
+    { 2, 4,  8, 16 },
+    { 2, 4,  8 },
+};
+
+void checkasm_check_h264chroma(void)
+{
+    LOCAL_ALIGNED_16(uint8_t, src0, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(uint8_t, src1, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(uint8_t, dst0, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(uint8_t, dst1, [BUF_SIZE]);
+    H264ChromaContext h;
+    int op, bit_depth, i, j;
+    declare_func_emms(AV_CPU_FLAG_MMX | AV_CPU_FLAG_MMXEXT, void, uint8_t *dst, uint8_t *src,
+                      ptrdiff_t stride, int h, int x, int y);
+
+    for (op = 0; op < 2; op++) {
+        const char *op_name = op ? "avg" : "put";
+
+        for (bit_depth = 8; bit_depth <= 10; bit_depth++) {
+            ff_h264chroma_init(&h, bit_depth);
+            for (i = 0; i < 3; i++) {
+                h264_chroma_mc_func func = op ? h.avg_h264_chroma_pixels_tab[i] : h.put_h264_chroma_pixels_tab[i];
+                int size = 8 >> i;
+
+                if (check_func(func, "%s_h264_chroma_mc%d_%d", op_name, size, bit_depth)) {
+                    for (j = 0; j < FF_ARRAY_ELEMS(heights[i]) && heights[i][j]; j++) {
+                        int height = heights[i][j];
+                        int x = rnd() & 7, y = rnd() & 7;
+
+                        randomize_buffers();
+                        call_ref(dst0, src0, STRIDE, height, x, y);
+                        call_new(dst1, src1, STRIDE, height, x, y);
+                        if (memcmp(dst0, dst1, BUF_SIZE))
+                            fail();
+                    }
+                    bench_new(dst1, src1, STRIDE, 8, 3, 5);
+                }
+            }
+        }
+        report("%s", op_name);
+    }
+}
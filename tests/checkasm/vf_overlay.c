@@ -0,0 +1,130 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/vf_overlay.h"
+#include "libavutil/common.h"
+
+#define WIDTH 256
+#define WIDTH_PADDED (WIDTH + 32)
+#define ALINESIZE (2 * WIDTH_PADDED)
+
+#define FAST_DIV255(x) ((((x) + 128) * 257) >> 16)
+
+#define randomize_buffers(buf, size)      \
+    do {                                  \
+        int j;                            \
+        uint8_t *tmp_buf = (uint8_t *)buf;\
+        for (j = 0; j < size; j++)        \
+            tmp_buf[j] = rnd() & 0xFF;    \
+    } while (0)
+
+/* the alpha plane gets a fair share of fully transparent and opaque pixels */
+#define randomize_alpha(buf, size)        \
+    do {                                  \
+        int j;                            \
+        for (j = 0; j < size; j++) {      \
+            int r = rnd();                \
+            buf[j] = (r & 7) == 0 ? 0   : \
+                     (r & 7) == 1 ? 255 : \
+                     (r >> 3) & 0xFF;     \
+        }                                 \
+    } while (0)
+
+/* Same computation as blend_plane() for rows whose pixels all have their
+ * right and bottom alpha neighbours, on a main input without alpha. */
+static void blend_row_ref(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                          ptrdiff_t alinesize, int w, int hsub, int vsub,
+                          int straight, int uv)
+{
+    int k;
+
+    for (k = 0; k < w; k++) {
+        int alpha;
+
+        if (hsub && vsub)
+            alpha = (a[0] + a[alinesize] + a[1] + a[alinesize + 1]) >> 2;
+        else if (hsub)
+            alpha = (((a[0] + a[1]) >> 1) + a[0]) >> 1;
+        else
+            alpha = a[0];
+
+        if (straight)
+            *d = FAST_DIV255(*d * (255 - alpha) + *s * alpha);
+        else if (uv)
+            *d = av_clip(FAST_DIV255((*d - 128) * (255 - alpha)) + *s - 128, -128, 128) + 128;
+        else
+            *d = FFMIN(FAST_DIV255(*d * (255 - alpha)) + *s, 255);
+
+        d++;
+        s++;
+        a += 1 << hsub;
+    }
+}
+
+static void check_overlay_row(const char *name, int format, int pix_format,
+                              int alpha_format, int plane)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,     [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, alpha,   [2 * ALINESIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [WIDTH_PADDED]);
+    int hsub = plane && format != OVERLAY_FORMAT_YUV444 && format != OVERLAY_FORMAT_GBRP;
+    int vsub = plane && format == OVERLAY_FORMAT_YUV420;
+    int uv   = plane && format != OVERLAY_FORMAT_GBRP;
+    OverlayContext s = { 0 };
+
+    declare_func(int, uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a,
+                 int w, ptrdiff_t alinesize);
+
+#if ARCH_X86
+    ff_overlay_init_x86(&s, format, pix_format, alpha_format, 0);
+#endif
+
+    randomize_buffers(src, WIDTH_PADDED);
+    randomize_buffers(dst_ref, WIDTH_PADDED);
+    randomize_alpha(alpha, 2 * ALINESIZE);
+    memcpy(dst_new, dst_ref, WIDTH_PADDED);
+
+    if (check_func(s.blend_row[plane], "%s", name)) {
+        int c = call_new(dst_new, NULL, src, alpha, WIDTH, ALINESIZE);
+
+        if (c < 0 || c > WIDTH)
+            fail();
+        blend_row_ref(dst_ref, src, alpha, ALINESIZE, FFMAX(c, 0),
+                      hsub, vsub, !alpha_format, uv);
+        if (memcmp(dst_ref, dst_new, WIDTH_PADDED))
+            fail();
+        bench_new(dst_new, NULL, src, alpha, WIDTH, ALINESIZE);
+    }
+}
+
+void checkasm_check_vf_overlay(void)
+{
+    check_overlay_row("overlay_row_44", OVERLAY_FORMAT_YUV444, AV_PIX_FMT_YUV444P, 0, 0);
+    check_overlay_row("overlay_row_22", OVERLAY_FORMAT_YUV422, AV_PIX_FMT_YUV422P, 0, 1);
+    check_overlay_row("overlay_row_20", OVERLAY_FORMAT_YUV420, AV_PIX_FMT_YUV420P, 0, 1);
+    report("overlay_row");
+
+    check_overlay_row("overlay_row_44_pm",    OVERLAY_FORMAT_GBRP,   AV_PIX_FMT_GBRP,    1, 0);
+    check_overlay_row("overlay_row_44_pm_uv", OVERLAY_FORMAT_YUV444, AV_PIX_FMT_YUV444P, 1, 1);
+    check_overlay_row("overlay_row_22_pm_uv", OVERLAY_FORMAT_YUV422, AV_PIX_FMT_YUV422P, 1, 1);
+    check_overlay_row("overlay_row_20_pm_uv", OVERLAY_FORMAT_YUV420, AV_PIX_FMT_YUV420P, 1, 1);
+    report("overlay_row_pm");
+}
@@ -2,6 +2,11 @@
 #fate-async: libavformat/tests/async$(EXESUF)
 #fate-async: CMD = run libavformat/tests/async
 
+FATE_HTTPSERVER-$(HAVE_EPOLL_CREATE1) += fate-httpserver
+FATE_LIBAVFORMAT-$(CONFIG_HTTP_PROTOCOL) += $(if $(HAVE_PTHREADS),$(FATE_HTTPSERVER-yes))
+fate-httpserver: libavformat/tests/httpserver$(EXESUF)
+fate-httpserver: CMD = run libavformat/tests/httpserver$(EXESUF)
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy$(EXESUF)
@@ -18,6 +23,11 @@ FATE_LIBAVFORMAT-yes += fate-url
 fate-url: libavformat/tests/url$(EXESUF)
 fate-url: CMD = run libavformat/tests/url$(EXESUF)
 
+FATE_INDEXCACHE-$(HAVE_UTIME_H) += fate-indexcache
+FATE_LIBAVFORMAT-$(call ALLYES, MOV_MUXER MOV_DEMUXER FILE_PROTOCOL) += $(FATE_INDEXCACHE-yes)
+fate-indexcache: libavformat/tests/indexcache$(EXESUF)
+fate-indexcache: CMD = run libavformat/tests/indexcache$(EXESUF) $(TARGET_PATH)/tests/data/fate
+
 FATE_LIBAVFORMAT-$(CONFIG_MOV_MUXER) += fate-movenc
 fate-movenc: libavformat/tests/movenc$(EXESUF)
 fate-movenc: CMD = run libavformat/tests/movenc$(EXESUF)